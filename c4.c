@@ -1,25 +1,73 @@
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
+#include <stdint.h>
 #include "c4.h"
+#include "c4sys.h"
+#include "c4simd.h"
+#include "c4rule.h"
+#include "c4bits.h"
+#include "c4tt.h"
 
 /* Some macros for convenience. */
 
 #define other(x)        ((x) ^ 1)
 #define real_player(x)  ((x) & 1)
 
-#define pop_state() \
-(current_state = &state_stack[--depth])
+#define pop_state(g) \
+((g)->current_state = &(g)->state_stack[--(g)->depth])
+
+/* A size rounded up to a whole number of cache lines (see CACHE_LINE). */
+
+#define line_round(n) \
+(((n) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE)
+
+/* The key of the current state of a search, player having just moved, */
+/* in a transposition table (see board_key()).                          */
+
+#define table_key(g, player) \
+((g)->hash ^ (g)->geo->keys[2 * (g)->geo->total_size + (player)])
+
+/* The score of a win kept in a transposition table, less the moves to */
+/* it, and the most any other score there can be (see to_table()).     */
+
+#define TABLE_WIN    32767
+#define TABLE_LIMIT  (TABLE_WIN - C4_MAX_LEVEL - 1)
+
+/* The memory emalloc_aligned() takes for a block of n bytes. */
+
+#define aligned_size(n) ((n) + CACHE_LINE + sizeof(void *))
 
 /* The "goodness" of the current state with respect to a player is the */
 /* score of that player minus the score of the player's opponent.  A   */
 /* positive value will result if the specified player is in a better   */
 /* situation than his/her opponent.                                    */
 
-#define goodness_of(player) \
-(current_state->score[player] - current_state->score[other(player)])
+#define goodness_of(g, player) \
+((g)->current_state->score[player] - \
+ (g)->current_state->score[other(player)])
+
+/* The contribution of a score_array count to a player's score: 0 for a */
+/* count of 0, and 2 to the power of the number of pieces otherwise.    */
+
+#define window_value(c) ((1 << (c)) >> 1)
+
+/* The size of a cache line, to which the larger tables are aligned. */
+
+#define CACHE_LINE 64
+
+/* The standard board, 7 by 6 with 4 in a row to win, for which the    */
+/* search has a version of its own (see std_evaluate()).  STD_PLACES is */
+/* the most win places through any one of its cells.                   */
+
+#define STD_X       7
+#define STD_Y       6
+#define STD_N       4
+#define STD_PLACES  13
 
 /* A local struct which defines the state of a game. */
 
@@ -37,61 +85,320 @@ typedef struct {
 							/* a value of C4_NONE specifies that the       */
 							/* position is unoccupied.                     */
 
-	int *(score_array[2]);  /* An array specifying statistics on both      */
-							/* players.  score_array[0] specifies the      */
-							/* statistics for player 0, while              */
-							/* score_array[1] specifies the statistics for */
-							/* player 1.                                   */
+	unsigned char *score_array;
+							/* An array specifying statistics on both      */
+							/* players, with the two players interleaved:  */
+							/* score_array[2*w + x] is the count for       */
+							/* player x of win place w.  A count of 0      */
+							/* means the opponent already has a piece      */
+							/* there; otherwise it is one more than the    */
+							/* number of player x's pieces there.  The     */
+							/* value of a count c is window_value(c).      */
 
 	int score[2];           /* The actual scores of each player, deducible */
 							/* from score_array, but kept separately for   */
 							/* efficiency.  The score of player x is the   */
-							/* sum of score_array[x].  A score is          */
-							/* basically a function of how many winning    */
-							/* positions are still available to the        */
-							/* and how close he/she is to achieving each   */
-							/* of these positions.                         */
+							/* sum of the values of player x's counts.  A  */
+							/* score is basically a function of how many   */
+							/* winning positions are still available to    */
+							/* the player, and how close he/she is to      */
+							/* achieving each of these positions.          */
 
 	short int winner;       /* The winner of the game - either 0, 1 or     */
 							/* C4_NONE.  Deducible from score_array, but   */
 							/* kept separately for efficiency.             */
 
+	int win_place;          /* The win place connected by the winner, if   */
+							/* there is one; the lowest numbered of them,  */
+							/* if one piece connected several.  It is set  */
+							/* along with winner, except in the states of  */
+							/* std_evaluate(), which never outlive the     */
+							/* search.                                     */
+
 	int num_of_pieces;      /* The number of pieces currently occupying    */
 							/* board spaces.  Deducible from board, but    */
 							/* kept separately for efficiency.             */
 
+	bool rules_valid[2];    /* Whether rule_score[x] holds the scores of   */
+	int rule_score[2][C4_NUM_RULES];
+							/* the rules of apply_rule() for player x on   */
+							/* the board.  Once they have been worked out  */
+							/* for a state, each drop only rescores the    */
+							/* patterns which take in the new piece (see   */
+							/* rule_total()).                              */
+
 } Game_state;
 
-/* Static global variables. */
+/* A local struct which describes the shape of a board and the tables   */
+/* derived from it.  A geometry is shared by every game on a board of   */
+/* its shape, on any thread, and none of it changes once it has been    */
+/* built except references and next, which belong to the cache (see    */
+/* get_geometry()).                                                     */
+
+typedef struct Geometry {
+
+	int size_x, size_y;     /* The dimensions of the board.                */
+	int total_size;         /* size_x * size_y.                            */
+	int num_to_connect;     /* Pieces in a row required to win.            */
+	int win_places;         /* The number of possible winning positions.   */
+	int magic_win_number;   /* The score_array count of a completed        */
+							/* winning position.                           */
+
+	int max_places;         /* The most win places through any one cell.   */
+	int *map_start;         /* The indices of the win places through the   */
+	int *map;               /* cell in column x, row y are map[s] through  */
+							/* map[e - 1], where s is map_start[c], e is   */
+							/* map_start[c + 1] and c is x * size_y + y.   */
+							/* map is aligned to a cache line.             */
+
+	int *drop_order;        /* The order in which automatic moves should   */
+							/* be tried.                                   */
+
+	int *win_ends;          /* The cells at the ends of each win place:    */
+							/* win place w runs from cell win_ends[2*w],   */
+							/* its lowest (and, of those, leftmost), to    */
+							/* cell win_ends[2*w + 1], its highest (and    */
+							/* rightmost).  Cells are numbered as in map.  */
+
+	C4_count_kernel update_counts;
+							/* The version of the update_score() kernel    */
+							/* best suited to the processor.               */
+
+	C4_rule_table *rules;   /* The patterns of apply_rule() compiled for   */
+							/* the board.                                  */
+
+	C4_bits_table *bits;    /* The board laid out as bitboards.            */
+
+	uint64_t *keys;         /* The keys of the pieces for the              */
+							/* transposition tables: keys[2*c + p] for a   */
+							/* piece of player p in cell c (numbered as in */
+							/* map), and keys[2*total_size + p] for player */
+							/* p having just moved.                        */
+
+	size_t bytes;           /* The memory the geometry takes up.           */
+
+	int references;         /* The games using the geometry.               */
+	struct Geometry *next;  /* The next geometry in the cache.             */
+
+} Geometry;
+
+/* What search_drop() changes in place besides the board and the counts */
+/* it saves, so that search_undo() can put it back.                     */
+
+typedef struct {
+	int score[2];
+	short int winner;
+} Undo;
+
+/* A move of a game, as kept in its undo log (see c4_game_undo()). */
 
-static int size_x, size_y, total_size;
-static int num_to_connect;
-static int win_places;
+typedef struct {
+	int column, row;
+	Undo undo;
+} Undo_entry;
+
+/* A game.  Everything that used to be global to this file lives here, */
+/* so that any number of games can be played (and searched) at once.   */
+
+struct C4_game {
+
+	C4_context *ctx;        /* The context the game was created in, or     */
+							/* NULL if it has none.                        */
+
+	Geometry *geo;
+
+	Game_state state_stack[C4_MAX_LEVEL + 1];
+	Game_state *current_state;
+	int depth;
+	char *arena;            /* The one block, aligned to a cache line,     */
+							/* holding the score arrays and boards of      */
+							/* every level of state_stack, saved_counts,   */
+							/* rule_flags and rule_drops (see              */
+							/* c4_game_new()).  Nothing is allocated once  */
+							/* the game has been set up.                   */
+
+	bool move_in_progress;
+	void(*poll_function)(void);
+	clock_t poll_interval, next_poll;
+
+	c4_atomic stop;         /* Set to abandon the search in progress.      */
+	long nodes;             /* Positions evaluated by the current search.  */
+	C4_eval_function leaf_eval;
+	void *leaf_data;        /* How the current search scores its leaves,   */
+	int rule_weight;        /* and the weight for blend_leaf().            */
+	C4_rule_stats *rule_stats;
+							/* Where the rules are profiled into, or NULL. */
+	C4_log *log;            /* Where the moves of the computer are logged, */
+	int log_tag;            /* or NULL, and the game's tag in the log.     */
+	unsigned int random_state;
+
+	C4_bits *bits;          /* The game's bitboards, loaded for each move. */
+	bool in_place;          /* Whether the current search makes its moves  */
+							/* in place (see search_drop()) rather than on */
+							/* copies of the state.                        */
+	unsigned char *saved_counts;
+							/* The score_array counts search_drop() saves  */
+							/* in place: room for max_places pairs for     */
+							/* each level of the search.                   */
+	int *rule_flags;        /* The scores of the columns and the drops     */
+	C4_rule_drop *rule_drops;
+							/* of c4_game_apply_rule(), one for each       */
+							/* column.                                     */
+	Undo_entry *undo_log;   /* The moves made on the game since its board  */
+	int undo_length;        /* was last set up, the latest last, and the   */
+	unsigned char *undo_counts;
+							/* score_array counts each changed: room for   */
+							/* max_places pairs for each cell.  Both are   */
+							/* in the arena.                               */
+	int(*in_place_search)(C4_game *g, int player, int level, int alpha,
+		int beta);          /* The search made in place: std_evaluate() on */
+							/* the standard board, evaluate() otherwise.   */
+
+	C4_memory memory;       /* The memory the game takes up, but for its   */
+							/* geometry.                                   */
+
+	C4_table *table;        /* The transposition table of the current      */
+	uint64_t hash;          /* search, or NULL, and the key of the board   */
+							/* it has reached (see board_key()).           */
+	long table_probes, table_hits;
+};
+
+/* A context, which owns a pool of worker threads and a queue of the   */
+/* asynchronous moves waiting for one of them.                         */
+
+struct C4_context {
+	c4_mutex lock;
+	c4_cond work_ready;     /* Signalled when the queue becomes non-empty. */
+	c4_cond work_done;      /* Broadcast whenever a move completes.        */
+	c4_thread *threads;
+	int num_threads;
+	C4_async *queue_head, *queue_tail;
+	bool shutting_down;
+	C4_memory memory;       /* The memory of the context and of the games  */
+							/* in it, but for their geometries.  It is     */
+							/* guarded by geometry_lock.                   */
+};
+
+/* An asynchronous move.  It is referenced both by the caller and by the */
+/* worker thread that runs it, and is freed when both have let go.       */
+
+struct C4_async {
+	C4_context *ctx;
+	C4_game *game;
+	C4_move_params params;
+	C4_move_callback callback;
+	void *user_data;
+	C4_move_result result;
+	int status;
+	bool cancel_requested;
+	int references;
+	C4_async *next;
+};
+
+/* The most geometries the cache keeps when no game is using them. */
+
+#define GEOMETRY_CACHE 8
 
-static int ***map;  /* map[x][y] is an array of win place indices, */
-					/* terminated by a -1.                         */
+/* Static global variables. */
 
-static int magic_win_number;
-static bool game_in_progress = false, move_in_progress = false;
-static bool seed_chosen = false;
+static Geometry *geometries = NULL; /* The cache of geometries, the most */
+									/* recently used first.  It and the */
+static c4_atomic geometry_lock = 0; /* accounts of memory are guarded   */
+									/* by geometry_lock, which is 1     */
+									/* while a thread holds it.         */
+static C4_memory memory_used;       /* The memory taken up by the       */
+static size_t memory_limit = 0;     /* engine, and the most it may take */
+									/* up (0 for no limit).             */
+static C4_game *the_game = NULL;    /* The game played through the      */
+									/* original, handle-less interface. */
+static c4_atomic games_made = 0;    /* The number of games made, which  */
+									/* goes into the seed of each.      */
 static void(*poll_function)(void) = NULL;
-static clock_t poll_interval, next_poll;
-static Game_state state_stack[C4_MAX_LEVEL + 1];
-static Game_state *current_state;
-static int depth;
-static int states_allocated = 0;
-static int *drop_order;
+static clock_t poll_interval;
+static C4_rule_stats *rule_stats = NULL;
+static C4_log *move_log = NULL;
+static C4_table *move_table = NULL;
+static C4_move_result last_move;    /* The last move made by the        */
+static bool last_move_made = false; /* computer, if there is one.       */
 
 /* A declaration of the local functions. */
 
+static Geometry *new_geometry(int width, int height, int num);
+static size_t geometry_size(int width, int height, int num);
+static void free_geometry(Geometry *geo);
+static Geometry *get_geometry(int width, int height, int num);
+static void release_geometry(Geometry *geo);
+static void free_unused_geometries(void);
+static Geometry *find_geometry(int width, int height, int num);
+static void lock_geometries(void);
+static void unlock_geometries(void);
+static bool reserve_memory(C4_context *ctx, const C4_memory *bytes);
+static void release_memory(C4_context *ctx, const C4_memory *bytes);
+static void count_memory(C4_memory *usage, const C4_memory *bytes,
+	bool add);
 static int num_of_win_places(int x, int y, int n);
-static void update_score(int player, int x, int y);
-static int drop_piece(int player, int column);
-static void push_state(void);
-static int evaluate(int player, int level, int alpha, int beta);
+static int num_of_win_places_at(int x, int y, int n, int i, int j);
+static bool update_score(C4_game *g, int player, int x, int y);
+static void clear_state(C4_game *g);
+static bool load_moves(C4_game *g, const int *columns, int num_moves,
+	int first_player, bool sliding);
+static bool slide_pays(const Geometry *geo, int pieces);
+static bool score_board(C4_game *g, bool winners[2]);
+static void score_line(C4_game *g, int x, int y, int dx, int dy, int length,
+	int index, int step, bool winners[2]);
+static void find_win_place(C4_game *g);
+static int drop_piece(C4_game *g, int player, int column);
+static int play_move(C4_game *g, int player, int column);
+static void push_state(C4_game *g);
+static void copy_state(const Geometry *geo, Game_state *to,
+	const Game_state *from);
+static int search_drop(C4_game *g, int player, int column, Undo *undo);
+static void search_undo(C4_game *g, int column, int row, const Undo *undo);
+static void save_move(C4_game *g, int column, int row, Undo *undo,
+	unsigned char *saved);
+static void unmake_move(C4_game *g, int column, int row, const Undo *undo,
+	const unsigned char *saved);
+static int evaluate(C4_game *g, int player, int level, int alpha, int beta);
+static bool probe_table(C4_game *g, int player, int level, int alpha,
+	int beta, int *best, int *column);
+static void store_table(C4_game *g, int player, int level, int alpha,
+	int beta, int best, int column);
+static bool to_table(C4_game *g, int goodness, int *score);
+static int from_table(C4_game *g, int score);
+static uint64_t board_key(C4_game *g);
+static size_t table_buckets(size_t bytes);
+static int std_evaluate(C4_game *g, int player, int level, int alpha,
+	int beta);
+static bool std_drop_counts(unsigned char *score_array, int cell,
+	int player, unsigned char *saved, int differences[2]);
+static void std_undo_counts(unsigned char *score_array, int cell,
+	const unsigned char *saved);
+#ifndef NDEBUG
+static bool std_geometry_matches(const Geometry *geo);
+#endif
+static bool auto_move(C4_game *g, const C4_move_params *params,
+	C4_move_result *result);
+static int next_random(C4_game *g);
+static void release_async(C4_async *handle);
+static C4_THREAD_PROC(worker_main, arg);
 static void *emalloc(size_t size);
+static void *emalloc_aligned(size_t size);
+static void free_aligned(void *ptr);
 
-static int eval_rule(int ruleOfCol[]);
+static void eval_drops(C4_game *g, int player, C4_rule_drop drops[]);
+static int rule_total(C4_game *g, int own);
+static int heuristic_leaf(C4_game *g, int player, void *user_data);
+static int rule_leaf(C4_game *g, int player, void *user_data);
+static int blend_leaf(C4_game *g, int player, void *user_data);
+static int network_leaf(C4_game *g, int player, void *user_data);
+static int clamp_leaf(long long score);
+
+/* The built-in leaf evaluations, by C4_EVAL_ value.  C4_EVAL_CUSTOM has */
+/* none, as the caller supplies it.                                       */
+
+static const C4_eval_function leaf_evals[] = {
+	heuristic_leaf, rule_leaf, blend_leaf, NULL, network_leaf
+};
 
 
 /****************************************************************************/
@@ -122,6 +429,8 @@ c4_poll(void(*poll_func)(void), clock_t interval)
 {
 	poll_function = poll_func;
 	poll_interval = interval;
+	if (the_game != NULL)
+		c4_game_poll(the_game, poll_func, interval);
 }
 
 
@@ -135,139 +444,25 @@ c4_poll(void(*poll_func)(void), clock_t interval)
 /**  num is the number of pieces required to connect in a row in order to  **/
 /**  win the game.                                                         **/
 /**                                                                        **/
+/**  A value of false is returned, and no game is set up, if the game      **/
+/**  would take the engine over its memory limit (see                      **/
+/**  c4_set_memory_limit()).                                               **/
+/**                                                                        **/
 /****************************************************************************/
 
-void
+bool
 c4_new_game(int width, int height, int num)
 {
-	register int i, j, k, x;
-	int win_index, column;
-	int *win_indices;
-
-	assert(!game_in_progress);
-	assert(width >= 1 && height >= 1 && num >= 1);
-
-	size_x = width;
-	size_y = height;
-	total_size = width * height;
-	num_to_connect = num;
-	magic_win_number = 1 << num_to_connect;
-	win_places = num_of_win_places(size_x, size_y, num_to_connect);
-
-	/* Set up a random seed for making random decisions when there is */
-	/* equal goodness between two moves.                              */
-
-	if (!seed_chosen) {
-		srand((unsigned int)time((time_t *)0));
-		seed_chosen = true;
-	}
-
-	/* Set up the board */
-
-	depth = 0;
-	current_state = &state_stack[0];
-
-	current_state->board = (char **)emalloc(size_x * sizeof(char *));
-	for (i = 0; i<size_x; i++) {
-		current_state->board[i] = (char *)emalloc(size_y);
-		for (j = 0; j<size_y; j++)
-			current_state->board[i][j] = C4_NONE;
-	}
-
-	/* Set up the score array */
-
-	current_state->score_array[0] = (int *)emalloc(win_places * sizeof(int));
-	current_state->score_array[1] = (int *)emalloc(win_places * sizeof(int));
-	for (i = 0; i<win_places; i++) {
-		current_state->score_array[0][i] = 1;
-		current_state->score_array[1][i] = 1;
-	}
-
-	current_state->score[0] = current_state->score[1] = win_places;
-	current_state->winner = C4_NONE;
-	current_state->num_of_pieces = 0;
-
-	states_allocated = 1;
-
-	/* Set up the map */
-
-	map = (int ***)emalloc(size_x * sizeof(int **));
-	for (i = 0; i<size_x; i++) {
-		map[i] = (int **)emalloc(size_y * sizeof(int *));
-		for (j = 0; j<size_y; j++) {
-			map[i][j] = (int *)emalloc((num_to_connect * 4 + 1) * sizeof(int));
-			map[i][j][0] = -1;
-		}
-	}
-
-	win_index = 0;
-
-	/* Fill in the horizontal win positions */
-	for (i = 0; i<size_y; i++)
-		for (j = 0; j<size_x - num_to_connect + 1; j++) {
-			for (k = 0; k<num_to_connect; k++) {
-				win_indices = map[j + k][i];
-				for (x = 0; win_indices[x] != -1; x++)
-					;
-				win_indices[x++] = win_index;
-				win_indices[x] = -1;
-			}
-			win_index++;
-		}
-
-	/* Fill in the vertical win positions */
-	for (i = 0; i<size_x; i++)
-		for (j = 0; j<size_y - num_to_connect + 1; j++) {
-			for (k = 0; k<num_to_connect; k++) {
-				win_indices = map[i][j + k];
-				for (x = 0; win_indices[x] != -1; x++)
-					;
-				win_indices[x++] = win_index;
-				win_indices[x] = -1;
-			}
-			win_index++;
-		}
-
-	/* Fill in the forward diagonal win positions */
-	for (i = 0; i<size_y - num_to_connect + 1; i++)
-		for (j = 0; j<size_x - num_to_connect + 1; j++) {
-			for (k = 0; k<num_to_connect; k++) {
-				win_indices = map[j + k][i + k];
-				for (x = 0; win_indices[x] != -1; x++)
-					;
-				win_indices[x++] = win_index;
-				win_indices[x] = -1;
-			}
-			win_index++;
-		}
-
-	/* Fill in the backward diagonal win positions */
-	for (i = 0; i<size_y - num_to_connect + 1; i++)
-		for (j = size_x - 1; j >= num_to_connect - 1; j--) {
-			for (k = 0; k<num_to_connect; k++) {
-				win_indices = map[j - k][i + k];
-				for (x = 0; win_indices[x] != -1; x++)
-					;
-				win_indices[x++] = win_index;
-				win_indices[x] = -1;
-			}
-			win_index++;
-		}
-
-	/* Set up the order in which automatic moves should be tried. */
-	/* The columns nearer to the center of the board are usually  */
-	/* better tactically and are more likely to lead to a win.    */
-	/* By ordering the search such that the central columns are   */
-	/* tried first, alpha-beta cutoff is much more effective.     */
+	assert(the_game == NULL);
 
-	drop_order = (int *)emalloc(size_x * sizeof(int));
-	column = (size_x - 1) / 2;
-	for (i = 1; i <= size_x; i++) {
-		drop_order[i - 1] = column;
-		column += ((i % 2) ? i : -i);
-	}
-
-	game_in_progress = true;
+	the_game = c4_game_new(NULL, width, height, num);
+	if (the_game == NULL)
+		return false;
+	c4_game_poll(the_game, poll_function, poll_interval);
+	c4_game_profile_rules(the_game, rule_stats);
+	c4_game_log_moves(the_game, move_log, 0);
+	last_move_made = false;
+	return true;
 }
 
 
@@ -286,16 +481,73 @@ c4_new_game(int width, int height, int num)
 bool
 c4_make_move(int player, int column, int *row)
 {
-	assert(game_in_progress);
-	assert(!move_in_progress);
+	assert(the_game != NULL);
+	return c4_game_make_move(the_game, player, column, row);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function takes back the last num moves made on the current game, **/
+/**  by c4_make_move(), c4_auto_move() or apply_rule(), latest first.  A   **/
+/**  value of true is returned if it is successful, or false, with nothing **/
+/**  taken back, if fewer than num moves have been made since the board    **/
+/**  was set up by c4_new_game(), c4_restart(), c4_load_moves() or         **/
+/**  c4_load_position().  Each move costs no more than making it did.      **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_undo(int num)
+{
+	assert(the_game != NULL);
 
-	if (column >= size_x || column < 0)
+	if (!c4_game_undo(the_game, num))
 		return false;
+	if (num > 0)
+		last_move_made = false;
+	return true;
+}
 
-	int result = drop_piece(real_player(player), column);
-	if (row != NULL && result >= 0)
-		*row = result;
-	return (result >= 0);
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets the current game up in the position reached by     **/
+/**  dropping pieces into the given columns, num_moves of them, the        **/
+/**  players taking turns from first_player.  It comes to the same as      **/
+/**  replaying the moves with c4_make_move(), but the state is built from  **/
+/**  the finished board in one go rather than scored move by move.  A      **/
+/**  value of false is returned if a move is not on the board or is into   **/
+/**  a full column, in which case the board is left empty.                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_load_moves(const int *columns, int num_moves, int first_player)
+{
+	assert(the_game != NULL);
+	last_move_made = false;
+	return c4_game_load_moves(the_game, columns, num_moves, first_player);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets the current game up in the position shown by       **/
+/**  board, which is laid out as for c4_board() (and may be the board of   **/
+/**  another game of the same size, or one read from a corpus).  A value   **/
+/**  of false is returned if board is not a position that can be reached   **/
+/**  (a piece is over an empty cell, or both players have connected), in   **/
+/**  which case the board is left empty.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_load_position(char **board)
+{
+	assert(the_game != NULL);
+	last_move_made = false;
+	return c4_game_load_position(the_game, board);
 }
 
 
@@ -319,2359 +571,3363 @@ c4_make_move(int player, int column, int *row)
 bool
 c4_auto_move(int player, int level, int *column, int *row)
 {
-	int best_column = -1, goodness = 0, best_worst = -(INT_MAX);
-	int num_of_equal = 0, real_player, current_column, result;
-
-	assert(game_in_progress);
-	assert(!move_in_progress);
-	assert(level >= 1 && level <= C4_MAX_LEVEL);
-
-	real_player = real_player(player);
+	C4_move_params params;
+	C4_move_result result;
 
-	/* It has been proven that the best first move for a standard 7x6 game  */
-	/* of connect-4 is the center column.  See Victor Allis' masters thesis */
-	/* ("ftp://ftp.cs.vu.nl/pub/victor/connect4.ps") for this proof.        */
-
-	if (current_state->num_of_pieces < 1 &&
-		size_x == 7 && size_y == 6 && num_to_connect == 4 &&
-		(current_state->num_of_pieces == 0 ||
-			current_state->board[3][0] != C4_NONE)) {
-		if (column != NULL)
-			*column = 2;
-		if (row != NULL)
-			*row = current_state->num_of_pieces;
-		drop_piece(real_player, 2);
-		printf("coordinate : (1, %d)\n", *column+1);
-		return true;
-	}
-
-	if (current_state->num_of_pieces == 1) {
-		if (column != NULL)
-			*column = 3;
-		if (row != NULL)
-			*row = current_state->num_of_pieces;
-		drop_piece(real_player, 3);
-		printf("coordinate : (1, %d)\n", *column+1);
-		return true;
-	}
-
-
-	move_in_progress = true;
-
-	/* Simulate a drop in each of the columns and see what the results are. */
-
-	for (int i = 0; i<size_x; i++) {
-		push_state();
-		current_column = drop_order[i];
-
-		result = drop_piece(real_player, current_column);
-
-		/* If this column is full, ignore it as a possibility. */
-		if (result < 0) {
-			pop_state();
-			continue;
-		}
-
-		/* If this drop wins the game, take it! */
-		else if (current_state->winner == real_player) {
-			best_column = current_column;
-			pop_state();
-			break;
-		}
+	assert(the_game != NULL);
 
-		/* Otherwise, look ahead to see how good this move may turn out */
-		/* to be (assuming the opponent makes the best moves possible). */
-		else {
-			next_poll = clock() + poll_interval;
-			goodness = evaluate(real_player, level, -(INT_MAX), -best_worst);
-		}
+	memset(&params, 0, sizeof(params));
+	params.player = player;
+	params.level = level;
+	params.table = move_table;
+	last_move_made = c4_game_auto_move(the_game, &params, &result);
+	if (!last_move_made)
+		return false;
+	last_move = result;
 
-		/* If this move looks better than the ones previously considered, */
-		/* remember it.                                                   */
-		if (goodness > best_worst) {
-			best_worst = goodness;
-			best_column = current_column;
-			num_of_equal = 1;
-		}
+	if (column != NULL)
+		*column = result.column;
+	if (row != NULL)
+		*row = result.row;
+	return true;
+}
 
-		/* If two moves are equally as good, make a random decision. */
-		else if (goodness == best_worst) {
-			num_of_equal++;
-			if ((rand() >> 4) % num_of_equal == 0)
-				best_column = current_column;
-		}
+/////////////****************rule function*********************///////////////
 
-		pop_state();
-	}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function has the computer make a move for the specified player   **/
+/**  by the rules, rather than by searching.  The column and row where the **/
+/**  piece ended up are returned as for c4_auto_move(), and the rest of    **/
+/**  the report on the move can be had from c4_move_report().              **/
+/**                                                                        **/
+/****************************************************************************/
 
-	move_in_progress = false;
+void apply_rule(int player, int *column, int *row) {
+	assert(the_game != NULL);
 
-	/* Drop the piece in the column decided upon. */
+	last_move_made = c4_game_apply_rule(the_game, player, &last_move);
+	if (!last_move_made)
+		return;
 
-	if (best_column >= 0) {
-		result = drop_piece(real_player, best_column);
-		if (column != NULL)
-			*column = best_column;
-		if (row != NULL)
-			*row = result;
-		printf("coordinate : (%d, %d)\n",result+1 , *column + 1);
-		return true;
-	}
-	else
-		return false;
+	if (column != NULL)
+		*column = last_move.column;
+	if (row != NULL)
+		*row = last_move.row;
 }
 
-/////////////****************rule function*********************///////////////
-int ruleflag[7];
-//int rule_index;
-int ruleOfCol[7][8] = { 0 };
 
-void apply_rule(int player, int *column, int *row) {
-	int max = -300001;
+/****************************************************************************/
+/**                                                                        **/
+/**  This function is the handle-based equivalent of apply_rule().  The    **/
+/**  move is reported in result as for c4_game_auto_move(): score is what  **/
+/**  the rules made of the column chosen (0 for an opening move),          **/
+/**  rules_fired[] the rules which scored in it, and stats.nodes the       **/
+/**  number of columns scored.  A value of false is returned if the board  **/
+/**  is full.                                                              **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool c4_game_apply_rule(C4_game *g, int player, C4_move_result *result) {
+	int max = INT_MIN;
 	int max_col = -100000;
 
 
-	int real_player, result;
+	int real_player;
+	double start = c4_wall_time();
 
-	assert(game_in_progress);
-	assert(!move_in_progress);
+	assert(!g->move_in_progress);
 
+	int width = g->geo->size_x, top = g->geo->size_y - 1;
+	int center = (width - 1) / 2;
+	int *ruleflag = g->rule_flags;
+	C4_rule_drop *drops = g->rule_drops;
 
 	real_player = real_player(player);
+	result->moved = false;
+	result->score = 0;
+	result->num_rules_fired = 0;
+	result->stats.nodes = 0;
+	result->stats.table_probes = result->stats.table_hits = 0;
 
-	//߰Į   
-	for (int i = 0; i<4; i++) {
-		ruleflag[i] = i + 5;
-	}
-	for (int i = 4; i<7; i++) {
-		ruleflag[i] = ruleflag[6 - i];
+	/* Favour the columns nearest the center. */
+
+	for (int i = 0; i<width; i++) {
+		ruleflag[i] = 5 + ((i < width - 1 - i) ? i : width - 1 - i);
 	}
 
-	if (current_state->num_of_pieces < 1) {
-		if (column != NULL)
-			*column = 2;  
-		if (row != NULL)
-			*row = current_state->num_of_pieces;
-		int r=drop_piece(real_player, 2);
-		printf("I chosed the rule 0\n");
-		printf("coordinate : (%d, %d)\n", r+1, *column + 1);
-		return;
+	if (g->current_state->num_of_pieces < 1 && center > 0) {
+		max_col = center - 1;
+		result->rules_fired[result->num_rules_fired++] = 0;
 	}
 
-	else if (current_state->num_of_pieces < 4) {
-		if (column != NULL)
-			*column = 3;  
-		if (row != NULL)
-			*row = current_state->num_of_pieces;
-		int r=drop_piece(real_player, 3);
-		printf("I chosed the rule 0\n");
-		printf("coordinate : (%d, %d)\n", r + 1, *column + 1);
-		return;
+	else if (g->current_state->num_of_pieces < 4 &&
+		g->current_state->board[center][top] == C4_NONE) {
+		max_col = center;
+		result->rules_fired[result->num_rules_fired++] = 0;
 	}
 
+	else {
+		eval_drops(g, real_player, drops);
 
+		for (int i = 0; i<width; i++) {
+			if (drops[i].row == -1) {
+				ruleflag[i] = -300000;
+				continue;
+			}
 
-	for (int i = 0; i<7; i++) {
-		push_state();
-		int numrow = drop_piece(real_player, i);
-		if (numrow == -1) {
-			ruleflag[i] = -300000;
-			//      printf("ruleflag%d= %d\n", i + 1, ruleflag[i]);
-			pop_state();
-			continue;
+			else {
+				ruleflag[i] += drops[i].total;
+				result->stats.nodes++;
+			}
 		}
 
-		else {
-			ruleflag[i] += eval_rule(ruleOfCol[i]);
-			//       printf("ruleflag%d= %d\n", i + 1, ruleflag[i]);
-			pop_state();
-
+		for (int i = 0; i<width; i++) {
+			if (max<ruleflag[i] && drops[i].row != -1) {
+				max = ruleflag[i];
+				max_col = i;
+			}
 		}
-	}
 
-	for (int i = 0; i<7; i++) {
-		if (max<ruleflag[i]) {
-			max = ruleflag[i];
-			max_col = i;
+		if (max_col >= 0) {
+			if (g->rule_stats != NULL)
+				c4_rule_stats_add_move(g->rule_stats, &drops[max_col]);
+
+			result->score = ruleflag[max_col];
+			for (int i = 0; i < drops[max_col].num_fired; i++) {
+				result->rules_fired[result->num_rules_fired++] =
+					drops[max_col].fired[i];
+			}
 		}
 	}
 
-	result = drop_piece(real_player, max_col);
-	//    printf("I chosed the rule %d\n", rule_index+1);
-
-	
+	if (max_col < 0)
+		return false;
 
-	for (int i = 0; i < 8; i++) {
-		if (ruleOfCol[max_col][i] > 0)
-			printf("I chosed the rule %d\n", ruleOfCol[max_col][i]);
-	}
-	
+	result->row = play_move(g, real_player, max_col);
 
-	if (column != NULL)
-		*column = max_col;
-	if (row != NULL) 
-		*row = result;
-	printf("coordinate : (%d, %d)\n", result + 1, *column + 1);
-	return;
+	result->moved = true;
+	result->column = max_col;
+	result->stats.seconds = c4_wall_time() - start;
+	if (g->log != NULL)
+		c4_log_move(g->log, g->log_tag, g->current_state->num_of_pieces,
+			player, result);
+	return true;
 
 }
 
-int eval_rule(int nthCol[]) {
-	int score = 0;
-	int total = 0;
-	int rule[8];
-	for (int k = 0; k < 8; k++) {
-		rule[k] = 0;
-	}
-	for (int i = 0; i <= 6; i++) {//
-		for (int j = 0; j <= 5; j++) {//
-									  /*rule 1*/  //AI  4 Ǹ ٷ ´.
-			if (i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1) {
-				/*   if (i > 0 && current_state->board[i][j-1] != C4_NONE && current_state->board[i + 1][j - 1] != C4_NONE && current_state->board[i + 2][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-				//*/
-				score = 5000000;
-				rule[0] += score;
-				//   printf("1-1\n");
-				//}
-			}
-			/* 
-			//first line
-			else if (j == 0 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1) {
-			score = 500000;
-			rule[0] += score;
-			}*/
-
-			else if (j<3 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == 1 && current_state->board[i][j + 2] == 1 && current_state->board[i][j + 3] == 1) {
-				score = 5000000;
-				rule[0] += score;
-				//
-			}
-			else if (i < 4 && j < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1) {
-				/*   if (current_state->board[i][j-1] != C4_NONE && current_state->board[i+1][j - 1] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE && current_state->board[i + 3][j + 2] != C4_NONE) {*/
-				score = 5000000;
-				rule[0] += score;
-				//밢 
-				//    }
-			}
-			//first line
-			/*   else if (i < 4 && j == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1) {
-			score = 5000000;
-			rule[0] += score;
-			//밢 
-			}*/
-
-
-			else if (j > 2 && i<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-				/*     if (i > 3 && current_state->board[i][j-1] != C4_NONE && current_state->board[i +1][j - 2] != C4_NONE && current_state->board[i + 2][j - 3] != C4_NONE && current_state->board[i + 3][j - 4] != C4_NONE) {*/
-				score = 5000000;
-				rule[0] += score;
-				//      }
-				//밢 
-			}
-			//first line
-			/*     else if (j == 3 && i<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-			score = 5000000;
-			rule[0] += score;
-			//밢 
-			}*/
-
-
-			/*rule 2*/  //ΰ  4 Ǹ ´.
-			if (i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i + 3][j] == 0) {
-				if (i < 3 && current_state->board[i + 4][j] == 1) {
-					score = 300000;
-					rule[1] += score;
-				}
-				score = 250000;
-				rule[1] += score;
-				//horizontal OXXX_(_!=X)
-			}
-			/*
-			//first line
-			if (j == 0 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i+1][j] == 0 && current_state->board[i+2][j] == 0 && current_state->board[i+3][j] == 0) {
-			if (i < 3 && current_state->board[i+4][j] == 1) {
-			score = 300000;
-			rule[1] += score;
-			}
-			score = 250000;
-			rule[1] += score;
-			//horizontal OXXX_(_!=X)
-			}*/
-
-			if (i < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i + 3][j] == 1) {
-				if (i > 0 && current_state->board[i - 1][j] == 1) {
-					score = 300000;
-					rule[1] += score;
-				}
-				score = 250000;
-				rule[1] += score;
-				//horizontal _XXXO(_!=X)
-			}
-			/*
-			//first line
-			if (j == 0 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i+1][j] == 0 && current_state->board[i+2][j] == 0 && current_state->board[i+3][j] == 1) {
-			score = 250000;
-			rule[1] += score;
-			//horizontal _XXXO(_!=X)
-			}
-			*/
-
-			if (i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 0) {
-				//  if (current_state->board[i +2][j-1] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//  printf("2-5\n");
-				//   }
-				//horizontal XXOX
-			}
-			/*
-			//first line
-			if (j == 0 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i+1][j] == 0 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 0) {
-			score = 250000;
-			rule[1] += score;
-			//horizontal XXOX
-			//    printf("2-6\n");
-			}*/
-
-			if (i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 0 && current_state->board[i + 3][j] == 0) {
-				// if (current_state->board[i + 1][j - 1] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//     printf("2-7\n");
-				// }   //horizontal XOXX
-			}
-			/*
-			//first line
-			if (j == 0 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 0 && current_state->board[i+3][j] == 0) {
-			score = 250000;
-			rule[1] += score;
-			//horizontal XOXX
-			//  printf("2-8\n");
-			}*/
-
-			if (j<3 && current_state->board[i][j] == 0 && current_state->board[i][j + 1] == 0 && current_state->board[i][j + 2] == 0 && current_state->board[i][j + 3] == 1) {
-				if (j > 0 && current_state->board[i][j - 1] == 1) {//
-					score = 300000;
-					rule[1] += score;
-				}
-				//return 250; 
-				score = 250000;
-				rule[1] += score;
-				//  printf("2-9\n");
-			} //vertical
-
-			if (j < 3 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 0 && current_state->board[i + 3][j + 3] == 0) {
-				if (i < 3 && j < 2 && current_state->board[i + 4][j + 4] == 1) {//
-					score = 300000;
-					rule[1] += score;
-				}
-				//    if (current_state->board[i + 4][j + 3] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//      printf("2-10\n");
-				//  }
-				//diagonal OXXX_(_!=X) ascending
-			}
-			/*
-			//first line
-			if (j == 0 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 0 && current_state->board[i + 3][j + 3] == 0) {
-			score = 250000;
-			rule[1] += score;
-			//      printf("2-10\n");
-			//diagonal OXXX_(_!=X) ascending
-			}*/
-
-
-			if (j < 3 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 0 && current_state->board[i + 3][j + 3] == 1) {
-				if (i > 0 && j > 0 && current_state->board[i - 1][j - 1] == 1) {
-					score = 300000;
-					rule[1] += score;
-				} 
-				  //      if (current_state->board[i][j-1] != C4_NONE && current_state->board[i + 4][j + 3] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//       printf("2-11\n");
-				//        }
-
-				//diagonal _XXXO(_!=X) ascending
-			}
-			/*
-			//first line
-			if (j == 0 && j < 3 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 0 && current_state->board[i + 3][j + 3] == 1) {
-			score = 250000;
-			rule[1] += score;
-			//   printf("2-12\n");
-			//diagonal _XXXO(_!=X) ascending
-			}
-
-			*/
-			if (j < 3 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 0) {
-				//      if (current_state->board[i + 2][j + 1] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//   printf("2-13\n");
-				//    }
-
-				//diagonal XXOX ascending
-			}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function evaluates the rules used by apply_rule(), from the      **/
+/**  point of view of player 1, on each of the states which follow the     **/
+/**  current one when the specified player drops a piece in one of its     **/
+/**  columns.  drops[x] is filled in for column x (see "c4rule.h").  All   **/
+/**  of the columns are scored in one go, without pushing any states; the  **/
+/**  rules themselves, and the bitboard engine which matches them, are in  **/
+/**  "c4rule.c".                                                           **/
+/**                                                                        **/
+/**  Where c4_rule_update() pays, the drops are scored from the scores of  **/
+/**  the current state, which drop_piece() then keeps up to date.  While   **/
+/**  the rules are being profiled, each drop is evaluated in full instead, **/
+/**  so that every rule is seen at work on it.                             **/
+/**                                                                        **/
+/****************************************************************************/
 
-			if (j < 3 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 0 && current_state->board[i + 3][j + 3] == 0) {
-				//       if (current_state->board[i+1][j] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//     printf("2-14\n");
-				//     }
+static void
+eval_drops(C4_game *g, int player, C4_rule_drop drops[])
+{
+	Geometry *geo = g->geo;
+	char **board = g->current_state->board;
 
-				//diagonal XOXX ascending
-			}
+	if (g->rule_stats == NULL && c4_rule_incremental(geo->rules)) {
+		rule_total(g, 1);
+		c4_rule_eval_drops(geo->rules, board, 1, player,
+			g->current_state->rule_score[1], drops, NULL);
+	}
+	else
+		c4_rule_eval_drops(geo->rules, board, 1, player, NULL, drops,
+			g->rule_stats);
+}
 
-			if (j > 2 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 0 && current_state->board[i + 3][j - 3] == 0) {
-				if (i < 3 && j > 3 && current_state->board[i + 4][j - 4] == 1) { //
-					score = 300000;
-				}
-				//    if (j > 4 && i>3 && current_state->board[i][j-1] != C4_NONE && current_state->board[i + 4][j - 5] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//   printf("2-15\n");
-
-				//  }
-				//diagonal OXXX_(_!=X) descending
-			}
-			/*
-			//first line
-			if (j == 3 && i <3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 0 && current_state->board[i+ 3][j - 3] == 0) {
-			score = 250000;
-			rule[1] += score;
-			//       printf("2-16\n");
-			//diagonal OXXX_(_!=X) descending
-			}
-			*/
-			if (j > 2 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 0 && current_state->board[i + 3][j - 3] == 1) {
-				if (i > 0 && j < 5 && current_state->board[i - 1][j + 1] == 1) {
-					score = 300000;
-					rule[1] += score;
-				} //score = 300;
-				  //         if (j > 4 && i>3 && (current_state->board[i][j-1] != C4_NONE || current_state->board[i - 4][j - 5] != C4_NONE)) {
-				score = 250000;
-				rule[1] += score;
-				//     printf("2-17\n");
-				//        }
-				//diagonal _XXXO(_!=X) descending
-			}/*
-			 //first line
-			 if (j == 3 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 0 && current_state->board[i + 3][j - 3] == 1) {
-			 score = 250000;
-			 rule[1] += score;
-			 //     printf("2-17\n");
-			 //diagonal _XXXO(_!=X) descending
-			 }
-			 */
-
-			if (j > 2 && i < 4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 0) {
-				//     if (current_state->board[i - 2][j - 3] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//   printf("2-18\n");
-
-				//      }
-				//diagonal XXOX descending
-			}
 
-			if (j > 2 && i<4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 0 && current_state->board[i + 3][j - 3] == 0) {
-				//    if (current_state->board[i - 1][j - 2] != C4_NONE) {
-				score = 250000;
-				rule[1] += score;
-				//    printf("2-19\n");
-				//  }
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the total score of the rules for player own on  **/
+/**  the current state.  The scores are kept in the state.  If they are    **/
+/**  not there yet, they are worked out from the whole board, and from     **/
+/**  then on drop_piece() keeps them up to date for the state and the      **/
+/**  states pushed from it.                                                **/
+/**                                                                        **/
+/****************************************************************************/
 
-				//diagonal XOXX descending
-			}
+static int
+rule_total(C4_game *g, int own)
+{
+	Game_state *state = g->current_state;
+	int l, total = 0;
+
+	if (!state->rules_valid[own]) {
+		if (g->rule_stats != NULL)
+			c4_rule_profile(g->geo->rules, state->board, own,
+				state->rule_score[own], g->rule_stats);
+		else
+			c4_rule_eval(g->geo->rules, state->board, own,
+				state->rule_score[own]);
+		state->rules_valid[own] = true;
+	}
 
-			/*rule 3*/ //
-					   //_OOO_ (both full) horizontal
-			if (i < 4 && i > 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 10000;
-					rule[2] += score;
-					//        printf("3-1\n");
-				}
-				else if (j == 0) {
-					score = 10000;
-					rule[2] += score;
-				}
-			}
-			//_OOO_ (both full) horizontal
-			//first line
-			/*
-			if (j == 0 && i > 0 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i-1][j] == C4_NONE && current_state->board[i+3][j] == C4_NONE) {
-			score = 10000;
-			rule[2] += score;
-			//      printf("3-2\n");
-			}*/
-
-			//_OOO_ (XOR full) horizontal
-			if (j > 0 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 4][j] == C4_NONE) {
-				if (current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j - 1] != C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//     printf("3-3\n");
-				}
-				else if (current_state->board[i][j - 1] != C4_NONE && current_state->board[i + 4][j] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//     printf("3-3\n");
-				}
-			}
-			//_OOO_ (both empty) horizontal
-			if (j > 0 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 4][j] == C4_NONE) {
-				if (current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j - 1] == C4_NONE) {
-					score = 2000;
-					rule[2] += score;
-					//        printf("3-4\n");
-
-				}
-			}
+	for (l = 0; l<C4_NUM_RULES; l++)
+		total += state->rule_score[own][l];
 
-			//_OOOX horizontal
-			if (i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 4][j] == 0) {
-				if (j > 0 && current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//       printf("3-5\n");
-				}//below empty
-				else if (j > 0 && current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-				}//below full
-				else if (j == 0) { // firstline
-					score = 300;
-					rule[2] += score;
-				}//first line
-			}
+	return total;
+}
 
-			//_OOOwall horizontal
-			if (i == 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1) {
-				if (j > 0 && current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//      printf("3-6\n");
-				}
-				else if (j > 0 && current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-				}
-				else if (j == 0) { // firstline
-					score = 300;
-					rule[2] += score;
-				}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns a two-dimensional array containing the state of **/
+/**  the game board.  Do not modify this array.  It is assumed that a game **/
+/**  is in progress.  The value of this array is dynamic and will change   **/
+/**  to reflect the state of the game as the game progresses.  It becomes  **/
+/**  and stays undefined when the game ends.                               **/
+/**                                                                        **/
+/**  The first dimension specifies the column number and the second        **/
+/**  dimension specifies the row number, where column and row numbering    **/
+/**  start at 0 and the bottow row is considered the 0th row.  A value of  **/
+/**  0 specifies that the position is occupied by a piece owned by player  **/
+/**  0, a value of 1 specifies that the position is occupied by a piece    **/
+/**  owned by player 1, and a value of C4_NONE specifies that the position **/
+/**  is unoccupied.                                                        **/
+/**                                                                        **/
+/****************************************************************************/
 
+char **
+c4_board(void)
+{
+	assert(the_game != NULL);
+	return c4_game_board(the_game);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the "score" of the specified player.  This      **/
+/**  score is a function of how many winning positions are still available **/
+/**  to the player and how close he/she is to achieving each of these      **/
+/**  positions.  The scores of both players can be compared to observe how **/
+/**  well they are doing relative to each other.                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_score_of_player(int player)
+{
+	assert(the_game != NULL);
+	return c4_game_score_of_player(the_game, player);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns true if the specified player has won the game,  **/
+/**  and false otherwise.                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_is_winner(int player)
+{
+	assert(the_game != NULL);
+	return c4_game_is_winner(the_game, player);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns true if the board is completely full without a  **/
+/**  winner, and false otherwise.                                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_is_tie(void)
+{
+	assert(the_game != NULL);
+	return c4_game_is_tie(the_game);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the coordinates of the winning connections of   **/
+/**  the winning player.  It is assumed that a player has indeed won the   **/
+/**  game.  The coordinates are returned in x1, y1, x2, y2, where (x1, y1) **/
+/**  specifies the lower-left piece of the winning connection, and         **/
+/**  (x2, y2) specifies the upper-right piece of the winning connection.   **/
+/**  If more than one winning connection exists, only one will be          **/
+/**  returned.                                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_win_coords(int *x1, int *y1, int *x2, int *y2)
+{
+	assert(the_game != NULL);
+	c4_game_win_coords(the_game, x1, y1, x2, y2);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function ends the current game.  It is assumed that a game is    **/
+/**  in progress.  It is illegal to call any other game function           **/
+/**  immediately after this one except for c4_new_game(), c4_poll() and    **/
+/**  c4_reset().                                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_end_game(void)
+{
+	assert(the_game != NULL);
+	assert(!the_game->move_in_progress);
+
+	c4_game_free(the_game);
+	the_game = NULL;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function resets the state of the algorithm to the starting state **/
+/**  (i.e., no game in progress and a NULL poll function).  There should   **/
+/**  no reason to call this function unless for some reason the calling    **/
+/**  algorithm loses track of the game state.  It is illegal to call any   **/
+/**  other game function immediately after this one except for             **/
+/**  c4_new_game(), c4_poll() and c4_reset().                              **/
+/**                                                                        **/
+/**  The geometries of the boards played on are cached, to be shared by    **/
+/**  the games on each shape; those no game is using are freed here.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_reset(void)
+{
+	if (the_game != NULL)
+		c4_end_game();
+	poll_function = NULL;
+	rule_stats = NULL;
+	move_log = NULL;
+	move_table = NULL;
+	last_move_made = false;
+	free_unused_geometries();
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function starts the current game over on an empty board, as      **/
+/**  ending it and calling c4_new_game() with the same dimensions would,   **/
+/**  but without giving up and allocating its memory again.  It is assumed **/
+/**  that a game is in progress (finished or not) and that no move is      **/
+/**  being made.                                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_restart(void)
+{
+	assert(the_game != NULL);
+
+	c4_game_restart(the_game);
+	last_move_made = false;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns a new game, independent of the current one, set **/
+/**  up at its current position (see c4_game_clone()).  It is assumed that **/
+/**  a game is in progress and that no move is being made.                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_game *
+c4_clone(void)
+{
+	assert(the_game != NULL);
+
+	return c4_game_clone(the_game);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function fills in usage with the memory taken up by the engine:  **/
+/**  that of every game, context and transposition table, and of the       **/
+/**  geometries of the boards played on, including those kept in the cache **/
+/**  for games to come.  Memory the caller allocates itself (logs,         **/
+/**  networks, corpora and the like) is not counted.  See also             **/
+/**  c4_context_memory_usage() and c4_game_memory_usage().                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_memory_usage(C4_memory *usage)
+{
+	lock_geometries();
+	*usage = memory_used;
+	unlock_geometries();
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function limits the memory the engine may take up, as reported   **/
+/**  by c4_memory_usage(), to bytes; 0 lifts the limit.  Once a new game   **/
+/**  would take the engine over the limit, the geometries in the cache     **/
+/**  that no game is using are freed, and if that is not enough the game   **/
+/**  is refused: c4_game_new() returns NULL, and c4_new_game() false.      **/
+/**  Games already set up are never touched, so the engine may stay over   **/
+/**  a limit lowered beneath what it is using until they are freed.        **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_set_memory_limit(size_t bytes)
+{
+	bool over;
+
+	lock_geometries();
+	memory_limit = bytes;
+	over = (bytes != 0 && memory_used.total > bytes);
+	unlock_geometries();
+
+	if (over)
+		free_unused_geometries();
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function profiles the rules used by apply_rule() into stats, for **/
+/**  the current game (if any) and every game after it, until it is called **/
+/**  again.  A stats of NULL stops the profiling.  What is gathered is     **/
+/**  added to stats, so it can be cleared with c4_rule_stats_clear() first **/
+/**  to profile afresh, or left alone to add up a run of games.  It can be **/
+/**  written out with c4_rule_stats_write_json().                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_profile_rules(C4_rule_stats *stats)
+{
+	rule_stats = stats;
+	if (the_game != NULL)
+		c4_game_profile_rules(the_game, stats);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function has every move made by the computer, in the current     **/
+/**  game (if any) and every game after it, put into log (see "c4log.c"),  **/
+/**  until it is called again.  A log of NULL stops the logging.  The      **/
+/**  engine itself does no I/O.                                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_log_moves(C4_log *log)
+{
+	move_log = log;
+	if (the_game != NULL)
+		c4_game_log_moves(the_game, log, 0);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function has the searches of c4_auto_move() keep what they find  **/
+/**  in table (see c4_table_new()), in the current game (if any) and every **/
+/**  game after it, until it is called again.  A table of NULL stops it.   **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_use_table(C4_table *table)
+{
+	move_table = table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns, through result, the report of the last move    **/
+/**  made by c4_auto_move() or apply_rule() in the current game: where the **/
+/**  piece went, its score, the rules that chose it and the search         **/
+/**  statistics.  A value of false is returned if there has been no such   **/
+/**  move, in which case result is left alone.                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_move_report(C4_move_result *result)
+{
+	if (!last_move_made)
+		return false;
+
+	*result = last_move;
+	return true;
+}
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the RCS string representing the version of      **/
+/**  this Connect-4 implementation.                                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+const char *
+c4_get_version(void)
+{
+	return "$Id: c4.c,v 3.11 2009/11/03 14:42:01 pomakis Exp pomakis $";
+}
+
+
+/****************************************************************************/
+/****************************************************************************/
+/**                                                                        **/
+/**  The following functions make up the handle-based interface.  Each     **/
+/**  C4_game is independent of every other, so different games may be      **/
+/**  played from different threads at once.  A single game must not be     **/
+/**  used from two threads at the same time.                               **/
+/**                                                                        **/
+/****************************************************************************/
+/****************************************************************************/
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function creates a context with a pool of num_threads worker     **/
+/**  threads, which are used to run the moves requested through            **/
+/**  c4_auto_move_async().  If num_threads is 0 or less, one worker thread **/
+/**  is started.  NULL is returned if the threads cannot be started.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_context *
+c4_context_new(int num_threads)
+{
+	C4_context *ctx;
+	int i;
+
+	if (num_threads < 1)
+		num_threads = 1;
+
+	ctx = (C4_context *)emalloc(sizeof(C4_context));
+	c4_mutex_init(&ctx->lock);
+	c4_cond_init(&ctx->work_ready);
+	c4_cond_init(&ctx->work_done);
+	ctx->queue_head = ctx->queue_tail = NULL;
+	ctx->shutting_down = false;
+	ctx->threads = (c4_thread *)emalloc(num_threads * sizeof(c4_thread));
+	ctx->num_threads = 0;
+
+	memset(&ctx->memory, 0, sizeof(C4_memory));
+	ctx->memory.other = ctx->memory.total =
+		sizeof(C4_context) + num_threads * sizeof(c4_thread);
+	lock_geometries();
+	count_memory(&memory_used, &ctx->memory, true);
+	unlock_geometries();
+
+	for (i = 0; i<num_threads; i++) {
+		if (c4_thread_create(&ctx->threads[i], worker_main, ctx) != 0) {
+			c4_context_free(ctx);
+			return NULL;
+		}
+		ctx->num_threads++;
+	}
+
+	return ctx;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function destroys a context.  Moves still waiting in the queue   **/
+/**  are cancelled, and the function waits for the moves already running   **/
+/**  to finish.  The games created in the context must be freed first.     **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_context_free(C4_context *ctx)
+{
+	int i;
+
+	if (ctx == NULL)
+		return;
+
+	c4_mutex_lock(&ctx->lock);
+	ctx->shutting_down = true;
+	c4_cond_broadcast(&ctx->work_ready);
+	c4_mutex_unlock(&ctx->lock);
+
+	for (i = 0; i<ctx->num_threads; i++)
+		c4_thread_join(ctx->threads[i]);
+
+	c4_cond_destroy(&ctx->work_ready);
+	c4_cond_destroy(&ctx->work_done);
+	c4_mutex_destroy(&ctx->lock);
+
+	lock_geometries();
+	assert(ctx->memory.states == 0);
+	count_memory(&memory_used, &ctx->memory, false);
+	unlock_geometries();
+
+	free(ctx->threads);
+	free(ctx);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function fills in usage with the memory taken up by a context    **/
+/**  and the games created in it.  The geometries of the boards are shared **/
+/**  by the games on them, in any context, so they are only counted by     **/
+/**  c4_memory_usage() and c4_game_memory_usage().                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_context_memory_usage(C4_context *ctx, C4_memory *usage)
+{
+	lock_geometries();
+	*usage = ctx->memory;
+	unlock_geometries();
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets up a new game in the given context (which may be   **/
+/**  NULL if the game will not be used with c4_auto_move_async()) and      **/
+/**  returns a handle to it.  width, height and num are as for             **/
+/**  c4_new_game().  The handle must be released with c4_game_free().      **/
+/**  NULL is returned if the game would take the engine over its memory    **/
+/**  limit (see c4_set_memory_limit()).                                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_game *
+c4_game_new(C4_context *ctx, int width, int height, int num)
+{
+	register int i, j;
+	C4_game *g;
+	Game_state *state;
+	Geometry *geo;
+	C4_memory memory;
+	int win_places;
+	size_t score_size, state_size, counts_size, flags_size, log_size;
+	size_t undo_counts_size, arena_size;
+	char *next;
+
+	assert(width >= 1 && height >= 1 && num >= 1);
+
+	geo = get_geometry(width, height, num);
+	if (geo == NULL)
+		return NULL;
+	win_places = geo->win_places;
+
+	/* Lay out the arena.  Each level of the stack gets a score array, */
+	/* followed by the pointers to the columns of its board and then   */
+	/* the columns themselves, one after another; each part starts on  */
+	/* a cache line.  The states are all set up here, so push_state()  */
+	/* only has to copy.                                               */
+
+	score_size = line_round(2 * win_places + C4_COUNT_PADDING);
+	state_size = score_size + line_round(width * sizeof(char *)) +
+		line_round(width * height);
+	counts_size = line_round(C4_MAX_LEVEL * 2 * geo->max_places);
+	flags_size = line_round(width * sizeof(int));
+	log_size = line_round(geo->total_size * sizeof(Undo_entry));
+	undo_counts_size = line_round(geo->total_size * 2 * geo->max_places);
+	arena_size = (C4_MAX_LEVEL + 1) * state_size + counts_size +
+		flags_size + log_size + undo_counts_size +
+		width * sizeof(C4_rule_drop);
+
+	/* Everything the game will take up is known now, so it can be */
+	/* refused before any of it is allocated.                      */
+
+	memset(&memory, 0, sizeof(C4_memory));
+	memory.states = aligned_size(arena_size);
+	memory.bitboards = c4_bits_size(geo->bits);
+	memory.other = sizeof(C4_game);
+	memory.total = memory.states + memory.bitboards + memory.other;
+	if (!reserve_memory(ctx, &memory)) {
+		release_geometry(geo);
+		free_unused_geometries();
+		return NULL;
+	}
+
+	g = (C4_game *)emalloc(sizeof(C4_game));
+	g->ctx = ctx;
+	g->geo = geo;
+	g->memory = memory;
+	g->table = NULL;
+	g->move_in_progress = false;
+	g->poll_function = NULL;
+	g->poll_interval = g->next_poll = 0;
+	c4_atomic_store(&g->stop, 0);
+	g->nodes = 0;
+	g->rule_stats = NULL;
+	g->log = NULL;
+	g->log_tag = 0;
+
+	/* Seed the random decisions made when there is equal goodness   */
+	/* between two moves.  Games made in the same second, on any     */
+	/* thread, are told apart by the count of games, spread over the */
+	/* bits of the seed by a large odd multiplier.                   */
+
+	g->random_state = (unsigned int)time((time_t *)0) ^
+		(unsigned int)c4_atomic_increment(&games_made) * 2654435761u;
+
+	g->arena = (char *)emalloc_aligned(arena_size);
+
+	next = g->arena;
+	for (i = 0; i <= C4_MAX_LEVEL; i++) {
+		state = &g->state_stack[i];
+		state->score_array = (unsigned char *)next;
+		memset(state->score_array + 2 * win_places, 0, C4_COUNT_PADDING);
+		state->board = (char **)(next + score_size);
+		state->board[0] = next + state_size - line_round(width * height);
+		for (j = 1; j<width; j++)
+			state->board[j] = state->board[j - 1] + height;
+		next += state_size;
+	}
+	g->saved_counts = (unsigned char *)next;
+	next += counts_size;
+	g->rule_flags = (int *)next;
+	next += flags_size;
+	g->undo_log = (Undo_entry *)next;
+	next += log_size;
+	g->undo_counts = (unsigned char *)next;
+	next += undo_counts_size;
+	g->rule_drops = (C4_rule_drop *)next;
+	g->undo_length = 0;
+
+	/* Set up the board and the score array */
+
+	g->depth = 0;
+	g->current_state = state = &g->state_stack[0];
+
+	memset(state->board[0], C4_NONE, width * height);
+	memset(state->score_array, 1, 2 * win_places);
+
+	state->score[0] = state->score[1] = win_places;
+	state->winner = C4_NONE;
+	state->num_of_pieces = 0;
+	state->rules_valid[0] = state->rules_valid[1] = false;
+
+	g->bits = c4_bits_new(g->geo->bits);
+	g->in_place = false;
+
+	/* The standard board is searched by a version of evaluate() with */
+	/* its shape built in.                                            */
+
+	if (width == STD_X && height == STD_Y && num == STD_N)
+		g->in_place_search = std_evaluate;
+	else
+		g->in_place_search = evaluate;
+
+	return g;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function ends a game created by c4_game_new() and releases all   **/
+/**  of its memory.  No move may be in progress on it.                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_game_free(C4_game *g)
+{
+	if (g == NULL)
+		return;
+
+	assert(!g->move_in_progress);
+
+	/* Free up the memory of all the states, in one go. */
+
+	free_aligned(g->arena);
+
+	c4_bits_free(g->bits);
+	release_geometry(g->geo);
+	release_memory(g->ctx, &g->memory);
+	free(g);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function is the handle-based equivalent of c4_restart().  See    **/
+/**  that function for documentation.                                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_game_restart(C4_game *g)
+{
+	assert(!g->move_in_progress);
+
+	clear_state(g);
+	c4_atomic_store(&g->stop, 0);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns a new game, in the same context as g, set up at **/
+/**  g's current position, as if the moves leading to it had been made on  **/
+/**  it, for playing out a variation without disturbing g.  Only the       **/
+/**  board and its scores are copied; the geometry of the board, which     **/
+/**  never changes, is shared.  The clone takes none of g's settings       **/
+/**  (c4_game_poll() and the like), and may be searched at the same time   **/
+/**  as g and any other clone, from other threads.  It must be released    **/
+/**  with c4_game_free().  No move may be in progress on g.  NULL is       **/
+/**  returned if the clone would take the engine over its memory limit     **/
+/**  (see c4_set_memory_limit()).                                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_game *
+c4_game_clone(C4_game *g)
+{
+	C4_game *clone;
+
+	assert(!g->move_in_progress);
+
+	clone = c4_game_new(g->ctx, g->geo->size_x, g->geo->size_y,
+		g->geo->num_to_connect);
+	if (clone != NULL)
+		copy_state(g->geo, clone->current_state, g->current_state);
+	return clone;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function fills in usage with the memory taken up by a game,      **/
+/**  including the geometry of its board, which it shares with the other   **/
+/**  games on a board of the same shape.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_game_memory_usage(C4_game *g, C4_memory *usage)
+{
+	*usage = g->memory;
+	usage->geometry = g->geo->bytes;
+	usage->total += g->geo->bytes;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The following functions are the handle-based equivalents of           **/
+/**  c4_poll(), c4_profile_rules(), c4_log_moves(), c4_make_move(),        **/
+/**  c4_undo(), c4_board(), c4_score_of_player(), c4_is_winner(),          **/
+/**  c4_is_tie() and c4_win_coords().  See those functions for             **/
+/**  documentation.  The tag given to c4_game_log_moves() tells the game's **/
+/**  moves apart from those of other games in the log.  The board of a     **/
+/**  game made by c4_game_clone() counts as set up when it was cloned.     **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_game_poll(C4_game *g, void(*poll_func)(void), clock_t interval)
+{
+	g->poll_function = poll_func;
+	g->poll_interval = interval;
+}
+
+
+void
+c4_game_profile_rules(C4_game *g, C4_rule_stats *stats)
+{
+	g->rule_stats = stats;
+}
+
+
+void
+c4_game_log_moves(C4_game *g, C4_log *log, int tag)
+{
+	g->log = log;
+	g->log_tag = tag;
+}
+
+
+bool
+c4_game_make_move(C4_game *g, int player, int column, int *row)
+{
+	assert(!g->move_in_progress);
+
+	if (column >= g->geo->size_x || column < 0)
+		return false;
+
+	int result = play_move(g, real_player(player), column);
+	if (row != NULL && result >= 0)
+		*row = result;
+	return (result >= 0);
+}
+
+
+bool
+c4_game_undo(C4_game *g, int num)
+{
+	Undo_entry *entry;
+	unsigned char *saved;
+
+	assert(!g->move_in_progress);
+	assert(num >= 0);
+
+	if (num > g->undo_length)
+		return false;
+
+	while (num-- > 0) {
+		entry = &g->undo_log[--g->undo_length];
+		saved = g->undo_counts + 2 * g->geo->max_places * g->undo_length;
+		unmake_move(g, entry->column, entry->row, &entry->undo, saved);
+	}
+
+	/* The rule scores are only kept up to date as pieces are dropped, */
+	/* so they are worked out afresh when they are next needed.        */
+
+	g->current_state->rules_valid[0] = false;
+	g->current_state->rules_valid[1] = false;
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The following functions are the handle-based equivalents of           **/
+/**  c4_load_moves() and c4_load_position().                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_game_load_moves(C4_game *g, const int *columns, int num_moves,
+	int first_player)
+{
+	assert(!g->move_in_progress);
+	assert(num_moves >= 0);
+
+	return load_moves(g, columns, num_moves, first_player,
+		slide_pays(g->geo, num_moves));
+}
+
+
+bool
+c4_game_load_position(C4_game *g, char **board)
+{
+	Geometry *geo = g->geo;
+	char **state_board;
+	bool winners[2] = { false, false };
+	int x, y, pieces = 0;
+
+	assert(!g->move_in_progress);
+
+	clear_state(g);
+	state_board = g->current_state->board;
+
+	for (x = 0; x<geo->size_x; x++) {
+		for (y = 0; y<geo->size_y && (board[x][y] == 0 || board[x][y] == 1);
+			y++)
+			state_board[x][y] = board[x][y];
+		pieces += y;
+		for (; y<geo->size_y; y++)
+			if (board[x][y] != C4_NONE) {
+				clear_state(g);
+				return false;
 			}
+	}
+	g->current_state->num_of_pieces = pieces;
+
+	if (slide_pays(geo, pieces))
+		score_board(g, winners);
+	else
+		for (x = 0; x<geo->size_x; x++)
+			for (y = 0; y<geo->size_y && state_board[x][y] != C4_NONE; y++)
+				if (update_score(g, state_board[x][y], x, y))
+					winners[(int)state_board[x][y]] = true;
+
+	if (winners[0] && winners[1]) {
+		clear_state(g);
+		return false;
+	}
+
+	/* The pieces were not put there in the order they were played, so */
+	/* the win place update_score() noted may not be the one to show.  */
+
+	if (g->current_state->winner != C4_NONE)
+		find_win_place(g);
+	return true;
+}
+
+
+char **
+c4_game_board(C4_game *g)
+{
+	return g->current_state->board;
+}
+
+
+int
+c4_game_score_of_player(C4_game *g, int player)
+{
+	return g->current_state->score[real_player(player)];
+}
+
+
+bool
+c4_game_is_winner(C4_game *g, int player)
+{
+	return (g->current_state->winner == real_player(player));
+}
+
+
+bool
+c4_game_is_tie(C4_game *g)
+{
+	return (g->current_state->num_of_pieces == g->geo->total_size &&
+		g->current_state->winner == C4_NONE);
+}
+
+
+void
+c4_game_win_coords(C4_game *g, int *x1, int *y1, int *x2, int *y2)
+{
+	Game_state *current_state = g->current_state;
+	int size_y = g->geo->size_y;
+	const int *ends;
+
+	assert(current_state->winner != C4_NONE);
+
+	/* The winning connection runs from its lower-left piece to its */
+	/* upper-right one.                                             */
+
+	ends = &g->geo->win_ends[2 * current_state->win_place];
+	*x1 = ends[0] / size_y;
+	*y1 = ends[0] % size_y;
+	*x2 = ends[1] / size_y;
+	*y2 = ends[1] % size_y;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function is the handle-based equivalent of c4_auto_move().  The  **/
+/**  player and search level are taken from params, as is the way the      **/
+/**  positions at the end of the search are scored (see "c4.h").  If       **/
+/**  result is not NULL, the column, row and score of the move and         **/
+/**  statistics about the search are returned through it.                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_game_auto_move(C4_game *g, const C4_move_params *params,
+	C4_move_result *result)
+{
+	C4_move_result local;
+	bool moved;
+
+	assert(!g->move_in_progress);
+	assert(params->level >= 1 && params->level <= C4_MAX_LEVEL);
+	assert(params->eval >= C4_EVAL_HEURISTIC && params->eval <= C4_EVAL_NETWORK);
+	assert(params->eval != C4_EVAL_CUSTOM || params->eval_function != NULL);
+	assert(params->eval != C4_EVAL_NETWORK || (params->network != NULL &&
+		c4_network_fits(params->network, g->geo->size_x, g->geo->size_y)));
+
+	if (result == NULL)
+		result = &local;
+
+	g->move_in_progress = true;
+	c4_atomic_store(&g->stop, 0);
+	moved = auto_move(g, params, result);
+	g->move_in_progress = false;
+
+	return moved;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function asks the worker threads of the game's context to make   **/
+/**  a move, and returns at once with a handle to the pending move.  When  **/
+/**  the move has been made (or cancelled), callback is called from the    **/
+/**  worker thread with the result and user_data; callback may be NULL if  **/
+/**  the caller would rather poll the handle with c4_async_status() and    **/
+/**  c4_async_result().  The handle counts as done only once the callback  **/
+/**  has returned.                                                         **/
+/**                                                                        **/
+/**  The game must have been created in a context, and it must not be      **/
+/**  touched by the caller until the move is done.  Any number of games    **/
+/**  may have moves pending at once; they are run in the order in which    **/
+/**  they were requested, as threads become free.  The handle must be      **/
+/**  released with c4_async_free(), which may be done from the callback.   **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_async *
+c4_auto_move_async(C4_game *g, const C4_move_params *params,
+	C4_move_callback callback, void *user_data)
+{
+	C4_context *ctx = g->ctx;
+	C4_async *handle;
+
+	assert(ctx != NULL);
+	assert(!g->move_in_progress);
+	assert(params->level >= 1 && params->level <= C4_MAX_LEVEL);
+	assert(params->eval >= C4_EVAL_HEURISTIC && params->eval <= C4_EVAL_NETWORK);
+	assert(params->eval != C4_EVAL_CUSTOM || params->eval_function != NULL);
+	assert(params->eval != C4_EVAL_NETWORK || (params->network != NULL &&
+		c4_network_fits(params->network, g->geo->size_x, g->geo->size_y)));
+
+	handle = (C4_async *)emalloc(sizeof(C4_async));
+	handle->ctx = ctx;
+	handle->game = g;
+	handle->params = *params;
+	handle->callback = callback;
+	handle->user_data = user_data;
+	handle->result.moved = false;
+	handle->status = C4_ASYNC_PENDING;
+	handle->cancel_requested = false;
+	handle->references = 2;     /* One for the caller, one for the worker. */
+	handle->next = NULL;
+
+	g->move_in_progress = true;
+	c4_atomic_store(&g->stop, 0);
+
+	c4_mutex_lock(&ctx->lock);
+	if (ctx->queue_tail != NULL)
+		ctx->queue_tail->next = handle;
+	else
+		ctx->queue_head = handle;
+	ctx->queue_tail = handle;
+	c4_cond_signal(&ctx->work_ready);
+	c4_mutex_unlock(&ctx->lock);
+
+	return handle;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the status of an asynchronous move: one of      **/
+/**  C4_ASYNC_PENDING, C4_ASYNC_DONE or C4_ASYNC_CANCELLED.  It never      **/
+/**  blocks, so it is suitable for polling from an event loop.             **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_async_status(C4_async *handle)
+{
+	int status;
+
+	c4_mutex_lock(&handle->ctx->lock);
+	status = handle->status;
+	c4_mutex_unlock(&handle->ctx->lock);
+
+	return status;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function copies the result of a finished asynchronous move into  **/
+/**  result and returns true, or returns false if the move is still        **/
+/**  pending.  The result of a cancelled move has moved set to false.      **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_async_result(C4_async *handle, C4_move_result *result)
+{
+	bool finished;
+
+	c4_mutex_lock(&handle->ctx->lock);
+	finished = (handle->status != C4_ASYNC_PENDING);
+	if (finished)
+		*result = handle->result;
+	c4_mutex_unlock(&handle->ctx->lock);
+
+	return finished;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function blocks until an asynchronous move is done or            **/
+/**  cancelled.                                                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_async_wait(C4_async *handle)
+{
+	C4_context *ctx = handle->ctx;
+
+	c4_mutex_lock(&ctx->lock);
+	while (handle->status == C4_ASYNC_PENDING)
+		c4_cond_wait(&ctx->work_done, &ctx->lock);
+	c4_mutex_unlock(&ctx->lock);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function cancels an asynchronous move.  If the search has not    **/
+/**  started it never will; if it is running it is abandoned at the next   **/
+/**  position it evaluates.  Either way no piece is dropped, and the move  **/
+/**  completes (calling the callback, if any) with a status of             **/
+/**  C4_ASYNC_CANCELLED.  Cancelling a move that is already done has no    **/
+/**  effect.  The function does not wait; use c4_async_wait() for that.    **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_async_cancel(C4_async *handle)
+{
+	c4_mutex_lock(&handle->ctx->lock);
+	if (handle->status == C4_ASYNC_PENDING) {
+		handle->cancel_requested = true;
+		c4_atomic_store(&handle->game->stop, 1);
+	}
+	c4_mutex_unlock(&handle->ctx->lock);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function releases the caller's reference to an asynchronous      **/
+/**  move.  A move that is still pending is not cancelled by this; it      **/
+/**  runs to completion and its callback is still called.                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_async_free(C4_async *handle)
+{
+	if (handle != NULL)
+		release_async(handle);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes a transposition table of at most bytes bytes, for **/
+/**  searches to keep what they find out about positions in, so that a     **/
+/**  search coming to one again, by another order of moves or on a later   **/
+/**  turn, need not search it afresh (see C4_move_params and "c4tt.c").    **/
+/**  A table holds 8 positions to each 64 bytes, in a number of buckets    **/
+/**  that is a power of 2, and is made as large as that allows.  If that   **/
+/**  would take the engine over its memory limit, the table is made        **/
+/**  smaller until it fits, the unused geometries in the cache being freed **/
+/**  first (see c4_set_memory_limit()).  flags may hold                    **/
+/**  C4_TABLE_HUGE_PAGES.  NULL is returned if not even a table of one     **/
+/**  bucket fits, or the system will not give the memory.                  **/
+/**                                                                        **/
+/**  A table may be used by any number of searches at once, on any thread, **/
+/**  but only by searches which score the positions at their horizon in    **/
+/**  the same way, since the scores in it are theirs.  It must be freed    **/
+/**  with c4_table_free() once no search is using it.                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_table *
+c4_table_new(size_t bytes, int flags)
+{
+	C4_table *table;
+	C4_memory memory;
+	size_t num_buckets = table_buckets(bytes);
+
+	memset(&memory, 0, sizeof(C4_memory));
+	for (;;) {
+		memory.tables = memory.total = c4_tt_size(num_buckets);
+		if (reserve_memory(NULL, &memory))
+			break;
+		if (num_buckets == 1)
+			return NULL;
+		num_buckets /= 2;
+	}
+
+	table = c4_tt_new(num_buckets, (flags & C4_TABLE_HUGE_PAGES) != 0);
+	if (table == NULL)
+		release_memory(NULL, &memory);
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens a transposition table in the shared memory        **/
+/**  called name, so that the searches of every process on the host which  **/
+/**  opens it share what they find out.  On POSIX systems the name is that **/
+/**  of a shared memory object, "/name".  If there is no table of that     **/
+/**  name, one is made of at most bytes bytes, as c4_table_new() would     **/
+/**  make it; otherwise the one there is opened, at the size it was made.  **/
+/**  NULL is returned if the table would take the engine over its memory   **/
+/**  limit, or cannot be opened.                                           **/
+/**                                                                        **/
+/**  A shared table is used and freed as any other (see c4_table_new()),   **/
+/**  and the searches of every process using it must score positions in    **/
+/**  the same way.  The entries are single words, written whole, so a      **/
+/**  process which dies mid-search leaves nothing torn behind.  The table  **/
+/**  outlasts the processes, until c4_table_remove_shared() is called.     **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_table *
+c4_table_open_shared(const char *name, size_t bytes)
+{
+	C4_table *table;
+	C4_memory memory;
+	size_t num_buckets = table_buckets(bytes);
+
+	memset(&memory, 0, sizeof(C4_memory));
+	memory.tables = memory.total = c4_tt_size(num_buckets);
+	if (!reserve_memory(NULL, &memory))
+		return NULL;
+
+	table = c4_tt_open_shared(name, num_buckets);
+	if (table == NULL || table->num_buckets == num_buckets) {
+		if (table == NULL)
+			release_memory(NULL, &memory);
+		return table;
+	}
+
+	/* Another process made the table, at a size of its own. */
+
+	release_memory(NULL, &memory);
+	memory.tables = memory.total = c4_tt_size(table->num_buckets);
+	if (!reserve_memory(NULL, &memory)) {
+		c4_tt_free(table);
+		return NULL;
+	}
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function removes the table in the shared memory called name, so  **/
+/**  that the next c4_table_open_shared() of it makes a new one.  The      **/
+/**  processes which have the old one open go on using it until they free  **/
+/**  it, when its memory is given back.                                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_table_remove_shared(const char *name)
+{
+	c4_tt_remove_shared(name);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees a table made by c4_table_new() or opened by       **/
+/**  c4_table_open_shared().                                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_table_free(C4_table *table)
+{
+	C4_memory memory;
+
+	if (table == NULL)
+		return;
+
+	memset(&memory, 0, sizeof(C4_memory));
+	memory.tables = memory.total = c4_tt_size(table->num_buckets);
+	c4_tt_free(table);
+	release_memory(NULL, &memory);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function empties a table, as when it was made.  No search may be **/
+/**  using it, in this process or (for a shared table) any other.          **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_table_clear(C4_table *table)
+{
+	c4_tt_clear(table);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function fills in stats about a table.  The entries in use are   **/
+/**  counted by looking at every one, which takes a while on a large       **/
+/**  table.                                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_table_stats(C4_table *table, C4_table_stats *stats)
+{
+	stats->bytes = table->bytes;
+	stats->entries = table->num_buckets * C4_TT_BUCKET;
+	stats->used = c4_tt_used(table);
+	stats->huge_pages = table->huge_pages;
+	stats->shared = table->shared;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of buckets of a table of at most     **/
+/**  bytes bytes: the largest power of 2 that fits.                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+static size_t
+table_buckets(size_t bytes)
+{
+	size_t num_buckets = 1;
+
+	assert(bytes >= C4_TT_BUCKET * sizeof(uint64_t));
+
+	while (num_buckets <= bytes / (2 * C4_TT_BUCKET * sizeof(uint64_t)))
+		num_buckets *= 2;
+	return num_buckets;
+}
+
+
+/****************************************************************************/
+/****************************************************************************/
+/**                                                                        **/
+/**  The following functions are local to this file and should not be      **/
+/**  called externally.                                                    **/
+/**                                                                        **/
+/****************************************************************************/
+/****************************************************************************/
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function builds the geometry of a width by height board, where   **/
+/**  num pieces are required in a row in order to win.                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+static Geometry *
+new_geometry(int width, int height, int num)
+{
+	register int i, j, k;
+	int win_index, column, cell;
+	int *map, *next, *ends;
+	uint64_t seed, key;
+	Geometry *geo;
+
+	geo = (Geometry *)emalloc(sizeof(Geometry));
+	geo->size_x = width;
+	geo->size_y = height;
+	geo->total_size = width * height;
+	geo->num_to_connect = num;
+	geo->magic_win_number = num + 1;
+	geo->win_places = num_of_win_places(width, height, num);
+
+	/* Set up the map.  The number of win places through each cell is */
+	/* known in advance, so the whole map can be laid out as a single */
+	/* table and then filled in with one pass over the win places.    */
+	/* next[c] is where the next win place through cell c goes.       */
+
+	geo->map_start = (int *)emalloc((geo->total_size + 1) * sizeof(int));
+	geo->map_start[0] = 0;
+	geo->max_places = 0;
+	for (i = 0; i<width; i++)
+		for (j = 0; j<height; j++) {
+			cell = i * height + j;
+			k = num_of_win_places_at(width, height, num, i, j);
+			geo->map_start[cell + 1] = geo->map_start[cell] + k;
+			if (k > geo->max_places)
+				geo->max_places = k;
+		}
+
+	map = (int *)emalloc_aligned(
+		geo->map_start[geo->total_size] * sizeof(int));
+	next = (int *)emalloc(geo->total_size * sizeof(int));
+	memcpy(next, geo->map_start, geo->total_size * sizeof(int));
+
+	/* The ends of each win place are noted as it is filled in.  (The */
+	/* table gets one spare entry, so that it is never empty.)        */
+
+	geo->win_ends = (int *)emalloc((2 * geo->win_places + 1) * sizeof(int));
+	ends = geo->win_ends;
+
+	win_index = 0;
+
+	/* Fill in the horizontal win positions */
+	for (i = 0; i<height; i++)
+		for (j = 0; j<width - num + 1; j++) {
+			for (k = 0; k<num; k++)
+				map[next[(j + k) * height + i]++] = win_index;
+			*ends++ = j * height + i;
+			*ends++ = (j + num - 1) * height + i;
+			win_index++;
+		}
+
+	/* Fill in the vertical win positions */
+	for (i = 0; i<width; i++)
+		for (j = 0; j<height - num + 1; j++) {
+			for (k = 0; k<num; k++)
+				map[next[i * height + j + k]++] = win_index;
+			*ends++ = i * height + j;
+			*ends++ = i * height + j + num - 1;
+			win_index++;
+		}
+
+	/* Fill in the forward diagonal win positions */
+	for (i = 0; i<height - num + 1; i++)
+		for (j = 0; j<width - num + 1; j++) {
+			for (k = 0; k<num; k++)
+				map[next[(j + k) * height + i + k]++] = win_index;
+			*ends++ = j * height + i;
+			*ends++ = (j + num - 1) * height + i + num - 1;
+			win_index++;
+		}
+
+	/* Fill in the backward diagonal win positions */
+	for (i = 0; i<height - num + 1; i++)
+		for (j = width - 1; j >= num - 1; j--) {
+			for (k = 0; k<num; k++)
+				map[next[(j - k) * height + i + k]++] = win_index;
+			*ends++ = j * height + i;
+			*ends++ = (j - num + 1) * height + i + num - 1;
+			win_index++;
+		}
+
+	free(next);
+	geo->map = map;
+
+	/* Set up the order in which automatic moves should be tried. */
+	/* The columns nearer to the center of the board are usually  */
+	/* better tactically and are more likely to lead to a win.    */
+	/* By ordering the search such that the central columns are   */
+	/* tried first, alpha-beta cutoff is much more effective.     */
+
+	geo->drop_order = (int *)emalloc(width * sizeof(int));
+	column = (width - 1) / 2;
+	for (i = 1; i <= width; i++) {
+		geo->drop_order[i - 1] = column;
+		column += ((i % 2) ? i : -i);
+	}
+
+	geo->update_counts = c4_best_count_kernel();
+	geo->rules = c4_rule_table_new(width, height);
+	geo->bits = c4_bits_table_new(width, height, num);
+
+	/* Make up the keys of the pieces (with SplitMix64).  They depend on */
+	/* nothing but the shape of the board, so that every process using  */
+	/* a table agrees on them.                                          */
+
+	geo->keys = (uint64_t *)emalloc((2 * geo->total_size + 2) *
+		sizeof(uint64_t));
+	seed = ((uint64_t)width << 42) ^ ((uint64_t)height << 21) ^ num;
+	for (i = 0; i<2 * geo->total_size + 2; i++) {
+		key = (seed += 0x9e3779b97f4a7c15ULL);
+		key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+		geo->keys[i] = key ^ (key >> 31);
+	}
+
+	geo->bytes = geometry_size(width, height, num);
 
-			//XOOO_ horizontal
-			if (i < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 4][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i + 4][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//         printf("3-7\n");
-				}
-				else if (j > 0 && current_state->board[i + 4][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-				}
-				else if (j == 0) { // firstline
-					score = 300;
-					rule[2] += score;
-				}
-			}
+	assert(width != STD_X || height != STD_Y || num != STD_N ||
+		std_geometry_matches(geo));
 
-			//wallOOO_ horizontal
-			if (i == 0 && i < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i + 3][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//         printf("3-8\n");
-				}
-				else if (j > 0 && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-				}
-				else if (j == 0) { // firstline
-					score = 300;
-					rule[2] += score;
-				}
-			}
-			/*
-			//_OOOX (_below full) horizontal
-			if (i < 3 && j > 0 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1 && current_state->board[i+4][j] == 0) {
-			if (current_state->board[i][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//       printf("3-9\n");
-			}
-			}
+	return geo;
+}
 
-			//_OOOX (_below full)  horizontal // first line
-			if (i < 3 && j == 0 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1 && current_state->board[i+4][j] == 0) {
-			score = 300;
-			rule[2] += score;
-			//    printf("3-10\n");
-			}
 
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the memory new_geometry() will take up for a    **/
+/**  width by height board, where num pieces are required in a row in      **/
+/**  order to win, without building it.                                    **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//_OOOwall (_below full) horizontal
-			if (i == 3 && j > 0 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1) {
-			if (current_state->board[i][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//         printf("3-11\n");
-			}
-			}
+static size_t
+geometry_size(int width, int height, int num)
+{
+	size_t total_size = (size_t)width * height;
+	size_t win_places = num_of_win_places(width, height, num);
+
+	/* Each win place runs through num cells, so the map holds num  */
+	/* entries for each.                                            */
+
+	return sizeof(Geometry) + (total_size + 1) * sizeof(int) +
+		aligned_size(num * win_places * sizeof(int)) +
+		(width + 2 * win_places + 1) * sizeof(int) +
+		(2 * total_size + 2) * sizeof(uint64_t) +
+		c4_bits_table_size(width, height) +
+		c4_rule_table_size(width, height);
+}
 
-			//_OOOwall (_below full) horizontal //first line
-			if (i == 3 && j == 0 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1) {
-			score = 300;
-			rule[2] += score;
-			//      printf("3-12\n");
-			}
 
-			//XOOO_ (_below full) horizontal
-			if (i < 3 && j > 0 && current_state->board[i][j] == 0 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1 && current_state->board[i+4][j] == C4_NONE) {
-			if (current_state->board[i+4][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//     printf("3-13\n");
-			}
-			}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees a geometry built by new_geometry().               **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//XOOO_ (_below full) horizontal //first line
-			if (i < 3 && j == 0 && current_state->board[i][j] == 0 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == 1 && current_state->board[i+4][j] == C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//      printf("3-14\n");
-			}
+static void
+free_geometry(Geometry *geo)
+{
+	/* Free up the memory used by the map. */
 
+	free(geo->map_start);
+	free_aligned(geo->map);
 
-			//wallOOO_ (_below full) horizontal
-			if (i == 0 && j > 0 && current_state->board[i][j] == 1 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == C4_NONE) {
-			if (current_state->board[i+4][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//       printf("3-15\n");
-			}
-			}
+	/* Free up the memory used by the drop_order array. */
 
-			//wallOOO_ (_below full)  horizontal //first line
-			if (i == 0 && j == 0 && current_state->board[i][j] == 1 && current_state->board[i+1][j] == 1 && current_state->board[i+2][j] == 1 && current_state->board[i+3][j] == C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//     printf("3-16\n");
-			}
-			*/
-			// _OOO_ (both full) diagonal ascending
-			if (i > 1 && i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i - 1][j - 1] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-				if (j > 2 && current_state->board[i - 2][j - 3] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 10000;
-					rule[2] += score;
-				}
-				if (j == 2 && current_state->board[i + 2][j + 1] != C4_NONE) { //first line
-					score = 10000;
-					rule[2] += score;
-				}
-				//        printf("3-17\n");
-			}
-			/*
-			// _OOO_ (both full) diagonal ascending //first line
-			if (i > 1 && i<5 && j == 2 && j<4 && current_state->board[i][j] == 1 && current_state->board[i - 1][j - 1] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-			if (current_state->board[i + 2][j + 1] != C4_NONE){
-			score = 10000;
-			rule[2] += score;
-			}
-			//       printf("3-18\n");
-			}*/
-
-
-			//_OOO_ (XOR full) diagonal ascending
-			if (i < 3 && j < 2 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 4][j + 4] == C4_NONE) {
-				if (j > 0 && current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j + 3] != C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//      printf("3-19\n");
-				}
-				else if (j > 0 && current_state->board[i][j - 1] != C4_NONE && current_state->board[i + 4][j + 3] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//        printf("3-19\n");
-				}
-				else if (j == 0 && current_state->board[i + 4][j + 3] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-				}
-			}
+	free(geo->drop_order);
+	free(geo->win_ends);
+	free(geo->keys);
 
-			//_OOO_ (both empty) diagonal ascending
-			if (j > 0 && i < 3 && j < 2 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 4][j + 4] == C4_NONE) {
-				if (current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j + 3] == C4_NONE) {
-					score = 2000;
-					rule[2] += score;
-					//      printf("3-20\n");
-				}
-			}
+	c4_rule_table_free(geo->rules);
+	c4_bits_table_free(geo->bits);
+	free(geo);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the geometry of a width by height board, where  **/
+/**  num pieces are required in a row in order to win, from the cache if   **/
+/**  it is there and built by new_geometry() otherwise.  The geometry must **/
+/**  be let go of with release_geometry().  The memory of a geometry is    **/
+/**  counted from before it is built until it is freed from the cache, and **/
+/**  NULL is returned, with nothing built, if it would take the engine     **/
+/**  over its memory limit (see reserve_memory()).                         **/
+/**                                                                        **/
+/**  The cache is only locked while it is searched and changed.  A         **/
+/**  geometry is built without the lock, so that a large one does not hold **/
+/**  up games on other boards; if another thread has added the same shape  **/
+/**  in the meantime, the new one is thrown away.                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+static Geometry *
+get_geometry(int width, int height, int num)
+{
+	Geometry *geo, *built;
+	C4_memory memory;
+
+	lock_geometries();
+	geo = find_geometry(width, height, num);
+	if (geo != NULL)
+		geo->references++;
+	unlock_geometries();
+	if (geo != NULL)
+		return geo;
+
+	memset(&memory, 0, sizeof(C4_memory));
+	memory.geometry = memory.total = geometry_size(width, height, num);
+	if (!reserve_memory(NULL, &memory))
+		return NULL;
+
+	built = new_geometry(width, height, num);
+
+	lock_geometries();
+	geo = find_geometry(width, height, num);
+	if (geo != NULL)
+		geo->references++;
+	else {
+		geo = built;
+		geo->references = 1;
+		geo->next = geometries;
+		geometries = geo;
+	}
+	unlock_geometries();
+
+	if (geo != built) {
+		free_geometry(built);
+		release_memory(NULL, &memory);
+	}
+	return geo;
+}
 
-			//_OOOXdiagonal ascending
-			if (j > 0 && i < 3 && j < 2 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 4][j + 4] == 0) {
-				if (current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//       printf("3-21\n");
-				}
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//      printf("3-25\n");
-				}
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function lets go of a geometry returned by get_geometry().  When **/
+/**  no game is using it any more, it moves to the front of the cache, and **/
+/**  the least recently used of the geometries no game is using is freed   **/
+/**  if there are more than GEOMETRY_CACHE of them.                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+release_geometry(Geometry *geo)
+{
+	Geometry **link, *unused = NULL;
+	int num_unused = 0;
+
+	lock_geometries();
+	assert(geo->references > 0);
+	if (--geo->references == 0) {
+		for (link = &geometries; *link != geo; link = &(*link)->next)
+			;
+		*link = geo->next;
+		geo->next = geometries;
+		geometries = geo;
+
+		for (link = &geometries; *link != NULL; link = &(*link)->next)
+			if ((*link)->references == 0 && ++num_unused > GEOMETRY_CACHE) {
+				unused = *link;
+				*link = unused->next;
+				memory_used.geometry -= unused->bytes;
+				memory_used.total -= unused->bytes;
+				break;
 			}
+	}
+	unlock_geometries();
+
+	if (unused != NULL)
+		free_geometry(unused);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees the geometries in the cache that no game is       **/
+/**  using.                                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+free_unused_geometries(void)
+{
+	Geometry **link, *unused = NULL, *geo;
+
+	lock_geometries();
+	for (link = &geometries; *link != NULL; )
+		if ((*link)->references == 0) {
+			geo = *link;
+			*link = geo->next;
+			geo->next = unused;
+			unused = geo;
+			memory_used.geometry -= geo->bytes;
+			memory_used.total -= geo->bytes;
+		}
+		else
+			link = &(*link)->next;
+	unlock_geometries();
+
+	while (unused != NULL) {
+		geo = unused;
+		unused = geo->next;
+		free_geometry(geo);
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the geometry of the shape given from the cache, **/
+/**  or NULL if it is not there.  The cache must be locked.                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static Geometry *
+find_geometry(int width, int height, int num)
+{
+	Geometry *geo;
+
+	for (geo = geometries; geo != NULL; geo = geo->next)
+		if (geo->size_x == width && geo->size_y == height &&
+			geo->num_to_connect == num)
+			return geo;
+	return NULL;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions lock and unlock the cache of geometries, and with it  **/
+/**  the accounts of memory.  It is only ever held for a walk along the    **/
+/**  cache or a few sums, so a spin lock serves, and it needs no setting   **/
+/**  up.                                                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+lock_geometries(void)
+{
+	while (!c4_atomic_cas(&geometry_lock, 0, 1))
+		c4_sleep_ms(0);
+}
+
+static void
+unlock_geometries(void)
+{
+	c4_atomic_store(&geometry_lock, 0);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function counts the memory of a new game, geometry or table,     **/
+/**  bytes, against the engine and ctx (if it is not NULL), and returns    **/
+/**  true, if that keeps the engine within its limit.  If it does not, the **/
+/**  unused geometries in the cache are freed to make room, and false is   **/
+/**  returned if there is still not enough.                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+reserve_memory(C4_context *ctx, const C4_memory *bytes)
+{
+	bool fits, freed = false;
+
+	for (;;) {
+		lock_geometries();
+		fits = (memory_limit == 0 ||
+			memory_used.total + bytes->total <= memory_limit);
+		if (fits) {
+			count_memory(&memory_used, bytes, true);
+			if (ctx != NULL)
+				count_memory(&ctx->memory, bytes, true);
+		}
+		unlock_geometries();
+
+		if (fits || freed)
+			return fits;
+		free_unused_geometries();
+		freed = true;
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function gives back memory counted by reserve_memory().          **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+release_memory(C4_context *ctx, const C4_memory *bytes)
+{
+	lock_geometries();
+	count_memory(&memory_used, bytes, false);
+	if (ctx != NULL)
+		count_memory(&ctx->memory, bytes, false);
+	unlock_geometries();
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds bytes to usage, or takes them away from it if add  **/
+/**  is false.  The accounts must be locked.                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+count_memory(C4_memory *usage, const C4_memory *bytes, bool add)
+{
+	if (add) {
+		usage->states += bytes->states;
+		usage->bitboards += bytes->bitboards;
+		usage->geometry += bytes->geometry;
+		usage->tables += bytes->tables;
+		usage->other += bytes->other;
+		usage->total += bytes->total;
+	}
+	else {
+		usage->states -= bytes->states;
+		usage->bitboards -= bytes->bitboards;
+		usage->geometry -= bytes->geometry;
+		usage->tables -= bytes->tables;
+		usage->other -= bytes->other;
+		usage->total -= bytes->total;
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of possible win positions on a board **/
+/**  of dimensions x by y with n being the number of pieces required in a  **/
+/**  row in order to win.                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+num_of_win_places(int x, int y, int n)
+{
+	if (x < n && y < n)
+		return 0;
+	else if (x < n)
+		return x * ((y - n) + 1);
+	else if (y < n)
+		return y * ((x - n) + 1);
+	else
+		return 4 * x*y - 3 * x*n - 3 * y*n + 3 * x + 3 * y - 4 * n + 2 * n*n + 2;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of possible win positions that pass  **/
+/**  through column i, row j of a board of dimensions x by y, with n being **/
+/**  the number of pieces required in a row in order to win.  Each of the  **/
+/**  four directions is counted separately, as the number of places a      **/
+/**  line of n can start so that it both covers (i, j) and fits on the     **/
+/**  board.                                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+#define MAX2(a, b)     ((a) > (b) ? (a) : (b))
+#define MIN2(a, b)     ((a) < (b) ? (a) : (b))
+#define RANGE(lo, hi)  ((hi) >= (lo) ? (hi) - (lo) + 1 : 0)
+
+static int
+num_of_win_places_at(int x, int y, int n, int i, int j)
+{
+	int count = 0;
+
+	/* Horizontal and vertical. */
+	count += RANGE(MAX2(0, i - n + 1), MIN2(i, x - n));
+	count += RANGE(MAX2(0, j - n + 1), MIN2(j, y - n));
+
+	/* Forward diagonal, starting k cells down and to the left. */
+	count += RANGE(MAX2(MAX2(0, i - (x - n)), j - (y - n)),
+		MIN2(MIN2(n - 1, i), j));
+
+	/* Backward diagonal, starting k cells down and to the right. */
+	count += RANGE(MAX2(MAX2(0, n - 1 - i), j - (y - n)),
+		MIN2(MIN2(n - 1, x - 1 - i), j));
+
+	return count;
+}
+
+#undef MAX2
+#undef MIN2
+#undef RANGE
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function updates the score of the specified player in the        **/
+/**  context of the current state,  given that the player has just placed  **/
+/**  a game piece in column x, row y.  The work on the win places through  **/
+/**  the cell is done by the kernel chosen for the geometry; see           **/
+/**  "c4simd.c".  Whether the piece connected num_to_connect pieces of     **/
+/**  the player is returned.  If it won the game, the win place it         **/
+/**  connected is noted for c4_game_win_coords().                          **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+update_score(C4_game *g, int player, int x, int y)
+{
+	Geometry *geo = g->geo;
+	Game_state *current_state = g->current_state;
+	int cell = x * geo->size_y + y;
+	int start = geo->map_start[cell];
+	int differences[2];
+	bool won;
+
+	won = (*geo->update_counts)(current_state->score_array, &geo->map[start],
+		geo->map_start[cell + 1] - start, player, geo->magic_win_number,
+		differences);
+	if (won && current_state->winner == C4_NONE) {
+		current_state->winner = player;
+
+		/* The win places through a cell are listed in order, so the */
+		/* first one connected is the lowest numbered.               */
+
+		while (current_state->score_array[2 * geo->map[start] + player] !=
+			geo->magic_win_number)
+			start++;
+		current_state->win_place = geo->map[start];
+	}
+
+	current_state->score[player] += differences[0];
+	current_state->score[other(player)] -= differences[1];
+	return won;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets a game back to the empty board, at the bottom of   **/
+/**  its stack of states.                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+clear_state(C4_game *g)
+{
+	Geometry *geo = g->geo;
+	Game_state *state = &g->state_stack[0];
+
+	g->depth = 0;
+	g->current_state = state;
+	g->undo_length = 0;
+
+	memset(state->board[0], C4_NONE, geo->total_size);
+	memset(state->score_array, 1, 2 * geo->win_places);
+	state->score[0] = state->score[1] = geo->win_places;
+	state->winner = C4_NONE;
+	state->num_of_pieces = 0;
+	state->rules_valid[0] = state->rules_valid[1] = false;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function is the body of c4_game_load_moves().  The moves are     **/
+/**  put on the board, and then scored by score_board() if sliding is      **/
+/**  true, or each by update_score() as it is put there otherwise.  The    **/
+/**  latter gives the winner just as replaying the moves would; so if      **/
+/**  score_board() finds that both players have connected, the moves are   **/
+/**  loaded again that way.                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+load_moves(C4_game *g, const int *columns, int num_moves, int first_player,
+	bool sliding)
+{
+	Geometry *geo = g->geo;
+	char **board;
+	bool winners[2];
+	int i, y, column, player = real_player(first_player);
+
+	clear_state(g);
+	board = g->current_state->board;
+
+	for (i = 0; i<num_moves; i++, player = other(player)) {
+		column = columns[i];
+		if (column < 0 || column >= geo->size_x ||
+			board[column][geo->size_y - 1] != C4_NONE) {
+			clear_state(g);
+			return false;
+		}
+		for (y = 0; board[column][y] != C4_NONE; y++)
+			;
+		board[column][y] = player;
+		if (!sliding)
+			update_score(g, player, column, y);
+	}
+	g->current_state->num_of_pieces = num_moves;
+
+	if (sliding && !score_board(g, winners))
+		return load_moves(g, columns, num_moves, first_player, false);
+
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns whether score_board() is the cheaper way to     **/
+/**  score a board with the given number of pieces on it.  update_score()  **/
+/**  costs about 2ns for each win place through each piece, against about  **/
+/**  14ns a cell for score_board(), so the sliding only pays on large,     **/
+/**  crowded boards; never on a 7x6 one.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+slide_pays(const Geometry *geo, int pieces)
+{
+	long long places = (long long)pieces * geo->map_start[geo->total_size];
+
+	return places > 8LL * geo->total_size * geo->total_size;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function works out the score array, the scores and the winner    **/
+/**  of the current state afresh from its board, which is all it looks at. **/
+/**  Rather than following each piece to the win places through it, as     **/
+/**  update_score() does, it slides a window of num_to_connect cells along **/
+/**  each row, column and diagonal of the board, so the cost is that of    **/
+/**  looking at each cell four times, however many pieces there are.       **/
+/**                                                                        **/
+/**  winners[x] is set to whether player x has connected.  If both have,   **/
+/**  which cannot happen in a game that stops when it is won, the state    **/
+/**  gets no winner and false is returned; otherwise true is.              **/
+/**                                                                        **/
+/****************************************************************************/
+
+#define MIN2(a, b)     ((a) < (b) ? (a) : (b))
+
+static bool
+score_board(C4_game *g, bool winners[2])
+{
+	Geometry *geo = g->geo;
+	Game_state *state = g->current_state;
+	int width = geo->size_x, height = geo->size_y, num = geo->num_to_connect;
+	int across = width - num + 1, up = height - num + 1;
+	int vertical, forward, backward, i;
+
+	/* The win places are numbered as in new_geometry(): the rows, then */
+	/* the columns, then each way of diagonal, by where they start.     */
+
+	vertical = (across > 0) ? height * across : 0;
+	forward = vertical + ((up > 0) ? width * up : 0);
+	backward = forward + ((across > 0 && up > 0) ? up * across : 0);
+
+	state->score[0] = state->score[1] = 0;
+	winners[0] = winners[1] = false;
+
+	for (i = 0; i<height; i++)
+		score_line(g, 0, i, 1, 0, width, i * across, 1, winners);
+	for (i = 0; i<width; i++)
+		score_line(g, i, 0, 0, 1, height, vertical + i * up, 1, winners);
+
+	if (across > 0 && up > 0) {
+		/* Diagonals start along the bottom row, and up the left-hand   */
+		/* (forward) or right-hand (backward) side.  The window at       */
+		/* (x, y) is numbered y * across + x among the forward ones, and */
+		/* y * across + (width - 1 - x) among the backward ones.         */
+
+		for (i = 0; i<width; i++) {
+			score_line(g, i, 0, 1, 1, MIN2(width - i, height),
+				forward + i, across + 1, winners);
+			score_line(g, i, 0, -1, 1, MIN2(i + 1, height),
+				backward + width - 1 - i, across + 1, winners);
+		}
+		for (i = 1; i<height; i++) {
+			score_line(g, 0, i, 1, 1, MIN2(width, height - i),
+				forward + i * across, across + 1, winners);
+			score_line(g, width - 1, i, -1, 1, MIN2(width, height - i),
+				backward + i * across, across + 1, winners);
+		}
+	}
+
+	if (winners[0] && winners[1]) {
+		state->winner = C4_NONE;
+		return false;
+	}
+	state->winner = winners[0] ? 0 : winners[1] ? 1 : C4_NONE;
+	if (state->winner != C4_NONE)
+		find_win_place(g);
+	return true;
+}
+
+#undef MIN2
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function scores the win places along one line of the board for   **/
+/**  score_board().  The line starts at column x, row y and runs length    **/
+/**  cells in the direction (dx, dy); the win place starting at its tth    **/
+/**  cell is numbered index + t * step.                                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+score_line(C4_game *g, int x, int y, int dx, int dy, int length, int index,
+	int step, bool winners[2])
+{
+	Geometry *geo = g->geo;
+	Game_state *state = g->current_state;
+	char **board = state->board;
+	unsigned char *counts;
+	int num = geo->num_to_connect, pieces[3] = { 0, 0, 0 };
+	int t, p, count;
+
+	for (t = 0; t<length; t++) {
+		pieces[(int)board[x + t * dx][y + t * dy]]++;
+		if (t >= num)
+			pieces[(int)board[x + (t - num) * dx][y + (t - num) * dy]]--;
+		if (t < num - 1)
+			continue;
+
+		counts = &state->score_array[2 * (index + (t - num + 1) * step)];
+		for (p = 0; p<2; p++) {
+			count = (pieces[other(p)] > 0) ? 0 : pieces[p] + 1;
+			counts[p] = (unsigned char)count;
+			state->score[p] += window_value(count);
+			if (count == geo->magic_win_number)
+				winners[p] = true;
+		}
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets the win place of the current state to the lowest   **/
+/**  numbered one its winner has connected, for a board scored as a whole  **/
+/**  rather than move by move.                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+find_win_place(C4_game *g)
+{
+	Game_state *state = g->current_state;
 
-			//_OOOwall diagonal ascending
-			if (j > 0 && i == 3 && j < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1) {
-				if (current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//          printf("3-22\n");
-				}
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//      printf("3-25\n");
-				}
-			}
+	assert(state->winner != C4_NONE);
 
-			//XOOO_  diagonal ascending
-			if (i < 3 && j < 2 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 4][j + 4] == C4_NONE) {
-				if (current_state->board[i + 4][j + 3] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//    printf("3-23\n");
-				}
-				if (current_state->board[i + 4][j + 3] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//      printf("3-25\n");
-				}
-			}
+	state->win_place = 0;
+	while (state->score_array[2 * state->win_place + state->winner] !=
+		g->geo->magic_win_number)
+		state->win_place++;
+}
 
-			//wallOOO_ diagonal ascending
-			if (i == 0 && j < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == C4_NONE) {
-				if (current_state->board[i + 3][j + 2] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//    printf("3-24\n");
-				}
-				if (current_state->board[i + 3][j + 2] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//      printf("3-25\n");
-				}
-			}
-			/*
-			//_OOOX (_below full) diagonal ascending
-			if (j > 0 && i < 3 && j < 2 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j+1] == 1 && current_state->board[i+2][j+2] == 1 && current_state->board[i+3][j+3] == 1 && current_state->board[i+4][j+4] == 0) {
-			if (current_state->board[i][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//      printf("3-25\n");
-			}
-			}
 
-			//_OOOwall (_below full) diagonal ascending
-			if (j > 0 && i == 3 && j < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i+1][j+1] == 1 && current_state->board[i+2][j+2] == 1 && current_state->board[i+3][j+3] == 1) {
-			if (current_state->board[i][j-1] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//          printf("3-26\n");
-			}
-			}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function drops a piece of the specified player into the          **/
+/**  specified column.  The row where the piece ended up is returned, or   **/
+/**  -1 if the drop was unsuccessful (i.e., the specified column is full). **/
+/**  The scores of the rules are brought up to date, if they are being     **/
+/**  kept for the state.                                                   **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//XOOO_ (_below full) diagonal ascending
-			if (i < 3 && j < 2 && current_state->board[i][j] == 0 && current_state->board[i+1][j+1] == 1 && current_state->board[i+2][j+2] == 1 && current_state->board[i+3][j+3] == 1 && current_state->board[i+4][j+4] == C4_NONE) {
-			if (current_state->board[i+4][j+3] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//           printf("3-27\n");
-			}
-			}
+static int
+drop_piece(C4_game *g, int player, int column)
+{
+	int y = 0, own;
+	int size_y = g->geo->size_y;
+	char *cells = g->current_state->board[column];
 
-			//wallOOO_ (_below full) diagonal ascending
-			if (i == 0 && j < 4 && current_state->board[i][j] == 1 && current_state->board[i+1][j+1] == 1 && current_state->board[i+2][j+2] == 1 && current_state->board[i+3][j+3] == C4_NONE) {
-			if (current_state->board[i+3][j+2] != C4_NONE) {
-			score = 300;
-			rule[2] += score;
-			//          printf("3-28\n");
-			}
-			}
-			*/
-			// _OOO_ (both full) diagonal descending
-			if (i>1 && i<5 && j<4 && current_state->board[i - 1][j + 1] == 1 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE) {
-				if (j > 2 && current_state->board[i + 2][j - 3] != C4_NONE && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 10000;
-					rule[2] += score;
-				}
-				//     printf("3-29\n");
-				if (j == 2 && current_state->board[i - 2][j + 1] != C4_NONE) { // first line
-					score = 10000;
-					rule[2] += score;
-				}
-			}
-			/*
-			// _OOO_ (both full) diagonal descending //first line
-			if (i>1 && i<5 && j == 2 && current_state->board[i - 1][j + 1] == 1 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE) {
-			if (current_state->board[i - 2][j + 1] != C4_NONE){
-			score = 10000;
-			rule[2] += score;
-			}
-			//        printf("3-30\n");
-			}
-			*/
-
-			//_OOO_ (XOR full) diagonal descending
-			if (j > 3 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == C4_NONE) {
-				if (j > 5 && current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j - 5] != C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//       printf("3-31\n");
-				}
-				else if (j > 5 && current_state->board[i][j - 1] != C4_NONE && current_state->board[i + 4][j - 5] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//        printf("3-31\n");
-				}
-				else if (j == 5 && current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-				}
-			}
-			//_OOO_ (both emtpy) diagonal descending
-			if (j > 4 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == C4_NONE) {
-				if (current_state->board[i][j - 1] == C4_NONE && current_state->board[i + 4][j - 5] == C4_NONE) {
-					score = 2000;
-					rule[2] += score;
-					//         printf("3-32\n");
-				}
-			}
+	while (cells[y] != C4_NONE && ++y < size_y)
+		;
 
-			//_OOOX  diagonal descending
-			if (j > 3 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == 0) {
-				if (current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//        printf("3-33\n");
-				}
-			}
+	if (y == size_y)
+		return -1;
 
-			//_OOOwall diagonal descending
-			if (i == 3 && j > 2 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-				if (current_state->board[i][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//        printf("3-34\n");
-				}
-			}
+	cells[y] = player;
+	g->current_state->num_of_pieces++;
+	update_score(g, player, column, y);
 
-			//XOOO_ diagonal descending
-			if (j > 4 && i < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == C4_NONE) {
-				if (current_state->board[i + 4][j - 5] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//      printf("3-35\n");
-				}
-			}
+	for (own = 0; own<2; own++)
+		if (g->current_state->rules_valid[own])
+			c4_rule_update(g->geo->rules, g->current_state->board, own,
+				column, y, g->current_state->rule_score[own]);
 
-			//wallOOO_  diagonal descending
-			if (j > 3 && i == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == C4_NONE) {
-				if (current_state->board[i + 3][j - 4] == C4_NONE) {
-					score = 1000;
-					rule[2] += score;
-					//      printf("3-36\n");
-				}
-			}
+	return y;
+}
 
-			//_OOOX (_below full) diagonal descending
-			if (j > 3 && i < 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == 0) {
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//        printf("3-37\n");
-				}
-			}
 
-			//_OOOwall (_below full) diagonal descending
-			if (j > 2 && i == 3 && current_state->board[i][j] == C4_NONE && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//         printf("3-38\n");
-				}
-			}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes a move of the game itself, rather than of a       **/
+/**  search, by drop_piece(), first noting what the drop will change in    **/
+/**  the undo log so that c4_game_undo() can take it back.  The row where  **/
+/**  the piece ended up is returned, or -1 if the column is full.          **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//XOOO_ (_below full) diagonal descending
-			if (j > 3 && i < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == C4_NONE) {
-				if (j > 4 && current_state->board[i + 4][j - 5] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//     printf("3-35\n");
-				}
-				if (j == 4) {
-					score = 300;
-					rule[2] += score;
-				}
-			}
+static int
+play_move(C4_game *g, int player, int column)
+{
+	Geometry *geo = g->geo;
+	char *cells = g->current_state->board[column];
+	int y = 0;
 
-			//wallOOO_ (_below full) diagonal descending
-			if (j > 2 && i == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == C4_NONE) {
-				if (j > 3 && current_state->board[i + 3][j - 4] != C4_NONE) {
-					score = 300;
-					rule[2] += score;
-					//          printf("3-36\n");
-				}
-				if (j == 3) {
-					score = 300;
-					rule[2] += score;
-				}
-			}
-			// XOOOX horizontal
-			if (i < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 4][j] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//wal000X 
-			if (i ==0 &&current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//X000wall
-			if (i ==3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 3][j] == 1) {
-				score = -200;
-				rule[2] += score;
-			}
-			// XOOOX diagonal ascending
-			if (i < 3 && j < 2 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 4][j + 4] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//wall000X   /
-			if (i==0&&j < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//X000wall    /
-			if (i == 3 && j < 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1) {
-				score = -200;
-				rule[2] += score;
-			}
+	assert(g->depth == 0);
 
-			// XOOOX diagonal descending
-			if (i < 3 && j > 3 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 4][j - 4] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//wall000X \ descending 
+	while (cells[y] != C4_NONE && ++y < geo->size_y)
+		;
 
-			if (i ==0 && j > 2 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 0) {
-				score = -200;
-				rule[2] += score;
-			}
-			//X000wall \ descending
+	if (y == geo->size_y)
+		return -1;
 
-		    if (i ==3 && j > 2 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-			score = -200;
-			rule[2] += score;
-			}
+	assert(g->undo_length < geo->total_size);
+	g->undo_log[g->undo_length].column = column;
+	g->undo_log[g->undo_length].row = y;
+	save_move(g, column, y, &g->undo_log[g->undo_length].undo,
+		g->undo_counts + 2 * geo->max_places * g->undo_length);
+	g->undo_length++;
 
+	return drop_piece(g, player, column);
+}
 
-			/*rule 4*/ // Human     ִ 3   ɼ  ´.
-					   //****//
-					   //_XX_ -> _XXO_
-			if (i > 0 && i<4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j > 0 && current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-				else if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-
-				else if (j == 0) {
-					score = 5000;
-					rule[3] += score;
-				}
-				//    printf("4-1\n");
-			}
-			//ù
-			/*
-			if (j == 0 && i > 0 && i<4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-			score = 5000;
-			rule[3] += score;
-			//   printf("4-2\n");
-			}*/
-
-			//OXX
-			if (i > 0 && i<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j > 0 && current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-				else if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-				else if (j == 0) {
-					score = 5000;
-					rule[3] += score;
-				}
-				//   printf("4-3\n");
-			}
-			//ù
-			/*
-			if (j == 0 && i > 0 && i<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-			score = 5000;
-			rule[3] += score;
-			}*/
-
-			//XOX
-			if (i > 0 && i<4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 0 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 3][j - 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j > 0 && (current_state->board[i - 1][j - 1] != C4_NONE || current_state->board[i + 3][j - 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//       printf("4-5\n");
-				else if (j == 0) {
-					score = 5000;
-					rule[3] += score;
-				}
-			}
 
-			//ù
-			/*
-			if (j == 0 && i > 0 && i<4 && current_state->board[i][j] == 0 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 0 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-			score = 5000;
-			rule[3] += score;
-			//     printf("4-6\n");
-			}*/
-
-			//**밢/**//
-			//XXO
-			if (j<4 && i>1 && i<5 && current_state->board[i][j] == 0 && current_state->board[i - 1][j - 1] == 0 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-				if (j>2 && current_state->board[i - 2][j - 3] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					//      rule[3] += score;
-				}
-				else if (j>2 && (current_state->board[i - 2][j - 3] != C4_NONE || current_state->board[i + 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//   printf("4-7\n");
-				else if (j == 2 && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i + 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-			}
-			//OXX
-			if (j<4 && i>1 && i<5 && current_state->board[i][j] == 0 && current_state->board[i - 1][j - 1] == 1 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-				if (j > 2 && current_state->board[i - 2][j - 3] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j > 2 && (current_state->board[i - 2][j - 3] != C4_NONE || current_state->board[i + 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//  printf("4-8\n");
-				else if (j == 2 && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i + 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function pushes the current state onto a stack.  pop_state()     **/
+/**  is used to pop from this stack.                                       **/
+/**                                                                        **/
+/**  Technically what it does, since the current state is considered to    **/
+/**  be the top of the stack, is push a copy of the current state onto     **/
+/**  the stack right above it.  The stack pointer (depth) is then          **/
+/**  incremented so that the new copy is considered to be the current      **/
+/**  state.  That way, all pop_state() has to do is decrement the stack    **/
+/**  pointer.                                                              **/
+/**                                                                        **/
+/**  For efficiency, the memory of every state on the stack is laid out    **/
+/**  in the game's arena when the game is created, so nothing is allocated **/
+/**  here.  The columns of a board lie one after another, and are copied   **/
+/**  in one go.                                                            **/
+/**                                                                        **/
+/****************************************************************************/
 
-			}
-			//XOX
-			if (j<4 && i>1 && i<5 && current_state->board[i][j] == 1 && current_state->board[i - 1][j - 1] == 0 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-				if (j>2 && current_state->board[i - 2][j - 3] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j>2 && (current_state->board[i - 2][j - 3] != C4_NONE || current_state->board[i + 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//   printf("4-9\n");
-				else if (j == 2 && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i + 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
+static void
+push_state(C4_game *g)
+{
+	Game_state *old_state, *new_state;
 
+	assert(g->depth < C4_MAX_LEVEL);
+	old_state = &g->state_stack[g->depth++];
+	new_state = &g->state_stack[g->depth];
+	copy_state(g->geo, new_state, old_state);
+	g->current_state = new_state;
+}
 
-			}
-			//**밢 \ **//
-			//XXO
-			if (i>1 && j<4 && i<5 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE) {
-				if (j>2 && current_state->board[i + 2][j - 3] != C4_NONE && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j>2 && (current_state->board[i + 2][j - 3] != C4_NONE || current_state->board[i - 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i - 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
 
-			}
-			//OXX
-			if (i>1 && j<4 && i<5 && current_state->board[i - 1][j + 1] == 1 && current_state->board[i][j] == 0 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE) {
-				if (j>2 && current_state->board[i + 2][j - 3] != C4_NONE && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j>2 && (current_state->board[i + 2][j - 3] != C4_NONE || current_state->board[i - 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//   printf("4-10\n");
-				else if (j == 2 && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i - 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
-			}
-			//XOX
-			if (i>1 && j<4 && i<5 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE) {
-				if (j>2 && current_state->board[i + 2][j - 3] != C4_NONE && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j>2 && (current_state->board[i + 2][j - 3] != C4_NONE || current_state->board[i - 2][j + 1] != C4_NONE)) {
-					score = 150;
-					rule[3] += score;
-				}
-				//      printf("4-11\n");
-				else if (j == 2 && current_state->board[i - 2][j + 1] != C4_NONE) {
-					score = 5000;
-					rule[3] += score;
-				}
-				else if (j == 2 && current_state->board[i - 2][j + 1] == C4_NONE) {
-					score = 150;
-					rule[3] += score;
-				}
+/****************************************************************************/
+/**                                                                        **/
+/**  This function copies the state from into the state to, which may      **/
+/**  belong to another game on a board of the same shape, geo.             **/
+/**                                                                        **/
+/****************************************************************************/
 
-			}
+static void
+copy_state(const Geometry *geo, Game_state *to, const Game_state *from)
+{
+	register int i;
 
-			/*rule 5*/ //7 
-			if (i>1 && j>1 && current_state->board[i][j] == 1 && current_state->board[i - 1][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i - 1][j - 1] == 1 && current_state->board[i - 2][j - 2] == 1) {
-
-				if (i>2 && i < 6 && j < 5 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i - 3][j] == 0) {//4  ɼ     !
-					score = -100;
-					rule[4] += score;
-					//    printf("5-1\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//  printf("5-1\n");
-				}
-				// 7 ִ° // 7
-			}
-			if (j>1 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1) {
-				if (i>0 && i<4 && j<5 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i + 3][j] == 0) {
-					score = -100;
-					rule[4] += score;
-					//    printf("5-2\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//    printf("5-2\n");
-				}
-				//¿ 7
+	/* Copy the board */
 
-			}
-			if (i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1) {
-				//¿   7
-				if (i>0 && i<4 && j<3 && current_state->board[i - 1][j] == 0 && current_state->board[i + 3][j + 3] == 0) {
-					score = -100;
-					rule[4] += score;
-					//     printf("5-3\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//     printf("5-3\n");
-				}
+	memcpy(to->board[0], from->board[0], geo->total_size);
 
-			}
-			if (i>1 && j<5 && current_state->board[i][j] == 1 && current_state->board[i - 1][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i - 1][j + 1] == 1 && current_state->board[i - 2][j + 2] == 1) {
-				//Ϲ 7
-				if (i<6 && i>2 && j<3 && current_state->board[i + 1][j] == 0 && current_state->board[i - 3][j + 3] == 0) {
-					score = -100;
-					rule[4] += score;
-					//   printf("5-4\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//    printf("5-4\n");
-				}
-			}
-			if (i>1 && j>1 && current_state->board[i][j] == 1 && current_state->board[i - 1][j] == 0 && current_state->board[i - 2][j] == 0 && current_state->board[i - 1][j - 1] == 0 && current_state->board[i - 2][j - 2] == 0) {
-				//score =  7 ɼ ai °
-				if (i>2 && i < 6 && j < 5 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i - 3][j] == 0) {// 4  ɼ  ( ĭ ƴϸ)   !
-					score = -100;
-					rule[4] += score;
-					//     printf("5-5\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//      printf("5-5\n");
-				}
+	/* Copy the score array */
 
-			}
-			if (j>1 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i + 1][j - 1] == 0 && current_state->board[i + 2][j - 2] == 0) {
-				if (i>0 && i<4 && j<5 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i + 3][j] == 0) {
-					score = -100;
-					rule[4] += score;
-					//   printf("5-6\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//        printf("5-6\n");
-				}
+	memcpy(to->score_array, from->score_array, 2 * geo->win_places);
 
-			}
-			if (i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j] == 0 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 2] == 0) {
-				//¿   7
-				if (i>0 && i<4 && j<3 && current_state->board[i - 1][j] == 0 && current_state->board[i + 3][j + 3] == 0) {
-					score = -100;
-					rule[4] += score;
-					//     printf("5-7\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//   printf("5-7\n");
-				}
+	to->score[0] = from->score[0];
+	to->score[1] = from->score[1];
+	to->winner = from->winner;
+	to->win_place = from->win_place;
+	to->num_of_pieces = from->num_of_pieces;
 
-			}
-			if (i>1 && j<4 && current_state->board[i][j] == 1 && current_state->board[i - 1][j] == 0 && current_state->board[i - 2][j] == 0 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i - 2][j + 2] == 0) {
-				//Ϲ 7
-				if (i<6 && i>2 && j<3 && current_state->board[i + 1][j] == 0 && current_state->board[i - 3][j + 3] == 0) {
-					score = -100;
-					rule[4] += score;
-					//    printf("5-8\n");
-				}
-				else {
-					score = 2000;
-					rule[4] += score;
-					//    printf("5-8\n");
-				}
+	for (i = 0; i<2; i++) {
+		to->rules_valid[i] = from->rules_valid[i];
+		if (from->rules_valid[i])
+			memcpy(to->rule_score[i], from->rule_score[i],
+				sizeof(from->rule_score[i]));
+	}
+}
 
-			}
-			/*rule6*/ // θ 
 
-			if (j<5 && i>2 && current_state->board[i - 3][j + 1] == 0 && current_state->board[i - 2][j + 1] == 0 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//xxx_ horizontal
-				score = -10000;
-				rule[5] += score;
-				//    printf("6-1\n");
-			}
-			if (i<4 && j<5 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 1] == 0 && current_state->board[i + 3][j + 1] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//_xxx
-				score = -10000;
-				rule[5] += score;
-				// printf("6-2\n");
-			}
-			if (j<5 && i>0 && i<5 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i + 2][j + 1] == 0 && current_state->board[i][j + 1] == C4_NONE) {//x_xx
-				score = -10000;
-				rule[5] += score;
-				//    printf("6-3\n");
-			}
-			if (j<5 && i>1 && i<6 && current_state->board[i - 2][j + 1] == 0 && current_state->board[i - 1][j + 1] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 0 && current_state->board[i][j + 1] == C4_NONE) {//xx_x
-				score = -10000;
-				rule[5] += score;
-				//   printf("6-4\n");
-			}
-			if (j<2 && i>2 && current_state->board[i - 3][j + 4] == 0 && current_state->board[i - 2][j + 3] == 0 && current_state->board[i - 1][j + 2] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//xxx_ diagonal descending
-				score = -10000;
-				rule[5] += score;
-				//      printf("6-5\n");
-			}
-			if (j>1 && i<4 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j - 1] == 0 && current_state->board[i + 3][j - 2] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//_xxx diagonal descending
-				score = -10000;
-				rule[5] += score;
-				//   printf("6-6\n");
-			}
-			if (j>0 && i>0 && j<4 && i<5 && current_state->board[i - 1][j + 2] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i + 2][j - 1] == 0 && current_state->board[i][j + 1] == C4_NONE) {//x_xx diagonal descending
-				score = -10000;
-				rule[5] += score;
-				//   printf("6-7\n");
-			}
-			if (i>1 && j<3 && i<6 && current_state->board[i - 2][j + 3] == 0 && current_state->board[i - 1][j + 2] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 0 && current_state->board[i][j + 1] == C4_NONE) {//xx_x diagonal descending
-				score = -10000;
-				rule[5] += score;
-				//    printf("6-8\n");
-			}
-			if (j<2 && i<4 && current_state->board[i + 1][j + 2] == 0 && current_state->board[i + 2][j + 3] == 0 && current_state->board[i + 3][j + 4] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//_xxx diagonal ascending
-				score = -10000;
-				rule[5] += score;
-				//   printf("6-9\n");
-			}
-			if (j < 5 && j>1 && i>2 && current_state->board[i - 3][j - 2] == 0 && current_state->board[i - 2][j - 1] == 0 && current_state->board[i - 1][j] == 0 && current_state->board[i][j] == 1 && current_state->board[i][j + 1] == C4_NONE) {//xxx_ diagonal ascending
-				score = -10000;
-				rule[5] += score;
-				//     printf("6-10\n");
-			}
-			if (i>0 && j<3 && i<5 && current_state->board[i - 1][j] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 2] == 0 && current_state->board[i + 2][j + 3] == 0 && current_state->board[i][j + 1] == C4_NONE) {//x_xx diagonal ascending
-				score = -10000;
-				rule[5] += score;
-				//  printf("6-11\n");
-			}
-			if (j>0 && i>1 && j<4 && i<6 && current_state->board[i - 2][j - 1] == 0 && current_state->board[i - 1][j] == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 2] == 0 && current_state->board[i][j + 1] == C4_NONE) {//xx_x diagonal ascending
-				score = -10000;
-				rule[5] += score;
-				//      printf("6-12\n");
-			}
-			/*
-			/*rule7 //7.  ÿ  ϰ ϵ  ̴.       2 Ǿ ִ Ȳ̶ ̸ ̿   3 Ų
-			//_ooo || ooo_ ̷ . _ ؿ   ִ 
-			if (i>0 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1) {//horizontal _ooo || ooo_
-			if ((j>0 && current_state->board[i - 1][j - 1] == C4_NONE) || (i<4 && current_state->board[i + 3][j - 1] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-1\n");
-			}
-			else if (i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1) {//diagonal ascending _ooo || ooo_
-			if ((j>1 && i>0 && current_state->board[i - 1][j - 2] == C4_NONE) || (i<4 && current_state->board[i + 3][j + 2] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-2\n");
-			}
-			else if (j>1 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1) {//diagonal descending _ooo || ooo_
-			if ((i>0 && current_state->board[i - 1][j] == C4_NONE) || (j>3 && i<4 && current_state->board[i + 3][j - 4] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-3\n");
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions make and take back the moves of the search.  Unless   **/
+/**  g->in_place is set, search_drop() pushes a copy of the current state  **/
+/**  and drops the piece on the copy, and search_undo() pops the copy off  **/
+/**  again.  Otherwise the piece is dropped on the current state itself,   **/
+/**  after save_move() has saved the counts of the win places through its  **/
+/**  cell in g->saved_counts, and search_undo() puts them back with        **/
+/**  unmake_move().  Only those counts change, so a move costs the same on **/
+/**  any size of board, where a copy costs two bytes for every win place.  **/
+/**  The rule scores are not kept up to date in place.                     **/
+/**                                                                        **/
+/**  search_drop() returns the row the piece lands in, or -1 (with nothing **/
+/**  changed) if the column is full.  g->depth counts the moves made       **/
+/**  either way.                                                           **/
+/**                                                                        **/
+/****************************************************************************/
 
-			}
-			else if (j > 1 && current_state->board[i][j] == 1 && current_state->board[i][j - 1] == 0 && current_state->board[i][j - 2] == 0) {
-			score = 5;
-			total += score;
-			printf("7-4\n");
-			}
-			*/
-
-			/*
-			/*rule7 //7.  ÿ  ϰ ϵ  ̴.       2 Ǿ ִ Ȳ̶ ̸ ̿   3 Ų
-			//_ooo || ooo_ ̷ . _ ؿ   ִ 
-			if (i>0 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 2][j] == 1) {//horizontal _ooo || ooo_
-			if ((j>0 && current_state->board[i - 1][j - 1] == C4_NONE) || (i<4 && current_state->board[i + 3][j - 1] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-1\n");
-			}
-			else if (i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == 1) {//diagonal ascending _ooo || ooo_
-			if ((j>1 && i>0 && current_state->board[i - 1][j - 2] == C4_NONE) || (i<4 && current_state->board[i + 3][j + 2] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-2\n");
-			}
-			else if (j>1 && i<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == 1) {//diagonal descending _ooo || ooo_
-			if ((i>0 && current_state->board[i - 1][j] == C4_NONE) || (j>3 && i<4 && current_state->board[i + 3][j - 4] == C4_NONE)) {
-			score = 10;
-			total += score;
-			}
-			printf("7-3\n");
+static int
+search_drop(C4_game *g, int player, int column, Undo *undo)
+{
+	Geometry *geo = g->geo;
+	Game_state *current_state = g->current_state;
+	char *cells = current_state->board[column];
+	int y = 0;
 
-			}
-			else if (j > 1 && current_state->board[i][j] == 1 && current_state->board[i][j - 1] == 0 && current_state->board[i][j - 2] == 0) {
-			score = 5;
-			total += score;
-			printf("7-4\n");
-			}
-			*/
-
-			// rule 7//
-			// **θ ѰǴ°**//
-			//1. 00_0_00  ĭ  ai  2
-			if (i < 4 && i > 2 && current_state->board[i][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i - 3][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 1][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 1][j - 1] != C4_NONE) {
-					score = 10000;
-					rule[6] += score;
-				} // ħ ִ.
-
-				else if (j == 0) { // first line
-					score = 10000;
-					rule[6] += score;
-				}
-
-				else if (j > 0 && (current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 1][j - 1] == C4_NONE)) {
-					score = 1000;
-					rule[6] += score;
-				} //ʹħ
-				else if (j > 0 && (current_state->board[i - 1][j - 1] != C4_NONE || current_state->board[i + 1][j - 1] != C4_NONE)) {
-					score = 500;
-					rule[6] += score;
-				} //ʹħִ
+	if (!g->in_place) {
+		push_state(g);
+		y = drop_piece(g, player, column);
+		if (y < 0)
+			pop_state(g);
+		else if (g->table != NULL)
+			g->hash ^= geo->keys[2 * (column * geo->size_y + y) + player];
+		return y;
+	}
 
-			}
+	while (cells[y] != C4_NONE && ++y < geo->size_y)
+		;
 
-			//2. 0_0_0   ĭ  AI  Ѱ
-			if (i < 5 && i>1 && current_state->board[i][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 1][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 1][j - 1] != C4_NONE) {
-					score = 200;
-					rule[6] += score;
-				} // ħ ִ.
-				if (j == 0) {
-					score = 200;
-					rule[6] += score;
-				}
-				else if (j > 0 && (current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 1][j - 1] == C4_NONE)) {
-					score = 150;
-					rule[6] += score;
-				} //ʹħ
-				else if (j > 0 && (current_state->board[i - 1][j - 1] != C4_NONE || current_state->board[i + 1][j - 1] != C4_NONE)) {
-					score = 100;
-					rule[6] += score;
-				} //ʹħִ
-
-			}/*
-			 //first line
-			 if (i < 5 && i>1 && j == 0 && current_state->board[i][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 1][j] == C4_NONE) {
-			 score = 200;
-			 rule[6] += score;
-			 }
-			 */
-
-			 //2. /
-			if (i < 5 && i>1 && j < 4 && j>1 && current_state->board[i][j] == 1 && current_state->board[i - 2][j - 2] == 1 && current_state->board[i + 2][j + 2] == 1 && current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 1][j + 1] == C4_NONE) {
-				if (current_state->board[i - 1][j - 2] != C4_NONE && current_state->board[i + 1][j] != C4_NONE) {
-					score = 200;
-					rule[6] += score;
-				}// ħ 
-				else if (current_state->board[i - 1][j - 2] == C4_NONE && current_state->board[i + 1][j] == C4_NONE) {
-					score = 150;
-					rule[6] += score;
-				}// ħ x
-				else if (current_state->board[i - 1][j - 2] != C4_NONE || current_state->board[i + 1][j] != C4_NONE) {
-					score = 100;
-					rule[6] += score;
-				}//ʹħ
-			}
+	if (y == geo->size_y)
+		return -1;
 
-			//2. \ (descending diagonal)
-			if (i < 5 && i>1 && j < 4 && j>1 && current_state->board[i][j] == 1 && current_state->board[i - 2][j + 2] == 1 && current_state->board[i + 2][j - 2] == 1 && current_state->board[i - 1][j + 1] == C4_NONE && current_state->board[i + 1][j - 1] == C4_NONE) {
-				if (current_state->board[i - 1][j] != C4_NONE && current_state->board[i + 1][j - 2] != C4_NONE) {
-					score = 200;
-					rule[6] += score;
-				}//ʹħ 
-				else if (current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 1][j - 2] == C4_NONE) {
-					score = 150;
-					rule[6] += score;
-				}
-				else if (current_state->board[i - 1][j] != C4_NONE || current_state->board[i + 1][j - 2] != C4_NONE) {
-					score = 100;
-					rule[6] += score;
-				}
-			}
-			//3. _0_0_    ĭ    Ѱ
-			if (i > 0 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 2][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 1][j] == C4_NONE && current_state->board[i + 3][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i + 1][j - 1] != C4_NONE) {
-					score = 150;
-					rule[6] += score;
-				} // ħ 0
-				else if (j == 0) {
-					score = 150;
-					rule[6] += score;
-				}
-				else {
-					score = 200;
-					rule[6] += score;
-				}
-			}
-			//3. /
-			if (i < 5 && j>1 && j < 4 && i>1 && current_state->board[i][j] == C4_NONE && current_state->board[i - 2][j - 2] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE && current_state->board[i - 1][j - 1] == 1 && current_state->board[i + 1][j + 1] == 1) {
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 150;
-					rule[6] += score;
-				}// ħ 0
-				else {
-					score = 200;
-					rule[6] += score;
-				}
-			}
-			//3. \ (descending diagonal)
-			if (i < 5 && j>1 && j < 4 && i>1 && current_state->board[i][j] == C4_NONE && current_state->board[i - 2][j + 2] == C4_NONE && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i - 1][j + 1] == 1 && current_state->board[i + 1][j - 1] == 1) {
-				if (current_state->board[i][j - 1] != C4_NONE) {
-					score = 150;
-					rule[6] += score;
-				} // ħ 
-				else {
-					score = 200;
-					rule[6] += score;
-				}
-			}
-			//4. ĭ   2  00_0 
-			if (i>2 && current_state->board[i][j] == 1 && current_state->board[i - 2][j] == 1 && current_state->board[i - 3][j] == 1 && current_state->board[i - 1][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}//ħ 
-				else if (j == 0) {
-					score = 300;
-					rule[6] += score;
-				}
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
-			//4. /
-			if (i < 4 && j < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 2][j + 2] == C4_NONE && current_state->board[i + 3][j + 3] == 1) {
-				if (current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}//ħ 
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
-			//4. descending diagonal
-			if (i < 4 && j > 2 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 2][j - 2] == C4_NONE && current_state->board[i + 3][j - 3] == 1) {
-				if (current_state->board[i + 2][j - 3] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
-			//5. 0_00 hori
-			if (i > 3 && current_state->board[i][j] == 1 && current_state->board[i - 2][j] == C4_NONE && current_state->board[i - 3][j] == 1 && current_state->board[i - 1][j] == 1) {
-				if (j > 0 && current_state->board[i - 2][j - 1] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}//ħ 
-				else if (j == 0) {
-					score = 300;
-					rule[6] += score;
-				}
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
-			//5. /
-			if (i < 4 && j < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == C4_NONE && current_state->board[i + 2][j + 2] == 1 && current_state->board[i + 3][j + 3] == 1) {
-				if (current_state->board[i + 1][j] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}//ħ 
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
-			//5. descending diagonal
-			if (i < 4 && j > 2 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == C4_NONE && current_state->board[i + 2][j - 2] == 1 && current_state->board[i + 3][j - 3] == 1) {
-				if (current_state->board[i + 1][j - 2] != C4_NONE) {
-					score = 300;
-					rule[6] += score;
-				}
-				else {
-					score = 1000;
-					rule[6] += score;
-				}
-			}
+	assert(g->depth < C4_MAX_LEVEL);
+	save_move(g, column, y, undo,
+		g->saved_counts + 2 * geo->max_places * g->depth);
 
-			//rule 8//
-			/* rule  θ  2 */
-			//00_0 ̷ ĭ  ε  
-			//horizontal
-
-			//first line
-			/*
-			if (i < 4 && j == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 2][j] == C4_NONE) {
-			score = 300;
-			rule[7] += score;
-			}*/
-
-			if (i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i + 3][j] == 1 && current_state->board[i + 2][j] == C4_NONE) {
-				//ĭ ؿ ħ .
-				if (j>0 && current_state->board[i + 2][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-					//printf("20_1\n");
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (j>0 && current_state->board[i + 2][j - 1] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-				else if (j == 0) {
-					score = 300;
-					rule[7] += score;
-				}//first line
-			}
-			//diagonal descending 00_0
-			if (i < 4 && j>2 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 2][j - 2] == C4_NONE) {
-				//ĭ ؿ ħ .
-				if (current_state->board[i + 2][j - 3] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (current_state->board[i + 2][j - 3] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-			}
-			//diagonal ascending 00_0
-			if (j < 3 && i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 2][j + 2] == C4_NONE) {
-				//ĭ ؿ ħ .
-				if (current_state->board[i + 2][j + 1] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-			}
+	cells[y] = player;
+	current_state->num_of_pieces++;
+	update_score(g, player, column, y);
+	if (g->table != NULL)
+		g->hash ^= geo->keys[2 * (column * geo->size_y + y) + player];
+	g->depth++;
+	return y;
+}
 
-			//0_00 ̷ ĭ  ε  
-			//horizontal
-			//first line
-			/*
-			if (i < 4 && j == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == C4_NONE && current_state->board[i + 3][j] == 1 && current_state->board[i + 2][j] == 1) {
-			score = 300;
-			rule[7] += score;
-			}
-			*/
-			if (i < 4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == C4_NONE && current_state->board[i + 3][j] == 1 && current_state->board[i + 2][j] == 1) {
-				//ĭ ؿ ħ .
-				if (j>0 && current_state->board[i + 1][j - 1] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (j>0 && current_state->board[i + 1][j - 1] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-				else if (j == 0) {
-					score = 300;
-					rule[7] += score;
-				}
-			}
-			//diagonal descending 0_00
-			if (i < 4 && j>2 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == C4_NONE && current_state->board[i + 3][j - 3] == 1 && current_state->board[i + 2][j - 2] == 1) {
-				//ĭ ؿ ħ .
-				if (current_state->board[i + 1][j - 2] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (current_state->board[i + 1][j - 2] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-			}
-			//diagonal ascending 0_00
-			if (i < 4 && j < 3 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == C4_NONE && current_state->board[i + 3][j + 3] == 1 && current_state->board[i + 2][j + 2] == 1) {
-				//ĭ ؿ ħ .
-				if (current_state->board[i + 1][j] == C4_NONE) {
-					score = 1000;
-					rule[7] += score;
-				}
-				//ĭ ؿ ħ ִ. -> ٷ   ۰ .
-				else if (current_state->board[i + 1][j] != C4_NONE) {
-					score = 300;
-					rule[7] += score;
-				}
-			}
-			//  ־ 4  ɼ ִ. _oo_
-			//horizontal
-			if (i < 5 && i>0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 2][j] == C4_NONE) {
-				if (j > 0 && current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 2][j - 1] == C4_NONE) {
-					// ĭ ĭ ΰ  empty
-					score = 150;
-					rule[7] += score;
-				}
-				else if (j > 0 && ((current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 2][j - 1] != C4_NONE) || (current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 2][j] == C4_NONE))) {
-					// ĭ ĭ ΰ  ϳ empty
-					score = 100;
-					rule[7] += score;
-				}
-				else if (j > 0 && current_state->board[i - 1][j - 1] != C4_NONE && current_state->board[i + 2][j - 1] != C4_NONE) {
-					// ĭ ĭ ΰ  not empty
-					score = 50;
-					rule[7] += score;
-				}
-				else if (j == 0) {
-					score = 50;
-					rule[7] += score;
-				}
-			}
-			//diagonal descending
-			if (i<5 && i>0 && j<5 && j>1&&current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && current_state->board[i - 1][j + 1] == C4_NONE && current_state->board[i + 2][j - 2] == C4_NONE) {
-				if (j>2 && current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 2][j - 3] == C4_NONE) {
-					// ĭ ĭ ΰ  empty
-					score = 150;
-					rule[7] += score;
-				}
-				else if (j>2 && ((current_state->board[i - 1][j] == C4_NONE && current_state->board[i + 2][j - 3] != C4_NONE) || (current_state->board[i - 1][j] != C4_NONE && current_state->board[i + 2][j - 3] == C4_NONE))) {
-					// ĭ ĭ ΰ  ϳ empty
-					score = 100;
-					rule[7] += score;
-				}
-
-				else if (j == 2 && current_state->board[i - 1][j] == C4_NONE) {//first line
-					score = 100;
-					rule[7] += score;
-
-				}
-
-				else if (j>2 && current_state->board[i - 1][j] != C4_NONE && current_state->board[i + 2][j - 3] != C4_NONE) {
-					// ĭ ĭ ΰ  not empty
-					score = 50;
-					rule[7] += score;
-				}
-				else if (j == 2 && current_state->board[i - 1][j] != C4_NONE) {
-					score = 50;
-					rule[7] += score;
-				}
+static void
+search_undo(C4_game *g, int column, int row, const Undo *undo)
+{
+	if (g->table != NULL)
+		g->hash ^= g->geo->keys[2 * (column * g->geo->size_y + row) +
+			g->current_state->board[column][row]];
 
-			}
-			//diagonal ascending
-			if (i > 0 && i < 5 && j < 4 && j>0&&current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && current_state->board[i - 1][j - 1] == C4_NONE && current_state->board[i + 2][j + 2] == C4_NONE) {
-				if (j > 1 && current_state->board[i - 1][j - 2] == C4_NONE && current_state->board[i + 2][j + 1] == C4_NONE) {
-					// ĭ ĭ ΰ  empty
-					score = 150;
-					rule[7] += score;
-				}
-
-				else if (j > 1 && ((current_state->board[i - 1][j - 2] == C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) || (current_state->board[i - 1][j - 2] != C4_NONE && current_state->board[i + 2][j + 1] == C4_NONE))) {
-					// ĭ ĭ ΰ  ϳ empty
-					score = 100;
-					rule[7] += score;
-				}
-
-				else if (j == 1 && current_state->board[i + 2][j + 1] == C4_NONE) {
-					score = 100;
-					rule[7] += score;
-				}
-
-				else if (j > 1 && current_state->board[i - 1][j - 2] != C4_NONE && current_state->board[i + 2][j + 1] != C4_NONE) {
-					// ĭ ĭ ΰ  not empty
-					score = 50;
-					rule[7] += score;
-				}
-
-				else if (j == 1 && current_state->board[i + 2][j + 1] != C4_NONE) {
-					score = 50;
-					rule[7] += score;
-				}
-			}
+	if (!g->in_place) {
+		pop_state(g);
+		return;
+	}
 
-			
-			//  ִ. !OO? ? not empty ! 浹 ƴ
-			//horizontal
-			if (i<5 && i>0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1 && (current_state->board[i - 1][j] == 0 || current_state->board[i + 2][j] == 0)) {
-				if ((current_state->board[i - 1][j] == 0 && current_state->board[i + 2][j] == 0)) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-				//printf("20\n");
-			}
+	g->depth--;
+	unmake_move(g, column, row, undo,
+		g->saved_counts + 2 * g->geo->max_places * g->depth);
+}
 
-			if (i == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1) { // left wall
-				if (current_state->board[i + 2][j] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
 
-			if (i == 5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j] == 1) { // right wall
-				if (current_state->board[i - 1][j] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions save what dropping a piece in column, row of the      **/
+/**  current state will change, the counts of the win places through the   **/
+/**  cell into saved and the rest into undo, and put it all back once the  **/
+/**  piece has been dropped, taking the piece away again.  The rule scores **/
+/**  are left to the caller.                                               **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//diagonal descending _OO? (? : blocked)
-			if (i>0 && j>1 && i<5 && j<5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1 && (current_state->board[i - 1][j + 1] == 0 || current_state->board[i + 2][j - 2] == 0)) {
-				if ((current_state->board[i - 1][j + 1] == 0 && current_state->board[i + 2][j - 2] == 0)) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+static void
+save_move(C4_game *g, int column, int row, Undo *undo, unsigned char *saved)
+{
+	Geometry *geo = g->geo;
+	Game_state *current_state = g->current_state;
+	int k, start, end;
+
+	start = geo->map_start[column * geo->size_y + row];
+	end = geo->map_start[column * geo->size_y + row + 1];
+	for (k = start; k<end; k++)
+		memcpy(saved + 2 * (k - start),
+			current_state->score_array + 2 * geo->map[k], 2);
+
+	undo->score[0] = current_state->score[0];
+	undo->score[1] = current_state->score[1];
+	undo->winner = current_state->winner;
+}
 
-			if (i == 0 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1) { // left wall
-				if (j > 1 && current_state->board[i + 2][j - 2] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+static void
+unmake_move(C4_game *g, int column, int row, const Undo *undo,
+	const unsigned char *saved)
+{
+	Geometry *geo = g->geo;
+	Game_state *current_state = g->current_state;
+	int k, start, end;
+
+	start = geo->map_start[column * geo->size_y + row];
+	end = geo->map_start[column * geo->size_y + row + 1];
+	for (k = start; k<end; k++)
+		memcpy(current_state->score_array + 2 * geo->map[k],
+			saved + 2 * (k - start), 2);
+
+	current_state->board[column][row] = C4_NONE;
+	current_state->num_of_pieces--;
+	current_state->score[0] = undo->score[0];
+	current_state->score[1] = undo->score[1];
+	current_state->winner = undo->winner;
+}
 
-			if (i == 5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j - 1] == 1) { // right wall
-				if (j < 5 && current_state->board[i - 1][j + 1] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
 
+/****************************************************************************/
+/**                                                                        **/
+/**  This recursive function determines how good the current state may     **/
+/**  turn out to be for the specified player.  It does this by looking     **/
+/**  ahead level moves.  It is assumed that both the specified player and  **/
+/**  the opponent may make the best move possible.  alpha and beta are     **/
+/**  used for alpha-beta cutoff so that the game tree can be pruned to     **/
+/**  avoid searching unneccessary paths.                                   **/
+/**                                                                        **/
+/**  The specified poll function (if any) is called at the appropriate     **/
+/**  intervals.  If the search has been stopped (see c4_async_cancel()),   **/
+/**  0 is returned at once and the caller's result is meaningless.         **/
+/**                                                                        **/
+/**  The worst goodness that the current state can produce in the number   **/
+/**  of moves (levels) searched is returned.  This is the best the         **/
+/**  specified player can hope to achieve with this state (since it is     **/
+/**  assumed that the opponent will make the best moves possible).  The    **/
+/**  states at the last level are scored by the game's leaf_eval.          **/
+/**                                                                        **/
+/****************************************************************************/
 
-			//diagonal ascending
-			if (i>0 && j>0 && i<5 && j<4 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1 && (current_state->board[i - 1][j - 1] == 0 || current_state->board[i + 2][j + 2] == 0)) {
-				if ((current_state->board[i - 1][j - 1] == 0 && current_state->board[i + 2][j + 2] == 0)) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+static int
+evaluate(C4_game *g, int player, int level, int alpha, int beta)
+{
+	Game_state *current_state = g->current_state;
+	int *drop_order = g->geo->drop_order;
 
-			if (i == 0 && j < 5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1) { // left wall
-				if (j < 4 && current_state->board[i + 2][j + 2] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+	if (g->poll_function != NULL && g->next_poll <= clock()) {
+		g->next_poll += g->poll_interval;
+		(*g->poll_function)();
+	}
 
-			if (i == 5 && j < 5 && current_state->board[i][j] == 1 && current_state->board[i + 1][j + 1] == 1) { // right wall
-				if (j > 0 && current_state->board[i - 1][j - 1] == 0) {
-					score = 5;
-					rule[7] += score;
-				}
-				else {
-					score = 10;
-					rule[7] += score;
-				}
-			}
+	if (c4_atomic_load(&g->stop))
+		return 0;
 
+	g->nodes++;
 
-			//column ΰ // vertical
-			if (j>0 && j < 5 && current_state->board[i][j] == 1 && current_state->board[i][j - 1] == 1 && current_state->board[i][j + 1] == C4_NONE) {
-				score = 10;
-				rule[7] += score;
+	if (current_state->winner == player)
+		return INT_MAX - g->depth;
+	else if (current_state->winner == other(player))
+		return -(INT_MAX - g->depth);
+	else if (current_state->num_of_pieces == g->geo->total_size)
+		return 0; /* a tie */
+	else if (level == g->depth)
+		return (*g->leaf_eval)(g, player, g->leaf_data);
+	else {
+		/* Assume it is the other player's turn. */
+		int best = -(INT_MAX);
+		int maxab = alpha;
+		int first = -1, best_column = -1;
+		Undo undo;
+
+		/* The transposition table may know enough about the state       */
+		/* already; if not, the best move it has for it is tried first.  */
+		if (g->table != NULL &&
+			probe_table(g, player, level, alpha, beta, &best, &first))
+			return -best;
+
+		for (int i = -1; i<g->geo->size_x; i++) {
+			int column = (i < 0) ? first : drop_order[i];
+			if (column < 0 || (i >= 0 && column == first))
+				continue;
+			if (current_state->board[column][g->geo->size_y - 1] != C4_NONE)
+				continue; /* The column is full. */
+			int row = search_drop(g, other(player), column, &undo);
+			if (g->table != NULL && g->depth < level)
+				c4_tt_prefetch(g->table, table_key(g, other(player)));
+			int goodness = evaluate(g, other(player), level, -beta, -maxab);
+			if (goodness > best) {
+				best = goodness;
+				best_column = column;
+				if (best > maxab)
+					maxab = best;
 			}
+			search_undo(g, column, row, &undo);
+			if (best > beta)
+				break;
 		}
-	}
-
-	for (int l = 0; l < 8; l++) {
-		total += rule[l];
-		nthCol[l] = 0;
-		if (rule[l] != 0) {
-			nthCol[l] = l + 1;
-		}
-	}
 
+		if (g->table != NULL)
+			store_table(g, player, level, alpha, beta, best, best_column);
 
-	return total;
+		/* What's good for the other player is bad for this one. */
+		return -best;
+	}
 }
 
+
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns a two-dimensional array containing the state of **/
-/**  the game board.  Do not modify this array.  It is assumed that a game **/
-/**  is in progress.  The value of this array is dynamic and will change   **/
-/**  to reflect the state of the game as the game progresses.  It becomes  **/
-/**  and stays undefined when the game ends.                               **/
+/**  These functions look the current state of a search up in the game's   **/
+/**  transposition table, player having just moved, and put what the       **/
+/**  search found out about it there.  level, alpha and beta are those     **/
+/**  evaluate() was called with, and best is the goodness of the other     **/
+/**  player's best move, which evaluate() negates.  It is exact from alpha **/
+/**  to beta; below alpha, where no move came up to it, the true best may  **/
+/**  be less, and above beta, where the search cut off, more.              **/
 /**                                                                        **/
-/**  The first dimension specifies the column number and the second        **/
-/**  dimension specifies the row number, where column and row numbering    **/
-/**  start at 0 and the bottow row is considered the 0th row.  A value of  **/
-/**  0 specifies that the position is occupied by a piece owned by player  **/
-/**  0, a value of 1 specifies that the position is occupied by a piece    **/
-/**  owned by player 1, and a value of C4_NONE specifies that the position **/
-/**  is unoccupied.                                                        **/
+/**  probe_table() sets column to the best move the table has for the      **/
+/**  state, if it has one.  If the table went deep enough, and its score   **/
+/**  settles the state as searching it would, best is set to the score,    **/
+/**  and true is returned; otherwise false is.                             **/
 /**                                                                        **/
 /****************************************************************************/
 
-char **
-c4_board(void)
+static bool
+probe_table(C4_game *g, int player, int level, int alpha, int beta,
+	int *best, int *column)
+{
+	C4_tt_entry entry;
+	int score;
+
+	g->table_probes++;
+	if (!c4_tt_probe(g->table, table_key(g, player), &entry))
+		return false;
+	g->table_hits++;
+
+	if (entry.column < g->geo->size_x)
+		*column = entry.column;
+	if (entry.depth < level - g->depth)
+		return false;
+
+	score = from_table(g, entry.score);
+	if (entry.bound == C4_TT_EXACT ||
+		(entry.bound == C4_TT_LOWER && score > beta) ||
+		(entry.bound == C4_TT_UPPER && score < alpha)) {
+		*best = score;
+		return true;
+	}
+	return false;
+}
+
+static void
+store_table(C4_game *g, int player, int level, int alpha, int beta,
+	int best, int column)
 {
-	assert(game_in_progress);
-	return current_state->board;
+	C4_tt_entry entry;
+
+	if (c4_atomic_load(&g->stop))
+		return;
+
+	entry.depth = level - g->depth;
+	entry.bound = (best > beta) ? C4_TT_LOWER :
+		(best < alpha) ? C4_TT_UPPER : C4_TT_EXACT;
+	entry.column = (column <= 254) ? column : -1;
+
+	/* A goodness too large for the table still leaves its move there. */
+	if (!to_table(g, best, &entry.score)) {
+		entry.score = 0;
+		entry.depth = 0;
+	}
+
+	c4_tt_store(g->table, table_key(g, player), &entry);
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns the "score" of the specified player.  This      **/
-/**  score is a function of how many winning positions are still available **/
-/**  to the player and how close he/she is to achieving each of these      **/
-/**  positions.  The scores of both players can be compared to observe how **/
-/**  well they are doing relative to each other.                           **/
+/**  These functions turn a goodness into a score for a transposition      **/
+/**  table, and back.  A win (or loss) is kept as the number of moves from **/
+/**  the current state to it, rather than from the start of the search,    **/
+/**  so that it holds wherever the state turns up.  Other goodnesses are   **/
+/**  kept as they are; to_table() returns false if they do not fit within  **/
+/**  TABLE_LIMIT.                                                          **/
 /**                                                                        **/
 /****************************************************************************/
 
-int
-c4_score_of_player(int player)
+static bool
+to_table(C4_game *g, int goodness, int *score)
+{
+	int moves;
+
+	if (goodness > C4_MAX_LEAF_SCORE || goodness < -C4_MAX_LEAF_SCORE) {
+		moves = INT_MAX - abs(goodness) - g->depth;
+		if (moves < 0 || moves > C4_MAX_LEVEL)
+			return false;
+		*score = (goodness > 0) ? TABLE_WIN - moves : -(TABLE_WIN - moves);
+		return true;
+	}
+
+	if (goodness > TABLE_LIMIT || goodness < -TABLE_LIMIT)
+		return false;
+	*score = goodness;
+	return true;
+}
+
+static int
+from_table(C4_game *g, int score)
 {
-	assert(game_in_progress);
-	return current_state->score[real_player(player)];
+	if (score > TABLE_LIMIT)
+		return INT_MAX - (TABLE_WIN - score) - g->depth;
+	else if (score < -TABLE_LIMIT)
+		return -(INT_MAX - (TABLE_WIN + score) - g->depth);
+	return score;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns true if the specified player has won the game,  **/
-/**  and false otherwise.                                                  **/
+/**  This function returns the key of the board of the current state, the  **/
+/**  keys of its pieces XORed together, by which the transposition tables  **/
+/**  know it.  The search keeps it up to date in g->hash as it drops       **/
+/**  pieces and takes them back.                                           **/
 /**                                                                        **/
 /****************************************************************************/
 
-bool
-c4_is_winner(int player)
+static uint64_t
+board_key(C4_game *g)
 {
-	assert(game_in_progress);
-	return (current_state->winner == real_player(player));
+	Geometry *geo = g->geo;
+	char **board = g->current_state->board;
+	uint64_t key = 0;
+	int x, y;
+
+	for (x = 0; x<geo->size_x; x++)
+		for (y = 0; y<geo->size_y && board[x][y] != C4_NONE; y++)
+			key ^= geo->keys[2 * (x * geo->size_y + y) + board[x][y]];
+	return key;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns true if the board is completely full without a  **/
-/**  winner, and false otherwise.                                          **/
+/**  The following functions search the standard 7x6 board, with 4 in a    **/
+/**  row to win, in place.  Nearly every game is played on it, and with    **/
+/**  the shape known when it is compiled the loops over the columns and    **/
+/**  the rows can be unrolled and the win places through each cell become  **/
+/**  constants.  They give the same results as evaluate() with             **/
+/**  g->in_place set, and new_geometry() checks in debugging builds that   **/
+/**  their tables agree with the geometry.                                 **/
 /**                                                                        **/
 /****************************************************************************/
 
-bool
-c4_is_tie(void)
-{
-	assert(game_in_progress);
-	return (current_state->num_of_pieces == total_size &&
-		current_state->winner == C4_NONE);
-}
+/* The win places through each cell of the standard board, as laid out  */
+/* by new_geometry(): STD_CELL(c, ...) lists those through cell c, which */
+/* is column c / STD_Y, row c % STD_Y, with STD_W(w) for win place w.    */
+
+#define STD_CELLS \
+	STD_CELL( 0, STD_W( 0) STD_W(24) STD_W(45)) \
+	STD_CELL( 1, STD_W( 4) STD_W(24) STD_W(25) STD_W(49)) \
+	STD_CELL( 2, STD_W( 8) STD_W(24) STD_W(25) STD_W(26) STD_W(53)) \
+	STD_CELL( 3, STD_W(12) STD_W(24) STD_W(25) STD_W(26) STD_W(60)) \
+	STD_CELL( 4, STD_W(16) STD_W(25) STD_W(26) STD_W(64)) \
+	STD_CELL( 5, STD_W(20) STD_W(26) STD_W(68)) \
+	STD_CELL( 6, STD_W( 0) STD_W( 1) STD_W(27) STD_W(46)) \
+	STD_CELL( 7, STD_W( 4) STD_W( 5) STD_W(27) STD_W(28) STD_W(45) \
+		STD_W(50)) \
+	STD_CELL( 8, STD_W( 8) STD_W( 9) STD_W(27) STD_W(28) STD_W(29) \
+		STD_W(49) STD_W(54) STD_W(60)) \
+	STD_CELL( 9, STD_W(12) STD_W(13) STD_W(27) STD_W(28) STD_W(29) \
+		STD_W(53) STD_W(59) STD_W(64)) \
+	STD_CELL(10, STD_W(16) STD_W(17) STD_W(28) STD_W(29) STD_W(63) \
+		STD_W(68)) \
+	STD_CELL(11, STD_W(20) STD_W(21) STD_W(29) STD_W(67)) \
+	STD_CELL(12, STD_W( 0) STD_W( 1) STD_W( 2) STD_W(30) STD_W(47)) \
+	STD_CELL(13, STD_W( 4) STD_W( 5) STD_W( 6) STD_W(30) STD_W(31) \
+		STD_W(46) STD_W(51) STD_W(60)) \
+	STD_CELL(14, STD_W( 8) STD_W( 9) STD_W(10) STD_W(30) STD_W(31) \
+		STD_W(32) STD_W(45) STD_W(50) STD_W(55) STD_W(59) STD_W(64)) \
+	STD_CELL(15, STD_W(12) STD_W(13) STD_W(14) STD_W(30) STD_W(31) \
+		STD_W(32) STD_W(49) STD_W(54) STD_W(58) STD_W(63) STD_W(68)) \
+	STD_CELL(16, STD_W(16) STD_W(17) STD_W(18) STD_W(31) STD_W(32) \
+		STD_W(53) STD_W(62) STD_W(67)) \
+	STD_CELL(17, STD_W(20) STD_W(21) STD_W(22) STD_W(32) STD_W(66)) \
+	STD_CELL(18, STD_W( 0) STD_W( 1) STD_W( 2) STD_W( 3) STD_W(33) \
+		STD_W(48) STD_W(60)) \
+	STD_CELL(19, STD_W( 4) STD_W( 5) STD_W( 6) STD_W( 7) STD_W(33) \
+		STD_W(34) STD_W(47) STD_W(52) STD_W(59) STD_W(64)) \
+	STD_CELL(20, STD_W( 8) STD_W( 9) STD_W(10) STD_W(11) STD_W(33) \
+		STD_W(34) STD_W(35) STD_W(46) STD_W(51) STD_W(56) STD_W(58) \
+		STD_W(63) STD_W(68)) \
+	STD_CELL(21, STD_W(12) STD_W(13) STD_W(14) STD_W(15) STD_W(33) \
+		STD_W(34) STD_W(35) STD_W(45) STD_W(50) STD_W(55) STD_W(57) \
+		STD_W(62) STD_W(67)) \
+	STD_CELL(22, STD_W(16) STD_W(17) STD_W(18) STD_W(19) STD_W(34) \
+		STD_W(35) STD_W(49) STD_W(54) STD_W(61) STD_W(66)) \
+	STD_CELL(23, STD_W(20) STD_W(21) STD_W(22) STD_W(23) STD_W(35) \
+		STD_W(53) STD_W(65)) \
+	STD_CELL(24, STD_W( 1) STD_W( 2) STD_W( 3) STD_W(36) STD_W(59)) \
+	STD_CELL(25, STD_W( 5) STD_W( 6) STD_W( 7) STD_W(36) STD_W(37) \
+		STD_W(48) STD_W(58) STD_W(63)) \
+	STD_CELL(26, STD_W( 9) STD_W(10) STD_W(11) STD_W(36) STD_W(37) \
+		STD_W(38) STD_W(47) STD_W(52) STD_W(57) STD_W(62) STD_W(67)) \
+	STD_CELL(27, STD_W(13) STD_W(14) STD_W(15) STD_W(36) STD_W(37) \
+		STD_W(38) STD_W(46) STD_W(51) STD_W(56) STD_W(61) STD_W(66)) \
+	STD_CELL(28, STD_W(17) STD_W(18) STD_W(19) STD_W(37) STD_W(38) \
+		STD_W(50) STD_W(55) STD_W(65)) \
+	STD_CELL(29, STD_W(21) STD_W(22) STD_W(23) STD_W(38) STD_W(54)) \
+	STD_CELL(30, STD_W( 2) STD_W( 3) STD_W(39) STD_W(58)) \
+	STD_CELL(31, STD_W( 6) STD_W( 7) STD_W(39) STD_W(40) STD_W(57) \
+		STD_W(62)) \
+	STD_CELL(32, STD_W(10) STD_W(11) STD_W(39) STD_W(40) STD_W(41) \
+		STD_W(48) STD_W(61) STD_W(66)) \
+	STD_CELL(33, STD_W(14) STD_W(15) STD_W(39) STD_W(40) STD_W(41) \
+		STD_W(47) STD_W(52) STD_W(65)) \
+	STD_CELL(34, STD_W(18) STD_W(19) STD_W(40) STD_W(41) STD_W(51) \
+		STD_W(56)) \
+	STD_CELL(35, STD_W(22) STD_W(23) STD_W(41) STD_W(55)) \
+	STD_CELL(36, STD_W( 3) STD_W(42) STD_W(57)) \
+	STD_CELL(37, STD_W( 7) STD_W(42) STD_W(43) STD_W(61)) \
+	STD_CELL(38, STD_W(11) STD_W(42) STD_W(43) STD_W(44) STD_W(65)) \
+	STD_CELL(39, STD_W(15) STD_W(42) STD_W(43) STD_W(44) STD_W(48)) \
+	STD_CELL(40, STD_W(19) STD_W(43) STD_W(44) STD_W(52)) \
+	STD_CELL(41, STD_W(23) STD_W(44) STD_W(56))
+
+/* The number of win places on the standard board, and the order in */
+/* which new_geometry() has its columns tried.                       */
+
+#define STD_WIN_PLACES  69
+
+static const int std_drop_order[STD_X] = { 3, 4, 2, 5, 1, 6, 0 };
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns the coordinates of the winning connections of   **/
-/**  the winning player.  It is assumed that a player has indeed won the   **/
-/**  game.  The coordinates are returned in x1, y1, x2, y2, where (x1, y1) **/
-/**  specifies the lower-left piece of the winning connection, and         **/
-/**  (x2, y2) specifies the upper-right piece of the winning connection.   **/
-/**  If more than one winning connection exists, only one will be          **/
-/**  returned.                                                             **/
+/**  This function is evaluate() for the standard board, with the moves    **/
+/**  made in place.  Only the leaves scored by the heuristic skip the call **/
+/**  to g->leaf_eval.                                                      **/
 /**                                                                        **/
 /****************************************************************************/
 
-void
-c4_win_coords(int *x1, int *y1, int *x2, int *y2)
+static int
+std_evaluate(C4_game *g, int player, int level, int alpha, int beta)
 {
-	register int i, j, k;
-	int winner, win_pos = 0;
-	bool found;
-
-	assert(game_in_progress);
+	Game_state *current_state = g->current_state;
+	unsigned char *score_array = current_state->score_array;
+	unsigned char *saved;
+	C4_table *table = g->table;
+	const uint64_t *keys = g->geo->keys;
+	const int *order = std_drop_order;
+	int opponent = other(player), best = -(INT_MAX), maxab = alpha;
+	int i, column, row, goodness, score[2], differences[2];
+	int first = -1, best_column = -1, first_order[STD_X];
+	char *cells;
+
+	if (g->poll_function != NULL && g->next_poll <= clock()) {
+		g->next_poll += g->poll_interval;
+		(*g->poll_function)();
+	}
 
-	winner = current_state->winner;
-	assert(winner != C4_NONE);
+	if (c4_atomic_load(&g->stop))
+		return 0;
 
-	while (current_state->score_array[winner][win_pos] != magic_win_number)
-		win_pos++;
+	g->nodes++;
 
-	/* Find the lower-left piece of the winning connection. */
+	if (current_state->winner == player)
+		return INT_MAX - g->depth;
+	else if (current_state->winner == opponent)
+		return -(INT_MAX - g->depth);
+	else if (current_state->num_of_pieces == STD_X * STD_Y)
+		return 0; /* a tie */
+	else if (level == g->depth)
+		return (g->leaf_eval == heuristic_leaf) ? goodness_of(g, player) :
+			(*g->leaf_eval)(g, player, g->leaf_data);
+
+	/* The transposition table may know enough about the state already; */
+	/* if not, the best move it has for it is tried first.              */
+
+	if (table != NULL) {
+		if (probe_table(g, player, level, alpha, beta, &best, &first))
+			return -best;
+		if (first >= 0) {
+			first_order[0] = first;
+			for (i = 0, column = 1; i<STD_X; i++)
+				if (std_drop_order[i] != first)
+					first_order[column++] = std_drop_order[i];
+			order = first_order;
+		}
+	}
 
-	found = false;
-	for (j = 0; j<size_y && !found; j++)
-		for (i = 0; i<size_x && !found; i++)
-			for (k = 0; map[i][j][k] != -1; k++)
-				if (map[i][j][k] == win_pos) {
-					*x1 = i;
-					*y1 = j;
-					found = true;
-					break;
-				}
+	/* Assume it is the other player's turn.  There is no winner yet, */
+	/* so that is all there is to put back after each drop.           */
+
+	assert(g->depth < C4_MAX_LEVEL);
+	saved = g->saved_counts + 2 * STD_PLACES * g->depth;
+	score[0] = current_state->score[0];
+	score[1] = current_state->score[1];
+
+	for (i = 0; i<STD_X; i++) {
+		column = order[i];
+		cells = current_state->board[column];
+		if (cells[STD_Y - 1] != C4_NONE)
+			continue; /* The column is full. */
+		for (row = 0; cells[row] != C4_NONE; row++)
+			;
+
+		cells[row] = opponent;
+		if (table != NULL) {
+			g->hash ^= keys[2 * (column * STD_Y + row) + opponent];
+			if (g->depth + 1 < level)
+				c4_tt_prefetch(table, table_key(g, opponent));
+		}
+		current_state->num_of_pieces++;
+		if (std_drop_counts(score_array, column * STD_Y + row, opponent,
+			saved, differences))
+			current_state->winner = opponent;
+		current_state->score[opponent] += differences[0];
+		current_state->score[player] -= differences[1];
+
+		g->depth++;
+		goodness = std_evaluate(g, opponent, level, -beta, -maxab);
+		g->depth--;
+
+		std_undo_counts(score_array, column * STD_Y + row, saved);
+		cells[row] = C4_NONE;
+		if (table != NULL)
+			g->hash ^= keys[2 * (column * STD_Y + row) + opponent];
+		current_state->num_of_pieces--;
+		current_state->score[0] = score[0];
+		current_state->score[1] = score[1];
+		current_state->winner = C4_NONE;
+
+		if (goodness > best) {
+			best = goodness;
+			best_column = column;
+			if (best > maxab)
+				maxab = best;
+		}
+		if (best > beta)
+			break;
+	}
 
-	/* Find the upper-right piece of the winning connection. */
+	if (table != NULL)
+		store_table(g, player, level, alpha, beta, best, best_column);
 
-	found = false;
-	for (j = size_y - 1; j >= 0 && !found; j--)
-		for (i = size_x - 1; i >= 0 && !found; i--)
-			for (k = 0; map[i][j][k] != -1; k++)
-				if (map[i][j][k] == win_pos) {
-					*x2 = i;
-					*y2 = j;
-					found = true;
-					break;
-				}
+	/* What's good for the other player is bad for this one. */
+	return -best;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function ends the current game.  It is assumed that a game is    **/
-/**  in progress.  It is illegal to call any other game function           **/
-/**  immediately after this one except for c4_new_game(), c4_poll() and    **/
-/**  c4_reset().                                                           **/
+/**  This function is update_score()'s kernel for the standard board, with **/
+/**  a straight run of code for each cell.  It saves the counts of the win **/
+/**  places through cell in saved before changing them, and otherwise      **/
+/**  works as c4_update_counts_scalar() does.                              **/
 /**                                                                        **/
 /****************************************************************************/
 
-void
-c4_end_game(void)
+static bool
+std_drop_counts(unsigned char *score_array, int cell, int player,
+	unsigned char *saved, int differences[2])
 {
-	int i, j;
-
-	assert(game_in_progress);
-	assert(!move_in_progress);
-
-	/* Free up the memory used by the map. */
-
-	for (i = 0; i<size_x; i++) {
-		for (j = 0; j<size_y; j++)
-			free(map[i][j]);
-		free(map[i]);
-	}
-	free(map);
-
-	/* Free up the memory of all the states used. */
-
-	for (i = 0; i<states_allocated; i++) {
-		for (j = 0; j<size_x; j++)
-			free(state_stack[i].board[j]);
-		free(state_stack[i].board);
-		free(state_stack[i].score_array[0]);
-		free(state_stack[i].score_array[1]);
+	int this_count, other_player = other(player);
+	int this_difference = 0, other_difference = 0;
+	unsigned char *counts;
+	bool won = false;
+
+#define STD_W(w) \
+	counts = &score_array[2 * (w)]; \
+	saved[0] = counts[0]; \
+	saved[1] = counts[1]; \
+	saved += 2; \
+	this_count = counts[player]; \
+	this_difference += window_value(this_count); \
+	other_difference += window_value(counts[other_player]); \
+	this_count += (this_count != 0); \
+	counts[player] = this_count; \
+	counts[other_player] = 0; \
+	won |= (this_count == STD_N + 1);
+#define STD_CELL(c, windows) \
+	case c: windows break;
+
+	switch (cell) {
+	STD_CELLS
 	}
-	states_allocated = 0;
-
-	/* Free up the memory used by the drop_order array. */
 
-	free(drop_order);
+#undef STD_W
+#undef STD_CELL
 
-	game_in_progress = false;
+	differences[0] = this_difference;
+	differences[1] = other_difference;
+	return won;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function resets the state of the algorithm to the starting state **/
-/**  (i.e., no game in progress and a NULL poll function).  There should   **/
-/**  no reason to call this function unless for some reason the calling    **/
-/**  algorithm loses track of the game state.  It is illegal to call any   **/
-/**  other game function immediately after this one except for             **/
-/**  c4_new_game(), c4_poll() and c4_reset().                              **/
+/**  This function puts back the counts std_drop_counts() saved for cell.  **/
 /**                                                                        **/
 /****************************************************************************/
 
-void
-c4_reset(void)
+static void
+std_undo_counts(unsigned char *score_array, int cell,
+	const unsigned char *saved)
 {
-	assert(!move_in_progress);
-	if (game_in_progress)
-		c4_end_game();
-	poll_function = NULL;
+#define STD_W(w) \
+	score_array[2 * (w)] = saved[0]; \
+	score_array[2 * (w) + 1] = saved[1]; \
+	saved += 2;
+#define STD_CELL(c, windows) \
+	case c: windows break;
+
+	switch (cell) {
+	STD_CELLS
+	}
+
+#undef STD_W
+#undef STD_CELL
 }
 
+
+#ifndef NDEBUG
+
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns the RCS string representing the version of      **/
-/**  this Connect-4 implementation.                                        **/
+/**  This function returns whether the tables of the standard board above  **/
+/**  are those new_geometry() built in geo.                                **/
 /**                                                                        **/
 /****************************************************************************/
 
-const char *
-c4_get_version(void)
+static bool
+std_geometry_matches(const Geometry *geo)
 {
-	return "$Id: c4.c,v 3.11 2009/11/03 14:42:01 pomakis Exp pomakis $";
+	int i, k, end;
+
+	if (geo->win_places != STD_WIN_PLACES || geo->max_places != STD_PLACES)
+		return false;
+	for (i = 0; i<STD_X; i++)
+		if (geo->drop_order[i] != std_drop_order[i])
+			return false;
+
+#define STD_W(w) \
+	if (k == end || geo->map[k++] != (w)) \
+		return false;
+#define STD_CELL(c, windows) \
+	k = geo->map_start[c]; \
+	end = geo->map_start[(c) + 1]; \
+	windows \
+	if (k != end) \
+		return false;
+
+	STD_CELLS
+
+#undef STD_W
+#undef STD_CELL
+
+	return true;
 }
 
+#endif /* NDEBUG */
+
 
-/****************************************************************************/
 /****************************************************************************/
 /**                                                                        **/
-/**  The following functions are local to this file and should not be      **/
-/**  called externally.                                                    **/
+/**  These functions are the built-in leaf evaluations (see                **/
+/**  C4_move_params).  Each scores the current state for the specified     **/
+/**  player.  heuristic_leaf() is the original goodness of the state;      **/
+/**  rule_leaf() is the score of the rules of apply_rule() for the player  **/
+/**  less that for the opponent; blend_leaf() adds rule_weight 256ths of   **/
+/**  the latter to the former; network_leaf() is the score given by the    **/
+/**  network (see "c4net.c") passed as user_data.                          **/
 /**                                                                        **/
 /****************************************************************************/
-/****************************************************************************/
+
+static int
+heuristic_leaf(C4_game *g, int player, void *user_data)
+{
+	(void)user_data;
+	return goodness_of(g, player);
+}
+
+static int
+rule_leaf(C4_game *g, int player, void *user_data)
+{
+	(void)user_data;
+	return clamp_leaf((long long)rule_total(g, player) -
+		rule_total(g, other(player)));
+}
+
+static int
+blend_leaf(C4_game *g, int player, void *user_data)
+{
+	long long rules;
+
+	(void)user_data;
+	rules = (long long)rule_total(g, player) - rule_total(g, other(player));
+	return clamp_leaf(goodness_of(g, player) + rules * g->rule_weight / 256);
+}
+
+static int
+network_leaf(C4_game *g, int player, void *user_data)
+{
+	return clamp_leaf(c4_network_eval((const C4_network *)user_data,
+		g->current_state->board, player));
+}
+
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function returns the number of possible win positions on a board **/
-/**  of dimensions x by y with n being the number of pieces required in a  **/
-/**  row in order to win.                                                  **/
+/**  This function brings a leaf score within C4_MAX_LEAF_SCORE of 0, so   **/
+/**  that it can never be mistaken for a win or a loss.                    **/
 /**                                                                        **/
 /****************************************************************************/
 
 static int
-num_of_win_places(int x, int y, int n)
+clamp_leaf(long long score)
 {
-	if (x < n && y < n)
-		return 0;
-	else if (x < n)
-		return x * ((y - n) + 1);
-	else if (y < n)
-		return y * ((x - n) + 1);
+	if (score > C4_MAX_LEAF_SCORE)
+		return C4_MAX_LEAF_SCORE;
+	else if (score < -C4_MAX_LEAF_SCORE)
+		return -C4_MAX_LEAF_SCORE;
 	else
-		return 4 * x*y - 3 * x*n - 3 * y*n + 3 * x + 3 * y - 4 * n + 2 * n*n + 2;
+		return (int)score;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function updates the score of the specified player in the        **/
-/**  context of the current state,  given that the player has just placed  **/
-/**  a game piece in column x, row y.                                      **/
+/**  This function chooses and makes a move for params->player, and fills  **/
+/**  in result.  It is the body of both c4_game_auto_move() and the        **/
+/**  asynchronous moves; the caller takes care of move_in_progress.  If    **/
+/**  the search is stopped part way through, no piece is dropped and false **/
+/**  is returned.                                                          **/
 /**                                                                        **/
 /****************************************************************************/
 
-static void
-update_score(int player, int x, int y)
+static bool
+auto_move(C4_game *g, const C4_move_params *params, C4_move_result *result)
 {
-	register int i;
-	int win_index;
-	int this_difference = 0, other_difference = 0;
-	int **current_score_array = current_state->score_array;
-	int other_player = other(player);
+	int best_column = -1, goodness = 0, best_worst = -(INT_MAX);
+	int num_of_equal = 0, real_player, current_column, row;
+	bool book_move = false, rules_valid[2], track_rules;
+	Geometry *geo = g->geo;
+	Undo undo;
+	double start = c4_wall_time();
+
+	real_player = real_player(params->player);
+	result->moved = false;
+	g->nodes = 0;
+
+	g->leaf_eval = (params->eval == C4_EVAL_CUSTOM) ?
+		params->eval_function : leaf_evals[params->eval];
+	g->leaf_data = (params->eval == C4_EVAL_NETWORK) ?
+		(void *)params->network : params->eval_data;
+	g->rule_weight = (params->rule_weight != 0) ?
+		params->rule_weight : C4_DEFAULT_RULE_WEIGHT;
+
+	g->table = params->table;
+	g->table_probes = g->table_hits = 0;
+	if (g->table != NULL)
+		g->hash = board_key(g);
+
+	/* It has been proven that the best first move for a standard 7x6 game  */
+	/* of connect-4 is the center column.  See Victor Allis' masters thesis */
+	/* ("ftp://ftp.cs.vu.nl/pub/victor/connect4.ps") for this proof.        */
 
-	for (i = 0; map[x][y][i] != -1; i++) {
-		win_index = map[x][y][i];
-		this_difference += current_score_array[player][win_index];
-		other_difference += current_score_array[other_player][win_index];
+	if (g->current_state->num_of_pieces < 1 &&
+		geo->size_x == 7 && geo->size_y == 6 && geo->num_to_connect == 4 &&
+		(g->current_state->num_of_pieces == 0 ||
+			g->current_state->board[3][0] != C4_NONE)) {
+		best_column = 2;
+		book_move = true;
+	}
+
+	else if (g->current_state->num_of_pieces == 1) {
+		best_column = 3;
+		book_move = true;
+	}
+
+	else {
+		/* The scores of the rules are only kept up to date while the     */
+		/* search runs if its leaves use them, and c4_rule_update() is    */
+		/* cheaper than working them out afresh at each leaf.             */
+
+		memcpy(rules_valid, g->current_state->rules_valid,
+			sizeof(rules_valid));
+		track_rules = (params->eval == C4_EVAL_RULES ||
+			params->eval == C4_EVAL_BLEND) &&
+			c4_rule_incremental(geo->rules);
+		if (track_rules) {
+			rule_total(g, 0);
+			rule_total(g, 1);
+		}
+		else
+			g->current_state->rules_valid[0] =
+				g->current_state->rules_valid[1] = false;
+
+		/* The search makes its moves in place unless its leaves use the */
+		/* rules, whose scores rule_total() keeps in the current state.  */
+
+		g->in_place = (params->eval != C4_EVAL_RULES &&
+			params->eval != C4_EVAL_BLEND);
+
+		/* If a drop wins the game, take it!  The whole board is looked */
+		/* over at once on the bitboards.                               */
+
+		c4_bits_load(geo->bits, g->bits, g->current_state->board);
+		best_column = c4_bits_winning_drop(geo->bits, g->bits, real_player,
+			geo->drop_order);
+		if (best_column >= 0)
+			best_worst = INT_MAX;
+
+		/* Otherwise, simulate a drop in each column and see what the */
+		/* results are.                                               */
+
+		for (int i = 0; i<geo->size_x && best_worst < INT_MAX; i++) {
+			current_column = geo->drop_order[i];
+
+			row = search_drop(g, real_player, current_column, &undo);
+
+			/* If this column is full, ignore it as a possibility. */
+			if (row < 0)
+				continue;
+
+			/* If the opponent could then win at once, there is no need to */
+			/* search.  That reply scores INT_MAX - 2, the most any reply  */
+			/* can, so the search would give -(INT_MAX - 2), or something  */
+			/* below best_worst if it cut off before reaching the reply;   */
+			/* either way the move is judged as if it had been searched.   */
+			c4_bits_set(geo->bits, g->bits, real_player, current_column, row);
+			if (params->level > 1 && c4_bits_winning_drop(geo->bits, g->bits,
+				other(real_player), geo->drop_order) >= 0)
+				goodness = -(INT_MAX - 2);
+
+			/* Otherwise, look ahead to see how good this move may turn out */
+			/* to be (assuming the opponent makes the best moves possible). */
+			else {
+				g->next_poll = clock() + g->poll_interval;
+				goodness = (*(g->in_place ? g->in_place_search : evaluate))(g,
+					real_player, params->level, -(INT_MAX), -best_worst);
+			}
+
+			c4_bits_clear(geo->bits, g->bits, real_player, current_column, row);
+			search_undo(g, current_column, row, &undo);
+
+			if (c4_atomic_load(&g->stop)) {
+				g->in_place = false;
+				if (!track_rules)
+					memcpy(g->current_state->rules_valid, rules_valid,
+						sizeof(rules_valid));
+				return false;
+			}
+
+			/* If this move looks better than the ones previously considered, */
+			/* remember it.                                                   */
+			if (goodness > best_worst) {
+				best_worst = goodness;
+				best_column = current_column;
+				num_of_equal = 1;
+			}
 
-		current_score_array[player][win_index] <<= 1;
-		current_score_array[other_player][win_index] = 0;
+			/* If two moves are equally as good, make a random decision. */
+			else if (goodness == best_worst) {
+				num_of_equal++;
+				if ((next_random(g) >> 4) % num_of_equal == 0)
+					best_column = current_column;
+			}
+		}
 
-		if (current_score_array[player][win_index] == magic_win_number)
-			if (current_state->winner == C4_NONE)
-				current_state->winner = player;
+		g->in_place = false;
+		if (!track_rules)
+			memcpy(g->current_state->rules_valid, rules_valid,
+				sizeof(rules_valid));
 	}
 
-	current_state->score[player] += this_difference;
-	current_state->score[other_player] -= other_difference;
+	/* Drop the piece in the column decided upon. */
+
+	if (best_column < 0)
+		return false;
+
+	row = play_move(g, real_player, best_column);
+
+	result->moved = true;
+	result->column = best_column;
+	result->row = row;
+	result->score = book_move ? goodness_of(g, real_player) : best_worst;
+	result->num_rules_fired = 0;
+	result->stats.nodes = g->nodes;
+	result->stats.seconds = c4_wall_time() - start;
+	result->stats.table_probes = g->table_probes;
+	result->stats.table_hits = g->table_hits;
+	if (g->log != NULL)
+		c4_log_move(g->log, g->log_tag, g->current_state->num_of_pieces,
+			params->player, result);
+	return true;
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function drops a piece of the specified player into the          **/
-/**  specified column.  The row where the piece ended up is returned, or   **/
-/**  -1 if the drop was unsuccessful (i.e., the specified column is full). **/
+/**  This function returns a pseudo-random number between 0 and 32767,     **/
+/**  like rand() but from a sequence private to the game, so that games    **/
+/**  searched on different threads do not share any state.                 **/
 /**                                                                        **/
 /****************************************************************************/
 
 static int
-drop_piece(int player, int column)
+next_random(C4_game *g)
 {
-	int y = 0;
-
-	while (current_state->board[column][y] != C4_NONE && ++y < size_y)
-		;
-
-	if (y == size_y)
-		return -1;
-
-	current_state->board[column][y] = player;
-	current_state->num_of_pieces++;
-	update_score(player, column, y);
-
-	return y;
+	g->random_state = g->random_state * 1103515245 + 12345;
+	return (int)((g->random_state >> 16) & 0x7fff);
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This function pushes the current state onto a stack.  pop_state()     **/
-/**  is used to pop from this stack.                                       **/
-/**                                                                        **/
-/**  Technically what it does, since the current state is considered to    **/
-/**  be the top of the stack, is push a copy of the current state onto     **/
-/**  the stack right above it.  The stack pointer (depth) is then          **/
-/**  incremented so that the new copy is considered to be the current      **/
-/**  state.  That way, all pop_state() has to do is decrement the stack    **/
-/**  pointer.                                                              **/
-/**                                                                        **/
-/**  For efficiency, memory for each stack state used is only allocated    **/
-/**  once per game, and reused for the remainder of the game.              **/
+/**  This function drops one reference to an asynchronous move, freeing    **/
+/**  it when the last reference goes.                                      **/
 /**                                                                        **/
 /****************************************************************************/
 
 static void
-push_state(void)
+release_async(C4_async *handle)
 {
-	register int i, win_places_array_size;
-	Game_state *old_state, *new_state;
-
-	win_places_array_size = win_places * sizeof(int);
-	old_state = &state_stack[depth++];
-	new_state = &state_stack[depth];
-
-	if (depth == states_allocated) {
-
-		/* Allocate space for the board */
-
-		new_state->board = (char **)emalloc(size_x * sizeof(char *));
-		for (i = 0; i<size_x; i++)
-			new_state->board[i] = (char *)emalloc(size_y);
-
-		/* Allocate space for the score array */
-
-		new_state->score_array[0] = (int *)emalloc(win_places_array_size);
-		new_state->score_array[1] = (int *)emalloc(win_places_array_size);
-
-		states_allocated++;
-	}
-
-	/* Copy the board */
+	C4_context *ctx = handle->ctx;
+	int references;
 
-	for (i = 0; i<size_x; i++)
-		memcpy(new_state->board[i], old_state->board[i], size_y);
+	c4_mutex_lock(&ctx->lock);
+	references = --handle->references;
+	c4_mutex_unlock(&ctx->lock);
 
-	/* Copy the score array */
-
-	memcpy(new_state->score_array[0], old_state->score_array[0],
-		win_places_array_size);
-	memcpy(new_state->score_array[1], old_state->score_array[1],
-		win_places_array_size);
-
-	new_state->score[0] = old_state->score[0];
-	new_state->score[1] = old_state->score[1];
-	new_state->winner = old_state->winner;
-	new_state->num_of_pieces = old_state->num_of_pieces;
-
-	current_state = new_state;
+	if (references == 0)
+		free(handle);
 }
 
 
 /****************************************************************************/
 /**                                                                        **/
-/**  This recursive function determines how good the current state may     **/
-/**  turn out to be for the specified player.  It does this by looking     **/
-/**  ahead level moves.  It is assumed that both the specified player and  **/
-/**  the opponent may make the best move possible.  alpha and beta are     **/
-/**  used for alpha-beta cutoff so that the game tree can be pruned to     **/
-/**  avoid searching unneccessary paths.                                   **/
-/**                                                                        **/
-/**  The specified poll function (if any) is called at the appropriate     **/
-/**  intervals.                                                            **/
-/**                                                                        **/
-/**  The worst goodness that the current state can produce in the number   **/
-/**  of moves (levels) searched is returned.  This is the best the         **/
-/**  specified player can hope to achieve with this state (since it is     **/
-/**  assumed that the opponent will make the best moves possible).         **/
+/**  This is the body of each worker thread of a context.  It takes moves  **/
+/**  off the queue and runs them until the context is shut down, at which  **/
+/**  point any moves still queued are cancelled.                           **/
 /**                                                                        **/
 /****************************************************************************/
 
-static int
-evaluate(int player, int level, int alpha, int beta)
+static
+C4_THREAD_PROC(worker_main, arg)
 {
-	if (poll_function != NULL && next_poll <= clock()) {
-		next_poll += poll_interval;
-		(*poll_function)();
-	}
-
-	if (current_state->winner == player)
-		return INT_MAX - depth;
-	else if (current_state->winner == other(player))
-		return -(INT_MAX - depth);
-	else if (current_state->num_of_pieces == total_size)
-		return 0; /* a tie */
-	else if (level == depth)
-		return goodness_of(player);
-	else {
-		/* Assume it is the other player's turn. */
-		int best = -(INT_MAX);
-		int maxab = alpha;
-		for (int i = 0; i<size_x; i++) {
-			if (current_state->board[drop_order[i]][size_y - 1] != C4_NONE)
-				continue; /* The column is full. */
-			push_state();
-			drop_piece(other(player), drop_order[i]);
-			int goodness = evaluate(other(player), level, -beta, -maxab);
-			if (goodness > best) {
-				best = goodness;
-				if (best > maxab)
-					maxab = best;
-			}
-			pop_state();
-			if (best > beta)
-				break;
+	C4_context *ctx = (C4_context *)arg;
+	C4_async *handle;
+	C4_game *g;
+	bool cancelled;
+
+	for (;;) {
+		c4_mutex_lock(&ctx->lock);
+		while (ctx->queue_head == NULL && !ctx->shutting_down)
+			c4_cond_wait(&ctx->work_ready, &ctx->lock);
+		handle = ctx->queue_head;
+		if (handle != NULL) {
+			ctx->queue_head = handle->next;
+			if (ctx->queue_head == NULL)
+				ctx->queue_tail = NULL;
+			if (ctx->shutting_down)
+				handle->cancel_requested = true;
 		}
+		cancelled = (handle != NULL && handle->cancel_requested);
+		c4_mutex_unlock(&ctx->lock);
 
-		/* What's good for the other player is bad for this one. */
-		return -best;
+		if (handle == NULL)
+			break;
+
+		g = handle->game;
+		if (!cancelled && !auto_move(g, &handle->params, &handle->result))
+			handle->result.moved = false;
+		g->move_in_progress = false;
+
+		if (handle->callback != NULL)
+			(*handle->callback)(g, &handle->result, handle->user_data);
+
+		c4_mutex_lock(&ctx->lock);
+		handle->status = (handle->cancel_requested && !handle->result.moved) ?
+			C4_ASYNC_CANCELLED : C4_ASYNC_DONE;
+		c4_cond_broadcast(&ctx->work_done);
+		c4_mutex_unlock(&ctx->lock);
+
+		release_async(handle);
 	}
+
+	C4_THREAD_RETURN;
 }
 
 
@@ -2691,4 +3947,38 @@ emalloc(size_t size)
 		exit(1);
 	}
 	return ptr;
-}
\ No newline at end of file
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  A version of emalloc() which returns memory aligned to a cache line.  **/
+/**  The pointer to the underlying block is kept just below the aligned    **/
+/**  memory, where free_aligned() finds it.                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void *
+emalloc_aligned(size_t size)
+{
+	char *block = (char *)emalloc(size + CACHE_LINE + sizeof(void *));
+	uintptr_t ptr = (uintptr_t)(block + sizeof(void *));
+
+	ptr = (ptr + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+	((void **)ptr)[-1] = block;
+	return (void *)ptr;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees memory allocated by emalloc_aligned().            **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+free_aligned(void *ptr)
+{
+	if (ptr != NULL)
+		free(((void **)ptr)[-1]);
+}
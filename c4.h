@@ -1,17 +1,199 @@
 #ifndef C4_DEFINED
 #define C4_DEFINED
 
+#include <stdio.h>
 #include <time.h>
 #include <stdbool.h>
 
 #define C4_NONE      2
 #define C4_MAX_LEVEL 20
 
+/* The number of rules used by apply_rule(). */
+
+#define C4_NUM_RULES 8
+
+/* Opaque handles.  A C4_context owns the worker threads used for        */
+/* asynchronous moves; a C4_game is one independent game; a C4_async is  */
+/* one pending asynchronous move; a C4_log writes out the moves of any   */
+/* number of games from a thread of its own; a C4_network is a trained   */
+/* evaluation, loaded from a file; a C4_corpus_writer appends games to a */
+/* file of positions, and a C4_corpus reads one back; a                  */
+/* C4_archive_writer and a C4_archive do the same for files of games.    */
+
+typedef struct C4_context        C4_context;
+typedef struct C4_game           C4_game;
+typedef struct C4_async          C4_async;
+typedef struct C4_log            C4_log;
+typedef struct C4_network        C4_network;
+typedef struct C4_corpus_writer  C4_corpus_writer;
+typedef struct C4_corpus         C4_corpus;
+typedef struct C4_archive_writer C4_archive_writer;
+typedef struct C4_archive        C4_archive;
+typedef struct C4_table          C4_table;
+
+/* A function which scores a position at the horizon of the search,    */
+/* for the given player.  It is called with the game in that position,  */
+/* which it may look at (with c4_game_board(), for example) but must    */
+/* not change.  Scores must lie within C4_MAX_LEAF_SCORE of 0.          */
+
+typedef int (*C4_eval_function)(C4_game *game, int player, void *user_data);
+
+#define C4_MAX_LEAF_SCORE 1000000000
+
+/* The ways the search can score the positions at its horizon. */
+
+#define C4_EVAL_HEURISTIC   0   /* The player's score minus the opponent's */
+                                /* (see c4_score_of_player()).             */
+#define C4_EVAL_RULES       1   /* The rules of apply_rule() for the       */
+                                /* player, less those for the opponent.    */
+#define C4_EVAL_BLEND       2   /* The heuristic score plus rule_weight    */
+                                /* 256ths of the rule score.               */
+#define C4_EVAL_CUSTOM      3   /* Whatever eval_function returns.         */
+#define C4_EVAL_NETWORK     4   /* The score given by network.             */
+
+#define C4_DEFAULT_RULE_WEIGHT 1
+
+/* What the computer is asked to do when making a move.  Fields other  */
+/* than player and level may be left 0 for the original behaviour.     */
+
+typedef struct {
+	int player;             /* The player to move (0 or 1).                */
+	int level;              /* Search depth, 1 to C4_MAX_LEVEL.            */
+	int eval;               /* How leaves are scored: a C4_EVAL_ value.    */
+	int rule_weight;        /* For C4_EVAL_BLEND, or 0 for                 */
+							/* C4_DEFAULT_RULE_WEIGHT.                     */
+	C4_eval_function eval_function;
+	void *eval_data;        /* For C4_EVAL_CUSTOM: the function, and the   */
+							/* user_data it is passed.                     */
+	const C4_network *network;
+							/* For C4_EVAL_NETWORK: a network of the size  */
+							/* of the board.                               */
+	C4_table *table;        /* A transposition table for the search to     */
+							/* keep what it finds in, or NULL for none     */
+							/* (see c4_table_new()).                       */
+} C4_move_params;
+
+/* Statistics gathered while searching for a move. */
+
+typedef struct {
+	long nodes;             /* The number of positions evaluated.          */
+	double seconds;         /* Wall-clock time spent on the move.          */
+	long table_probes;      /* Positions looked for in the transposition   */
+	long table_hits;        /* table, and the number found there.          */
+} C4_search_stats;
+
+/* The outcome of a move made by the computer. */
+
+typedef struct {
+	bool moved;             /* false if the board was full or the move     */
+							/* was cancelled; the fields below are then    */
+							/* undefined.                                  */
+	int column;             /* Where the piece ended up.  Column and row   */
+	int row;                /* numbering start at 0.                       */
+	int score;              /* The goodness of the move for the player.    */
+	int rules_fired[C4_NUM_RULES];
+							/* For apply_rule(): the rules (numbered from  */
+	int num_rules_fired;    /* 1) which scored in the move chosen, or just */
+							/* rule 0 for an opening move, and how many    */
+							/* there are.  Searches fire no rules.         */
+	C4_search_stats stats;
+} C4_move_result;
+
+typedef void (*C4_move_callback)(C4_game *game, const C4_move_result *result,
+                                 void *user_data);
+
+/* A profile of the rules of apply_rule(), gathered while a game (or any  */
+/* number of games, one after another) is profiled.  The rules are        */
+/* numbered from 0 here.  Cycles are processor cycles where there is a    */
+/* cycle counter, and nanoseconds otherwise.                              */
+
+typedef struct {
+	long evaluations;       /* The number of boards the rules were         */
+							/* evaluated on.                               */
+	long long setup_cycles; /* Time spent making bitboards.                */
+	long fired[C4_NUM_RULES];
+							/* Evaluations in which each rule scored.      */
+	long long matches[C4_NUM_RULES];
+							/* Anchors matched by the rows of each rule.   */
+	long long cycles[C4_NUM_RULES];
+							/* Time spent on the rows of each rule.        */
+	long moves;             /* Moves chosen by apply_rule().               */
+	long chosen_fired[C4_NUM_RULES];
+							/* How many of them each rule scored in, and   */
+	long long chosen_score[C4_NUM_RULES];
+							/* what it added to their scores.              */
+} C4_rule_stats;
+
+/* A game to be added to a corpus of positions.  The players take turns */
+/* from first_player, dropping their pieces in columns[0] onwards.       */
+
+typedef struct {
+	int first_player;       /* The player who moved first (0 or 1).        */
+	int num_moves;
+	const int *columns;     /* The column of each move, and the score the  */
+	const int *scores;      /* player making it gave it (see               */
+							/* C4_move_result).                            */
+	int first_recorded;     /* The first move to be written out; the       */
+							/* moves before it (random openings, say)      */
+							/* only set up the board.                      */
+	int winner;             /* 0, 1, or C4_NONE for a draw.                */
+} C4_corpus_game;
+
+/* A position read from a corpus. */
+
+typedef struct {
+	int ply;                /* The number of pieces on the board.          */
+	int player;             /* The player to move.                         */
+	int column;             /* The column the player chose, and the score  */
+	int score;              /* the player gave it.                         */
+	int outcome;            /* 1 if the player went on to win the game, -1 */
+							/* if the player lost it, and 0 for a draw.    */
+} C4_corpus_entry;
+
+/* The memory taken up by the engine, by a context or by a game (see */
+/* c4_memory_usage()), in bytes.                                      */
+
+typedef struct {
+	size_t states;          /* The boards and score arrays of the games.   */
+	size_t bitboards;       /* The bitboards of the games.                 */
+	size_t geometry;        /* The tables describing the boards played on, */
+							/* which are shared by all the games on each.  */
+	size_t tables;          /* Transposition tables.                       */
+	size_t other;           /* Games' and contexts' own bookkeeping.       */
+	size_t total;           /* The sum of the above.                       */
+} C4_memory;
+
+/* Flags for c4_table_new(). */
+
+#define C4_TABLE_HUGE_PAGES 1   /* Back the table with huge pages if the   */
+                                /* system will give them.                  */
+
+/* What c4_table_stats() reports about a transposition table. */
+
+typedef struct {
+	size_t bytes;           /* The size of the table.                      */
+	size_t entries;         /* The positions it has room for, and the      */
+	size_t used;            /* number it holds.                            */
+	bool huge_pages;        /* Whether it is backed by huge pages.         */
+	bool shared;            /* Whether it is in shared memory (see         */
+							/* c4_table_open_shared()).                    */
+} C4_table_stats;
+
+/* Values returned by c4_async_status(). */
+
+#define C4_ASYNC_PENDING    0
+#define C4_ASYNC_DONE       1
+#define C4_ASYNC_CANCELLED  2
+
 /* See the file "c4.c" for documentation on the following functions. */
 
 extern void    c4_poll(void (*poll_func)(void), clock_t interval);
-extern void    c4_new_game(int width, int height, int num);
+extern bool    c4_new_game(int width, int height, int num);
 extern bool    c4_make_move(int player, int column, int *row);
+extern bool    c4_undo(int num);
+extern bool    c4_load_moves(const int *columns, int num_moves,
+                             int first_player);
+extern bool    c4_load_position(char **board);
 extern bool    c4_auto_move(int player, int level, int *column, int *row);
 extern char ** c4_board(void);
 extern int     c4_score_of_player(int player);
@@ -20,7 +202,121 @@ extern bool    c4_is_tie(void);
 extern void    c4_win_coords(int *x1, int *y1, int *x2, int *y2);
 extern void    c4_end_game(void);
 extern void    c4_reset(void);
+extern void    c4_restart(void);
+extern C4_game *c4_clone(void);
+extern void    c4_memory_usage(C4_memory *usage);
+extern void    c4_set_memory_limit(size_t bytes);
+extern void    c4_use_table(C4_table *table);
+extern void    c4_profile_rules(C4_rule_stats *stats);
+extern void    c4_log_moves(C4_log *log);
+extern bool    c4_move_report(C4_move_result *result);
+extern void    apply_rule(int player, int *column, int *row);
+
+extern C4_context * c4_context_new(int num_threads);
+extern void         c4_context_free(C4_context *ctx);
+extern void         c4_context_memory_usage(C4_context *ctx,
+                                            C4_memory *usage);
+
+extern C4_game * c4_game_new(C4_context *ctx, int width, int height, int num);
+extern void      c4_game_free(C4_game *game);
+extern void      c4_game_restart(C4_game *game);
+extern C4_game * c4_game_clone(C4_game *game);
+extern void      c4_game_memory_usage(C4_game *game, C4_memory *usage);
+extern void      c4_game_poll(C4_game *game, void (*poll_func)(void),
+                              clock_t interval);
+extern bool      c4_game_make_move(C4_game *game, int player, int column,
+                                   int *row);
+extern bool      c4_game_undo(C4_game *game, int num);
+extern bool      c4_game_load_moves(C4_game *game, const int *columns,
+                                    int num_moves, int first_player);
+extern bool      c4_game_load_position(C4_game *game, char **board);
+extern bool      c4_game_auto_move(C4_game *game, const C4_move_params *params,
+                                   C4_move_result *result);
+extern char **   c4_game_board(C4_game *game);
+extern int       c4_game_score_of_player(C4_game *game, int player);
+extern bool      c4_game_is_winner(C4_game *game, int player);
+extern bool      c4_game_is_tie(C4_game *game);
+extern void      c4_game_win_coords(C4_game *game, int *x1, int *y1,
+                                    int *x2, int *y2);
+extern void      c4_game_profile_rules(C4_game *game, C4_rule_stats *stats);
+extern void      c4_game_log_moves(C4_game *game, C4_log *log, int tag);
+extern bool      c4_game_apply_rule(C4_game *game, int player,
+                                    C4_move_result *result);
+
+extern void c4_rule_stats_clear(C4_rule_stats *stats);
+extern void c4_rule_stats_write_json(const C4_rule_stats *stats, FILE *fp);
+
+extern C4_async * c4_auto_move_async(C4_game *game,
+                                     const C4_move_params *params,
+                                     C4_move_callback callback,
+                                     void *user_data);
+extern int        c4_async_status(C4_async *handle);
+extern bool       c4_async_result(C4_async *handle, C4_move_result *result);
+extern void       c4_async_wait(C4_async *handle);
+extern void       c4_async_cancel(C4_async *handle);
+extern void       c4_async_free(C4_async *handle);
+
+extern C4_table * c4_table_new(size_t bytes, int flags);
+extern C4_table * c4_table_open_shared(const char *name, size_t bytes);
+extern void       c4_table_remove_shared(const char *name);
+extern void       c4_table_free(C4_table *table);
+extern void       c4_table_clear(C4_table *table);
+extern void       c4_table_stats(C4_table *table, C4_table_stats *stats);
 
 extern const char *c4_get_version(void);
 
+/* See the file "c4log.c" for documentation on the following functions. */
+
+extern C4_log * c4_log_new(FILE *fp, int capacity);
+extern void     c4_log_free(C4_log *log);
+extern bool     c4_log_move(C4_log *log, int tag, int move, int player,
+                            const C4_move_result *result);
+extern void     c4_log_flush(C4_log *log);
+extern long     c4_log_dropped(C4_log *log);
+
+/* See the file "c4net.c" for documentation on the following functions. */
+
+extern C4_network * c4_network_load(const char *path);
+extern void         c4_network_free(C4_network *net);
+extern bool         c4_network_fits(const C4_network *net, int width,
+                                    int height);
+extern int          c4_network_eval(const C4_network *net, char **board,
+                                    int player);
+
+/* See the file "c4corpus.c" for documentation on the following functions. */
+
+extern C4_corpus_writer * c4_corpus_writer_new(const char *path, int width,
+                                               int height, int num);
+extern void               c4_corpus_writer_free(C4_corpus_writer *writer);
+extern bool               c4_corpus_write_game(C4_corpus_writer *writer,
+                                               const C4_corpus_game *game);
+
+extern C4_corpus * c4_corpus_open(const char *path);
+extern void        c4_corpus_close(C4_corpus *corpus);
+extern void        c4_corpus_shape(const C4_corpus *corpus, int *width,
+                                   int *height, int *num);
+extern long        c4_corpus_size(const C4_corpus *corpus);
+extern void        c4_corpus_read(const C4_corpus *corpus, long index,
+                                  C4_corpus_entry *entry, char **board);
+
+/* See the file "c4archive.c" for documentation on the following functions. */
+
+extern C4_archive_writer * c4_archive_writer_new(const char *path, int width,
+                                                 int height, int num);
+extern bool                c4_archive_writer_free(C4_archive_writer *writer);
+extern bool                c4_archive_write_game(C4_archive_writer *writer,
+                                                 const int *columns,
+                                                 int num_moves,
+                                                 int first_player,
+                                                 int winner);
+
+extern C4_archive * c4_archive_open(const char *path);
+extern void         c4_archive_close(C4_archive *archive);
+extern void         c4_archive_shape(const C4_archive *archive, int *width,
+                                     int *height, int *num);
+extern long         c4_archive_size(const C4_archive *archive);
+extern int          c4_archive_read(const C4_archive *archive, long index,
+                                    int *first_player, int *winner,
+                                    int *columns);
+
 #endif /* C4_DEFINED */
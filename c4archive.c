@@ -0,0 +1,555 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include "c4.h"
+#include "c4sys.h"
+
+/* This file holds the game archive, a compact file of whole games for   */
+/* keeping and replaying them in bulk.  Where a corpus (see              */
+/* "c4corpus.c") holds every position of a game, an archive holds only   */
+/* its moves, packed into as few bits as the width of the board needs: a */
+/* game of 7x6 connect-4 takes 2 bytes and 3 bits a move.  Games are     */
+/* appended one after another; readers map the file into memory, find    */
+/* the start of each game in one pass over it, and unpack moves straight */
+/* from the mapping.  As with a corpus, a game not yet written in full   */
+/* at the end of the file is not counted, and is written over when more  */
+/* are added.                                                            */
+/*                                                                       */
+/* The file is little-endian throughout:                                 */
+/*                                                                       */
+/*   "C4GA", then version (1), width, height, num and the number of      */
+/*   bits per move, as 32-bit integers;                                  */
+/*   the games.                                                          */
+/*                                                                       */
+/* A game is:                                                            */
+/*                                                                       */
+/*   a byte of flags: bit 0 is the player who moved first, and bits 1    */
+/*   and 2 the winner, 2 meaning that there was none;                    */
+/*   the number of moves, 7 bits to a byte from the low bits up, every   */
+/*   byte but the last having its top bit set;                           */
+/*   the columns of the moves, packed from the low bits of each byte up  */
+/*   and padded to a whole byte.                                         */
+
+#define VERSION      1
+#define HEADER_SIZE  24
+#define MAX_PREFIX   4          /* The most bytes a game can have before   */
+								/* its moves.                              */
+
+struct C4_archive_writer {
+	FILE *fp;
+	int width, height, num;
+	int bits;               /* Bits per move.                              */
+	unsigned char *buffer;  /* Room for the longest game.                  */
+	c4_mutex lock;          /* Held while a game is written, so that games */
+							/* from different threads do not interleave.   */
+};
+
+struct C4_archive {
+	c4_file_view view;
+	const unsigned char *data;
+	uint64_t file_size;
+	int width, height, num;
+	int bits;
+	long size;              /* The number of whole games in the file.      */
+	uint64_t *offsets;      /* Where each game starts.                     */
+};
+
+static bool make_header(unsigned char header[HEADER_SIZE], int width,
+	int height, int num);
+static uint64_t scan(const unsigned char *data, uint64_t size, int bits,
+	int cells, uint64_t **offsets, long *count);
+static int parse_game(const unsigned char *p, uint64_t left, int bits,
+	int cells, int *length);
+static void put_int(unsigned char *p, int32_t value);
+static int32_t get_int(const unsigned char *p);
+static int unpack_move(const unsigned char **p, unsigned int *bits,
+	int *filled, int move_bits);
+#ifndef NDEBUG
+static bool packed_matches(const unsigned char *p, int move_bits,
+	const int *columns, int num_moves);
+#endif
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens an archive for writing, for games on a board of   **/
+/**  the given size.  A new file is created at path if there is none;      **/
+/**  otherwise games are added to the end of the one there, which must be  **/
+/**  an archive for the same size of board.  NULL is returned if the file  **/
+/**  cannot be opened or is not such an archive.  A writer may be shared   **/
+/**  by any number of threads.                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_archive_writer *
+c4_archive_writer_new(const char *path, int width, int height, int num)
+{
+	C4_archive_writer *writer;
+	unsigned char header[HEADER_SIZE];
+	const void *data;
+	uint64_t size, end;
+	c4_file_view view;
+	FILE *fp;
+	bool empty;
+
+	assert(width >= 1 && height >= 1 && num >= 1);
+
+	if (!make_header(header, width, height, num))
+		return NULL;
+
+	/* Append to the file if it is there, after its last whole game. */
+
+	if (c4_file_map(&view, path, &data, &size) == 0) {
+		end = 0;
+		if (size >= HEADER_SIZE && memcmp(data, header, HEADER_SIZE) == 0)
+			end = scan((const unsigned char *)data, size,
+				get_int(header + 20), width * height, NULL, NULL);
+		c4_file_unmap(&view, data, size);
+		if (end == 0 || (fp = fopen(path, "r+b")) == NULL)
+			return NULL;
+		if (fseek(fp, (long)end, SEEK_SET) != 0) {
+			fclose(fp);
+			return NULL;
+		}
+	}
+	else {
+		/* A file which is there but could not be mapped is only */
+		/* written over if it is empty.                           */
+
+		fp = fopen(path, "rb");
+		if (fp != NULL) {
+			empty = (fgetc(fp) == EOF);
+			fclose(fp);
+			if (!empty)
+				return NULL;
+		}
+		fp = fopen(path, "wb");
+		if (fp == NULL)
+			return NULL;
+		if (fwrite(header, 1, HEADER_SIZE, fp) != HEADER_SIZE) {
+			fclose(fp);
+			return NULL;
+		}
+	}
+
+	writer = (C4_archive_writer *)malloc(sizeof(C4_archive_writer));
+	if (writer != NULL)
+		writer->buffer = (unsigned char *)malloc(MAX_PREFIX +
+			((uint64_t)width * height * get_int(header + 20) + 7) / 8);
+	if (writer == NULL || writer->buffer == NULL) {
+		fprintf(stderr, "c4: c4_archive_writer_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+	writer->fp = fp;
+	writer->width = width;
+	writer->height = height;
+	writer->num = num;
+	writer->bits = get_int(header + 20);
+	c4_mutex_init(&writer->lock);
+
+	return writer;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function closes an archive opened for writing, flushing out the  **/
+/**  games written to it.  A value of false is returned if they could not  **/
+/**  all be written.  No game may be being written to it.                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_archive_writer_free(C4_archive_writer *writer)
+{
+	bool ok;
+
+	if (writer == NULL)
+		return true;
+
+	ok = (fclose(writer->fp) == 0);
+	c4_mutex_destroy(&writer->lock);
+	free(writer->buffer);
+	free(writer);
+	return ok;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds a game to an archive: num_moves moves, in the      **/
+/**  given columns, by players taking turns from first_player, which were  **/
+/**  won by winner (0, 1, or C4_NONE if no one).  The moves are not        **/
+/**  checked beyond being on the board.  Games are buffered, and only      **/
+/**  reach the file as the buffer fills or the writer is closed.  A value  **/
+/**  of false is returned if the game could not be written.                **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_archive_write_game(C4_archive_writer *writer, const int *columns,
+	int num_moves, int first_player, int winner)
+{
+	unsigned char *p;
+	unsigned int bits = 0, count;
+	int filled = 0, i;
+	bool ok;
+
+	assert(num_moves >= 0 && num_moves <= writer->width * writer->height);
+	assert(first_player == 0 || first_player == 1);
+	assert(winner == 0 || winner == 1 || winner == C4_NONE);
+
+	c4_mutex_lock(&writer->lock);
+
+	p = writer->buffer;
+	*p++ = (unsigned char)(first_player |
+		((winner == C4_NONE) ? 2 : winner) << 1);
+	for (count = num_moves; count >= 0x80; count >>= 7)
+		*p++ = (unsigned char)(count | 0x80);
+	*p++ = (unsigned char)count;
+
+	for (i = 0; i<num_moves; i++) {
+		assert(columns[i] >= 0 && columns[i] < writer->width);
+		bits |= (unsigned int)columns[i] << filled;
+		for (filled += writer->bits; filled >= 8; filled -= 8) {
+			*p++ = (unsigned char)bits;
+			bits >>= 8;
+		}
+	}
+	if (filled > 0)
+		*p++ = (unsigned char)bits;
+	assert(packed_matches(p - (num_moves * writer->bits + 7) / 8,
+		writer->bits, columns, num_moves));
+
+	ok = fwrite(writer->buffer, 1, p - writer->buffer, writer->fp) ==
+		(size_t)(p - writer->buffer);
+
+	c4_mutex_unlock(&writer->lock);
+	return ok;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens an archive for reading, by mapping it into memory **/
+/**  and finding where each of its games starts.  NULL is returned if the  **/
+/**  file cannot be mapped or is not an archive.  Games added to the file  **/
+/**  after it is opened are not seen; an archive may be read by any        **/
+/**  number of threads at once.                                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_archive *
+c4_archive_open(const char *path)
+{
+	C4_archive *archive;
+	unsigned char header[HEADER_SIZE];
+	const unsigned char *data;
+	const void *mapped;
+	uint64_t size;
+	c4_file_view view;
+
+	if (c4_file_map(&view, path, &mapped, &size) != 0)
+		return NULL;
+
+	data = (const unsigned char *)mapped;
+	if (size < HEADER_SIZE || memcmp(data, "C4GA", 4) != 0 ||
+		get_int(data + 8) < 1 || get_int(data + 12) < 1 ||
+		get_int(data + 16) < 1 ||
+		!make_header(header, get_int(data + 8), get_int(data + 12),
+		get_int(data + 16)) || memcmp(data, header, HEADER_SIZE) != 0) {
+		c4_file_unmap(&view, mapped, size);
+		return NULL;
+	}
+
+	archive = (C4_archive *)malloc(sizeof(C4_archive));
+	if (archive == NULL) {
+		fprintf(stderr, "c4: c4_archive_open() - Can't allocate memory.\n");
+		exit(1);
+	}
+	archive->view = view;
+	archive->data = data;
+	archive->file_size = size;
+	archive->width = get_int(data + 8);
+	archive->height = get_int(data + 12);
+	archive->num = get_int(data + 16);
+	archive->bits = get_int(data + 20);
+	scan(data, size, archive->bits, archive->width * archive->height,
+		&archive->offsets, &archive->size);
+
+	return archive;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function closes an archive opened for reading.                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_archive_close(C4_archive *archive)
+{
+	if (archive == NULL)
+		return;
+
+	c4_file_unmap(&archive->view, archive->data, archive->file_size);
+	free(archive->offsets);
+	free(archive);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the size of board, and the number to connect,   **/
+/**  of the games in an archive.                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_archive_shape(const C4_archive *archive, int *width, int *height, int *num)
+{
+	if (width != NULL)
+		*width = archive->width;
+	if (height != NULL)
+		*height = archive->height;
+	if (num != NULL)
+		*num = archive->num;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of games in an archive.              **/
+/**                                                                        **/
+/****************************************************************************/
+
+long
+c4_archive_size(const C4_archive *archive)
+{
+	return archive->size;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function reads the game numbered index (from 0) out of an        **/
+/**  archive.  Its first player and winner are returned through the        **/
+/**  pointers which are not NULL, and, unless columns is NULL, its moves   **/
+/**  are unpacked into columns, which must have room for them all (a       **/
+/**  board's worth will always do).  The number of moves is returned.      **/
+/**  Games are numbered in the order they were written.                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_archive_read(const C4_archive *archive, long index, int *first_player,
+	int *winner, int *columns)
+{
+	const unsigned char *p;
+	unsigned int bits = 0;
+	int num_moves = 0, filled = 0, shift = 0, i;
+
+	assert(index >= 0 && index < archive->size);
+
+	p = archive->data + archive->offsets[index];
+	if (first_player != NULL)
+		*first_player = p[0] & 1;
+	if (winner != NULL)
+		*winner = ((p[0] >> 1) == 2) ? C4_NONE : (p[0] >> 1);
+	do {
+		num_moves |= (*++p & 0x7f) << shift;
+		shift += 7;
+	} while (*p & 0x80);
+	p++;
+
+	if (columns == NULL)
+		return num_moves;
+
+	for (i = 0; i<num_moves; i++)
+		columns[i] = unpack_move(&p, &bits, &filled, archive->bits);
+
+	return num_moves;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function unpacks the next move, of move_bits bits, from the      **/
+/**  packed columns at *p.  Bits read but not yet used are kept in *bits,  **/
+/**  and their number in *filled; both start at 0.  A move can take up to  **/
+/**  16 bits, so more than one byte may be read for it.                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+unpack_move(const unsigned char **p, unsigned int *bits, int *filled,
+	int move_bits)
+{
+	int column;
+
+	while (*filled < move_bits) {
+		*bits |= (unsigned int)*(*p)++ << *filled;
+		*filled += 8;
+	}
+	column = (int)(*bits & ((1u << move_bits) - 1));
+	*bits >>= move_bits;
+	*filled -= move_bits;
+	return column;
+}
+
+
+#ifndef NDEBUG
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns whether the packed columns at p unpack to the   **/
+/**  num_moves columns given.                                              **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+packed_matches(const unsigned char *p, int move_bits, const int *columns,
+	int num_moves)
+{
+	unsigned int bits = 0;
+	int filled = 0, i;
+
+	for (i = 0; i<num_moves; i++)
+		if (unpack_move(&p, &bits, &filled, move_bits) != columns[i])
+			return false;
+	return true;
+}
+
+#endif /* NDEBUG */
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes the header of an archive for a board of the given **/
+/**  size.  A value of false is returned if it is too big to archive.      **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+make_header(unsigned char header[HEADER_SIZE], int width, int height, int num)
+{
+	int bits = 1;
+
+	if (width > 65535 || height > 65535 / width)
+		return false;
+	while ((1 << bits) < width)
+		bits++;
+
+	memcpy(header, "C4GA", 4);
+	put_int(header + 4, VERSION);
+	put_int(header + 8, width);
+	put_int(header + 12, height);
+	put_int(header + 16, num);
+	put_int(header + 20, bits);
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function walks over the games of an archive held in memory (data **/
+/**  and size take in the header), and returns the offset just past the    **/
+/**  last of them which is whole and sound.  Unless offsets is NULL, an    **/
+/**  array of the offsets of the games is allocated and returned through   **/
+/**  it, and their number through count.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static uint64_t
+scan(const unsigned char *data, uint64_t size, int bits, int cells,
+	uint64_t **offsets, long *count)
+{
+	uint64_t offset = HEADER_SIZE;
+	long allocated = 0, n = 0;
+	int length;
+
+	if (offsets != NULL)
+		*offsets = NULL;
+
+	while (offset < size) {
+		if (parse_game(data + offset, size - offset, bits, cells,
+			&length) != 0)
+			break;
+		if (offsets != NULL) {
+			if (n == allocated) {
+				allocated = (allocated > 0) ? 2 * allocated : 1024;
+				*offsets = (uint64_t *)realloc(*offsets,
+					allocated * sizeof(uint64_t));
+				if (*offsets == NULL) {
+					fprintf(stderr, "c4: c4_archive_open() - Can't allocate memory.\n");
+					exit(1);
+				}
+			}
+			(*offsets)[n] = offset;
+		}
+		n++;
+		offset += length;
+	}
+
+	if (count != NULL)
+		*count = n;
+	return offset;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function checks the game at p, which has left bytes of the file  **/
+/**  after it, and returns its length in bytes through length.  A value    **/
+/**  of 0 is returned if the game is whole and sound, and -1 otherwise.    **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+parse_game(const unsigned char *p, uint64_t left, int bits, int cells,
+	int *length)
+{
+	int num_moves = 0, prefix = 1;
+
+	if (p[0] > 5)
+		return -1;
+	do {
+		if (prefix == MAX_PREFIX || (uint64_t)prefix >= left)
+			return -1;
+		num_moves |= (p[prefix] & 0x7f) << (7 * (prefix - 1));
+	} while (p[prefix++] & 0x80);
+
+	if (num_moves > cells)
+		return -1;
+	*length = prefix + (num_moves * bits + 7) / 8;
+	return ((uint64_t)*length <= left) ? 0 : -1;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions store and fetch a little-endian 32-bit integer.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+put_int(unsigned char *p, int32_t value)
+{
+	int i;
+
+	for (i = 0; i<4; i++)
+		p[i] = (unsigned char)((uint32_t)value >> (8 * i));
+}
+
+
+static int32_t
+get_int(const unsigned char *p)
+{
+	return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+		(uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
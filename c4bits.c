@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "c4.h"
+#include "c4bits.h"
+
+/* This file keeps a board as one bitboard per player, and finds the     */
+/* cells where a player would complete a row by shifting whole           */
+/* bitboards rather than by looking at the cells one at a time.          */
+/*                                                                       */
+/* Column x of the board is held in bits x * stride to x * stride +      */
+/* height - 1 of a bitboard, stride being height + 1, so that each       */
+/* column is followed by a spare bit which is never set.  A step of 1    */
+/* then moves up a column, one of stride across a row, and ones of       */
+/* stride + 1 and stride - 1 along the two diagonals; a line of cells    */
+/* which runs off the board always passes through a spare bit (or off    */
+/* either end of the bitboard) on the way, and so is never taken for a   */
+/* row of pieces.  A bitboard takes as many 64-bit words as the board    */
+/* needs, and any number of pieces may be needed in a row.               */
+
+/* The shape of a board as bitboards. */
+
+struct C4_bits_table {
+	int width, height, num;
+	int stride;             /* Bits per column: height + 1.                */
+	int num_words;          /* 64-bit words in a bitboard.                 */
+	uint64_t *on_board;     /* The cells of the board.                     */
+	uint64_t *bottom;       /* The bottom row.                             */
+};
+
+/* The bitboards of a game.  scratch holds 2 * num + 3 bitboards for     */
+/* c4_bits_winning_drop().                                               */
+
+struct C4_bits {
+	uint64_t *pieces[2];    /* The cells held by each player.              */
+	uint64_t *scratch;
+};
+
+static void shift(uint64_t *dst, const uint64_t *src, int n, int num_words);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function lays out a board of width by height cells as bitboards, **/
+/**  num pieces in a row being needed to win, and returns the table.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_bits_table *
+c4_bits_table_new(int width, int height, int num)
+{
+	C4_bits_table *table;
+	int x, bit;
+
+	assert(width >= 1 && height >= 1 && num >= 1);
+
+	table = (C4_bits_table *)malloc(sizeof(C4_bits_table));
+	if (table != NULL)
+		table->on_board = (uint64_t *)calloc(
+			2 * ((width * (height + 1) + 63) / 64), sizeof(uint64_t));
+	if (table == NULL || table->on_board == NULL) {
+		fprintf(stderr, "c4: c4_bits_table_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	table->width = width;
+	table->height = height;
+	table->num = num;
+	table->stride = height + 1;
+	table->num_words = (width * table->stride + 63) / 64;
+	table->bottom = table->on_board + table->num_words;
+
+	for (bit = 0; bit<width * table->stride; bit++)
+		if (bit % table->stride != height)
+			table->on_board[bit / 64] |= (uint64_t)1 << (bit % 64);
+	for (x = 0; x<width; x++) {
+		bit = x * table->stride;
+		table->bottom[bit / 64] |= (uint64_t)1 << (bit % 64);
+	}
+
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees a table made by c4_bits_table_new().              **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_bits_table_free(C4_bits_table *table)
+{
+	if (table == NULL)
+		return;
+	free(table->on_board);
+	free(table);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes the bitboards of a game on the board of table.    **/
+/**  They start out empty.                                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_bits *
+c4_bits_new(const C4_bits_table *table)
+{
+	C4_bits *bits;
+	size_t words = table->num_words;
+
+	bits = (C4_bits *)malloc(sizeof(C4_bits));
+	if (bits != NULL)
+		bits->pieces[0] = (uint64_t *)calloc((2 * table->num + 5) * words,
+			sizeof(uint64_t));
+	if (bits == NULL || bits->pieces[0] == NULL) {
+		fprintf(stderr, "c4: c4_bits_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	bits->pieces[1] = bits->pieces[0] + words;
+	bits->scratch = bits->pieces[1] + words;
+	return bits;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees bitboards made by c4_bits_new().                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_bits_free(C4_bits *bits)
+{
+	if (bits == NULL)
+		return;
+	free(bits->pieces[0]);
+	free(bits);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions return the number of bytes taken up by the table      **/
+/**  c4_bits_table_new() makes of a width by height board (which can be    **/
+/**  known before it is made), and by the bitboards of a game made by      **/
+/**  c4_bits_new() on the board of table.                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+size_t
+c4_bits_table_size(int width, int height)
+{
+	return sizeof(C4_bits_table) +
+		2 * ((width * (height + 1) + 63) / 64) * sizeof(uint64_t);
+}
+
+size_t
+c4_bits_size(const C4_bits_table *table)
+{
+	return sizeof(C4_bits) +
+		(2 * table->num + 5) * table->num_words * sizeof(uint64_t);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets the bitboards to the pieces on board, which is     **/
+/**  laid out as the boards of "c4.c" are.                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_bits_load(const C4_bits_table *table, C4_bits *bits, char **board)
+{
+	int x, y;
+
+	memset(bits->pieces[0], 0, 2 * table->num_words * sizeof(uint64_t));
+	for (x = 0; x<table->width; x++)
+		for (y = 0; y<table->height && board[x][y] != C4_NONE; y++)
+			c4_bits_set(table, bits, board[x][y], x, y);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions put a piece of player's in column x, row y, and take  **/
+/**  it away again.                                                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_bits_set(const C4_bits_table *table, C4_bits *bits, int player, int x,
+	int y)
+{
+	int bit = x * table->stride + y;
+
+	assert(player == 0 || player == 1);
+	bits->pieces[player][bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+void
+c4_bits_clear(const C4_bits_table *table, C4_bits *bits, int player, int x,
+	int y)
+{
+	int bit = x * table->stride + y;
+
+	assert(player == 0 || player == 1);
+	bits->pieces[player][bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the first column in order (which lists every    **/
+/**  column) where a drop would win the game for player, or -1 if there is **/
+/**  none.                                                                 **/
+/**                                                                        **/
+/**  For each direction, before[i] is the set of cells preceded by i of    **/
+/**  player's pieces in a line, and after[i] the set followed by i of      **/
+/**  them; each is the one before ANDed with player's pieces shifted by i  **/
+/**  steps.  An empty cell in both before[i] and after[num - 1 - i]        **/
+/**  completes a row.  The cells where a piece can be dropped are found    **/
+/**  by adding the bottom row to the occupied cells: the carry runs up     **/
+/**  each column to its lowest empty cell, or into the spare bit if it is  **/
+/**  full.                                                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_bits_winning_drop(const C4_bits_table *table, C4_bits *bits, int player,
+	const int *order)
+{
+	int num = table->num, words = table->num_words;
+	int steps[4] = { 1, table->stride, table->stride + 1, table->stride - 1 };
+	const uint64_t *own = bits->pieces[player];
+	uint64_t *wins = bits->scratch, *open = wins + words;
+	uint64_t *moved = open + words, *before = moved + words;
+	uint64_t *after = before + num * words;
+	uint64_t occupied, sum, carry = 0;
+	int d, i, w, y, bit;
+	bool any = false;
+
+	for (w = 0; w<words; w++) {
+		occupied = bits->pieces[0][w] | bits->pieces[1][w];
+		sum = occupied + table->bottom[w];
+		open[w] = (sum + carry) & table->on_board[w] & ~occupied;
+		carry = (sum < occupied) || (sum + carry < sum);
+		wins[w] = 0;
+		any |= (open[w] != 0);
+	}
+	if (!any)
+		return -1;
+
+	for (d = 0; d<4; d++) {
+		memcpy(before, open, words * sizeof(uint64_t));
+		memcpy(after, open, words * sizeof(uint64_t));
+		for (i = 1; i<num; i++) {
+			shift(moved, own, -i * steps[d], words);
+			for (w = 0; w<words; w++)
+				before[i * words + w] = before[(i - 1) * words + w] & moved[w];
+			shift(moved, own, i * steps[d], words);
+			for (w = 0; w<words; w++)
+				after[i * words + w] = after[(i - 1) * words + w] & moved[w];
+		}
+		for (i = 0; i<num; i++)
+			for (w = 0; w<words; w++)
+				wins[w] |= before[i * words + w] &
+					after[(num - 1 - i) * words + w];
+	}
+
+	for (i = 0; i<table->width; i++) {
+		bit = order[i] * table->stride;
+		for (y = 0; y<table->height; y++, bit++)
+			if (wins[bit / 64] >> (bit % 64) & 1)
+				return order[i];
+	}
+	return -1;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function sets bit b of dst to bit b + n of src, 0 where that is  **/
+/**  off either end.                                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+shift(uint64_t *dst, const uint64_t *src, int n, int num_words)
+{
+	int w, from, words = n / 64, bits = n % 64;
+
+	if (bits < 0) {
+		bits += 64;
+		words--;
+	}
+
+	for (w = 0; w<num_words; w++) {
+		from = w + words;
+		dst[w] = 0;
+		if (from >= 0 && from < num_words)
+			dst[w] = src[from] >> bits;
+		if (bits != 0 && from + 1 >= 0 && from + 1 < num_words)
+			dst[w] |= src[from + 1] << (64 - bits);
+	}
+}
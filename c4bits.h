@@ -0,0 +1,33 @@
+#ifndef C4BITS_DEFINED
+#define C4BITS_DEFINED
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* The shape of a board, laid out as bitboards (see "c4bits.c"). */
+
+typedef struct C4_bits_table C4_bits_table;
+
+/* The bitboards of one game, and room to work in. */
+
+typedef struct C4_bits C4_bits;
+
+/* See the file "c4bits.c" for documentation on the following functions. */
+
+extern C4_bits_table *c4_bits_table_new(int width, int height, int num);
+extern void           c4_bits_table_free(C4_bits_table *table);
+extern C4_bits *      c4_bits_new(const C4_bits_table *table);
+extern void           c4_bits_free(C4_bits *bits);
+extern size_t         c4_bits_table_size(int width, int height);
+extern size_t         c4_bits_size(const C4_bits_table *table);
+extern void           c4_bits_load(const C4_bits_table *table, C4_bits *bits,
+                                   char **board);
+extern void           c4_bits_set(const C4_bits_table *table, C4_bits *bits,
+                                  int player, int x, int y);
+extern void           c4_bits_clear(const C4_bits_table *table,
+                                    C4_bits *bits, int player, int x, int y);
+extern int            c4_bits_winning_drop(const C4_bits_table *table,
+                                           C4_bits *bits, int player,
+                                           const int *order);
+
+#endif /* C4BITS_DEFINED */
@@ -0,0 +1,412 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include "c4.h"
+#include "c4sys.h"
+
+/* This file holds the corpus of positions, in which self-play (or any   */
+/* other source of games) leaves labelled positions for evaluations to   */
+/* be tuned on.  A corpus is a file of fixed-size records, one per       */
+/* position, after a short header.  Games are only ever appended, each   */
+/* in one write, so a file may be read while it is still growing: the    */
+/* number of positions is worked out from its size, and a record not yet */
+/* written in full is simply not counted.  Readers map the file into     */
+/* memory and decode positions straight out of it.                       */
+/*                                                                       */
+/* The file is little-endian throughout:                                 */
+/*                                                                       */
+/*   "C4PC", then version (1), width, height, num and the size of a      */
+/*   record, as 32-bit integers;                                         */
+/*   the records.                                                        */
+/*                                                                       */
+/* A record holds, in order:                                             */
+/*                                                                       */
+/*   the score of the move, as a 32-bit integer;                         */
+/*   the number of pieces on the board, as a 16-bit integer;             */
+/*   the column of the move, as a byte;                                  */
+/*   a byte of flags: bit 0 is the player to move, bit 1 is set if that  */
+/*   player went on to win and bit 2 if the player lost;                 */
+/*   the board, 2 bits per cell, four cells to a byte starting from the  */
+/*   low bits, cell (x, y) being cell x * height + y: 0 for an empty     */
+/*   cell, 1 for a piece of player 0 and 2 for a piece of player 1;      */
+/*   padding, up to a multiple of 4 bytes.                               */
+
+#define VERSION      1
+#define HEADER_SIZE  24
+#define ENTRY_SIZE   8          /* The bytes of a record before the board.  */
+
+#define FLAG_PLAYER  1
+#define FLAG_WON     2
+#define FLAG_LOST    4
+
+struct C4_corpus_writer {
+	FILE *fp;
+	int width, height, num;
+	int record_size;
+	c4_mutex lock;          /* Held while a game is written, so that games */
+							/* from different threads do not interleave.   */
+};
+
+struct C4_corpus {
+	c4_file_view view;
+	const unsigned char *data;
+	uint64_t file_size;
+	int width, height, num;
+	int record_size;
+	long size;              /* The number of whole records in the file.    */
+};
+
+static int record_size(int width, int height);
+static void put_int(unsigned char *p, int size, int32_t value);
+static int32_t get_int(const unsigned char *p, int size);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens a corpus for writing, for games on a board of     **/
+/**  the given size.  A new file is created at path if there is none;      **/
+/**  otherwise games are added to the end of the one there, which must be  **/
+/**  a corpus for the same size of board.  NULL is returned if the file    **/
+/**  cannot be opened or is not such a corpus.  A writer may be shared by  **/
+/**  any number of threads.                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_corpus_writer *
+c4_corpus_writer_new(const char *path, int width, int height, int num)
+{
+	C4_corpus_writer *writer;
+	unsigned char header[HEADER_SIZE], existing[HEADER_SIZE];
+	FILE *fp;
+	long end;
+	int size;
+
+	assert(width >= 1 && width <= 255 && height >= 1 && num >= 1);
+	assert(width * height <= 65535);
+
+	size = record_size(width, height);
+	memcpy(header, "C4PC", 4);
+	put_int(header + 4, 4, VERSION);
+	put_int(header + 8, 4, width);
+	put_int(header + 12, 4, height);
+	put_int(header + 16, 4, num);
+	put_int(header + 20, 4, size);
+
+	/* Append to the file if it is there, leaving out any record cut */
+	/* short by a writer which did not finish.                       */
+
+	fp = fopen(path, "r+b");
+	if (fp != NULL) {
+		if (fread(existing, 1, HEADER_SIZE, fp) != HEADER_SIZE ||
+			memcmp(existing, header, HEADER_SIZE) != 0 ||
+			fseek(fp, 0, SEEK_END) != 0 || (end = ftell(fp)) < 0 ||
+			fseek(fp, end - (end - HEADER_SIZE) % size, SEEK_SET) != 0) {
+			fclose(fp);
+			return NULL;
+		}
+	}
+	else {
+		fp = fopen(path, "w+b");
+		if (fp == NULL)
+			return NULL;
+		if (fwrite(header, 1, HEADER_SIZE, fp) != HEADER_SIZE) {
+			fclose(fp);
+			return NULL;
+		}
+	}
+
+	writer = (C4_corpus_writer *)malloc(sizeof(C4_corpus_writer));
+	if (writer == NULL) {
+		fprintf(stderr, "c4: c4_corpus_writer_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+	writer->fp = fp;
+	writer->width = width;
+	writer->height = height;
+	writer->num = num;
+	writer->record_size = size;
+	c4_mutex_init(&writer->lock);
+
+	return writer;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function closes a corpus opened for writing.  No game may be     **/
+/**  being written to it.                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_corpus_writer_free(C4_corpus_writer *writer)
+{
+	if (writer == NULL)
+		return;
+
+	fclose(writer->fp);
+	c4_mutex_destroy(&writer->lock);
+	free(writer);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds a game to a corpus: a record for each of its       **/
+/**  moves from game->first_recorded on, holding the board before the      **/
+/**  move, the move and the outcome of the game for the player making it.  **/
+/**  The records are put together first and then written in one go, and    **/
+/**  flushed.  The file may still reach the disk in pieces, so a reader    **/
+/**  can see part of a game, but it sees whole records only.  The moves    **/
+/**  must be legal.  A value of false is returned if the file could not    **/
+/**  be written.                                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_corpus_write_game(C4_corpus_writer *writer, const C4_corpus_game *game)
+{
+	unsigned char *records, *board, *p;
+	int *heights;
+	int player, column, cell, count, i;
+	bool ok;
+
+	assert(game->first_player == 0 || game->first_player == 1);
+	assert(game->num_moves >= 0 &&
+		game->num_moves <= writer->width * writer->height);
+	assert(game->winner == 0 || game->winner == 1 || game->winner == C4_NONE);
+	assert(game->first_recorded >= 0);
+
+	count = game->num_moves - game->first_recorded;
+	if (count <= 0)
+		return true;
+
+	records = (unsigned char *)calloc(count, writer->record_size);
+	board = (unsigned char *)calloc(writer->record_size - ENTRY_SIZE, 1);
+	heights = (int *)calloc(writer->width, sizeof(int));
+	if (records == NULL || board == NULL || heights == NULL) {
+		fprintf(stderr, "c4: c4_corpus_write_game() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	/* Play the game out on the packed board, copying it into a record */
+	/* before each move that is to be kept.                            */
+
+	p = records;
+	player = game->first_player;
+	for (i = 0; i<game->num_moves; i++) {
+		column = game->columns[i];
+		assert(column >= 0 && column < writer->width);
+		assert(heights[column] < writer->height);
+
+		if (i >= game->first_recorded) {
+			put_int(p, 4, game->scores[i]);
+			put_int(p + 4, 2, i);
+			p[6] = (unsigned char)column;
+			p[7] = (unsigned char)(player |
+				((game->winner == player) ? FLAG_WON : 0) |
+				((game->winner == (player ^ 1)) ? FLAG_LOST : 0));
+			memcpy(p + ENTRY_SIZE, board, writer->record_size - ENTRY_SIZE);
+			p += writer->record_size;
+		}
+
+		cell = column * writer->height + heights[column]++;
+		board[cell >> 2] |= (unsigned char)((player + 1) << (2 * (cell & 3)));
+		player ^= 1;
+	}
+
+	c4_mutex_lock(&writer->lock);
+	ok = fwrite(records, writer->record_size, count, writer->fp) ==
+		(size_t)count && fflush(writer->fp) == 0;
+	c4_mutex_unlock(&writer->lock);
+
+	free(records);
+	free(board);
+	free(heights);
+	return ok;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens a corpus for reading, by mapping it into memory.  **/
+/**  NULL is returned if the file cannot be mapped or is not a corpus.     **/
+/**  Games added to the file after it is opened are not seen; a corpus     **/
+/**  may be read by any number of threads at once.                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_corpus *
+c4_corpus_open(const char *path)
+{
+	C4_corpus *corpus;
+	const void *data;
+	const unsigned char *header;
+	uint64_t size;
+	c4_file_view view;
+
+	if (c4_file_map(&view, path, &data, &size) != 0)
+		return NULL;
+
+	header = (const unsigned char *)data;
+	if (size < HEADER_SIZE || memcmp(header, "C4PC", 4) != 0 ||
+		get_int(header + 4, 4) != VERSION ||
+		get_int(header + 8, 4) < 1 || get_int(header + 8, 4) > 255 ||
+		get_int(header + 12, 4) < 1 || get_int(header + 16, 4) < 1 ||
+		get_int(header + 8, 4) * get_int(header + 12, 4) > 65535 ||
+		get_int(header + 20, 4) !=
+		record_size(get_int(header + 8, 4), get_int(header + 12, 4))) {
+		c4_file_unmap(&view, data, size);
+		return NULL;
+	}
+
+	corpus = (C4_corpus *)malloc(sizeof(C4_corpus));
+	if (corpus == NULL) {
+		fprintf(stderr, "c4: c4_corpus_open() - Can't allocate memory.\n");
+		exit(1);
+	}
+	corpus->view = view;
+	corpus->data = header;
+	corpus->file_size = size;
+	corpus->width = get_int(header + 8, 4);
+	corpus->height = get_int(header + 12, 4);
+	corpus->num = get_int(header + 16, 4);
+	corpus->record_size = get_int(header + 20, 4);
+	corpus->size = (long)((size - HEADER_SIZE) / corpus->record_size);
+
+	return corpus;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function closes a corpus opened for reading.                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_corpus_close(C4_corpus *corpus)
+{
+	if (corpus == NULL)
+		return;
+
+	c4_file_unmap(&corpus->view, corpus->data, corpus->file_size);
+	free(corpus);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the size of board, and the number to connect,   **/
+/**  of the games in a corpus.                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_corpus_shape(const C4_corpus *corpus, int *width, int *height, int *num)
+{
+	if (width != NULL)
+		*width = corpus->width;
+	if (height != NULL)
+		*height = corpus->height;
+	if (num != NULL)
+		*num = corpus->num;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of positions in a corpus.            **/
+/**                                                                        **/
+/****************************************************************************/
+
+long
+c4_corpus_size(const C4_corpus *corpus)
+{
+	return corpus->size;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function reads the position numbered index (from 0) out of a     **/
+/**  corpus into entry, and, unless board is NULL, its board into board,   **/
+/**  which must be laid out as by c4_board() and be of the corpus's size.  **/
+/**  Positions are in the order they were written, the moves of each game  **/
+/**  together and in turn.                                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_corpus_read(const C4_corpus *corpus, long index, C4_corpus_entry *entry,
+	char **board)
+{
+	static const char pieces[4] = { C4_NONE, 0, 1, C4_NONE };
+	const unsigned char *p;
+	int x, y, cell;
+
+	assert(index >= 0 && index < corpus->size);
+
+	p = corpus->data + HEADER_SIZE + (uint64_t)index * corpus->record_size;
+	entry->score = get_int(p, 4);
+	entry->ply = get_int(p + 4, 2);
+	entry->column = p[6];
+	entry->player = p[7] & FLAG_PLAYER;
+	entry->outcome = (p[7] & FLAG_WON) ? 1 : (p[7] & FLAG_LOST) ? -1 : 0;
+
+	if (board == NULL)
+		return;
+
+	p += ENTRY_SIZE;
+	cell = 0;
+	for (x = 0; x<corpus->width; x++)
+		for (y = 0; y<corpus->height; y++, cell++)
+			board[x][y] = pieces[(p[cell >> 2] >> (2 * (cell & 3))) & 3];
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the size of a record for a board of the given   **/
+/**  size.                                                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+record_size(int width, int height)
+{
+	return (ENTRY_SIZE + (width * height + 3) / 4 + 3) & ~3;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions store and fetch a little-endian integer of the given  **/
+/**  number of bytes.  Integers of fewer than 4 bytes are unsigned.        **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+put_int(unsigned char *p, int size, int32_t value)
+{
+	int i;
+
+	for (i = 0; i<size; i++)
+		p[i] = (unsigned char)((uint32_t)value >> (8 * i));
+}
+
+
+static int32_t
+get_int(const unsigned char *p, int size)
+{
+	uint32_t value = 0;
+	int i;
+
+	for (i = 0; i<size; i++)
+		value |= (uint32_t)p[i] << (8 * i);
+	return (int32_t)value;
+}
@@ -0,0 +1,279 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "c4.h"
+#include "c4sys.h"
+
+/* This file holds the move log, which writes out the moves made by the  */
+/* computer without the engine itself doing any I/O.  The engine puts a  */
+/* record of each move into a ring buffer, and a thread of the log's own */
+/* takes them out and writes them to a file, one JSON object per line.   */
+/* Putting a record in takes no lock, so games on any number of threads  */
+/* can share a log; if the buffer is full, the record is dropped rather  */
+/* than the game kept waiting.                                           */
+/*                                                                       */
+/* The buffer is the bounded queue of Dmitry Vyukov.  Each slot holds a  */
+/* sequence number, which is its position in the queue when it is free   */
+/* to be written, and one more than that once it has been.  A writer     */
+/* claims a position by advancing tail, fills the slot and then bumps    */
+/* its sequence; the reader takes it when the sequence says so, and      */
+/* frees it for the next lap by adding the size of the buffer.           */
+
+#define DEFAULT_CAPACITY 1024   /* Records the buffer holds by default.    */
+#define IDLE_MS          2      /* How long the thread sleeps when there   */
+								/* is nothing to write.                    */
+
+typedef struct {
+	int tag;                /* The game, as given to c4_game_log_moves().  */
+	int move;               /* The number of pieces on the board after it. */
+	int player;
+	C4_move_result result;
+} Record;
+
+typedef struct {
+	c4_atomic sequence;
+	Record record;
+} Slot;
+
+struct C4_log {
+	FILE *fp;
+	Slot *slots;
+	long mask;              /* The number of slots, a power of 2, less 1.  */
+	c4_atomic tail;         /* The next position for a writer to claim.    */
+	long head;              /* The next position to be read (by the thread */
+							/* only).                                      */
+	c4_atomic written;      /* The positions written out and flushed.      */
+	c4_atomic dropped;      /* Records dropped for want of room.           */
+	c4_atomic stopping;     /* Set when the log is being freed.            */
+	c4_thread thread;
+};
+
+static bool drain(C4_log *log);
+static void write_record(FILE *fp, const Record *record);
+static C4_THREAD_PROC(drain_main, arg);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function creates a log which writes to fp, with room in its      **/
+/**  buffer for capacity records (rounded up to a power of 2), or for a    **/
+/**  default number if capacity is 0.  fp stays open, and owned by the     **/
+/**  caller, until the log is freed.  NULL is returned if the thread that  **/
+/**  writes the log cannot be started.                                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_log *
+c4_log_new(FILE *fp, int capacity)
+{
+	C4_log *log;
+	long size = 2, i;
+
+	if (capacity <= 0)
+		capacity = DEFAULT_CAPACITY;
+	while (size < capacity)
+		size *= 2;
+
+	log = (C4_log *)malloc(sizeof(C4_log));
+	if (log != NULL)
+		log->slots = (Slot *)malloc(size * sizeof(Slot));
+	if (log == NULL || log->slots == NULL) {
+		fprintf(stderr, "c4: c4_log_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	log->fp = fp;
+	log->mask = size - 1;
+	for (i = 0; i<size; i++)
+		c4_atomic_store(&log->slots[i].sequence, i);
+	c4_atomic_store(&log->tail, 0);
+	log->head = 0;
+	c4_atomic_store(&log->written, 0);
+	c4_atomic_store(&log->dropped, 0);
+	c4_atomic_store(&log->stopping, 0);
+
+	if (c4_thread_create(&log->thread, drain_main, log) != 0) {
+		free(log->slots);
+		free(log);
+		return NULL;
+	}
+
+	return log;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function destroys a log, once every record put into it has been  **/
+/**  written out.  The games logging to it must stop doing so first.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_log_free(C4_log *log)
+{
+	if (log == NULL)
+		return;
+
+	c4_atomic_store(&log->stopping, 1);
+	c4_thread_join(log->thread);
+	free(log->slots);
+	free(log);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function puts a record of a move into a log: the move made by    **/
+/**  player, as reported in result, which left move pieces on the board    **/
+/**  of the game tagged tag.  It never waits.  A value of true is returned **/
+/**  if the record was put in, or false if the buffer was full and it was  **/
+/**  dropped.  Games call this themselves once c4_game_log_moves() has     **/
+/**  been called; there is no need to call it for them.                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_log_move(C4_log *log, int tag, int move, int player,
+	const C4_move_result *result)
+{
+	long pos = c4_atomic_load(&log->tail), sequence;
+	Slot *slot;
+
+	for (;;) {
+		slot = &log->slots[pos & log->mask];
+		sequence = c4_atomic_load(&slot->sequence);
+		if (sequence == pos) {
+			if (c4_atomic_cas(&log->tail, pos, pos + 1))
+				break;
+			pos = c4_atomic_load(&log->tail);
+		}
+		else if (sequence - pos < 0) {
+			c4_atomic_increment(&log->dropped);
+			return false;
+		}
+		else
+			pos = c4_atomic_load(&log->tail);
+	}
+
+	slot->record.tag = tag;
+	slot->record.move = move;
+	slot->record.player = player;
+	slot->record.result = *result;
+	c4_atomic_store(&slot->sequence, pos + 1);
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function waits until every record put into a log so far has been **/
+/**  written out and flushed.                                              **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_log_flush(C4_log *log)
+{
+	long target = c4_atomic_load(&log->tail);
+
+	while (c4_atomic_load(&log->written) - target < 0)
+		c4_sleep_ms(1);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of records a log has dropped because **/
+/**  its buffer was full.                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+long
+c4_log_dropped(C4_log *log)
+{
+	return c4_atomic_load(&log->dropped);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function writes out the records waiting in a log's buffer, and   **/
+/**  returns whether there were any.                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+drain(C4_log *log)
+{
+	Slot *slot;
+	long start = log->head;
+
+	for (;;) {
+		slot = &log->slots[log->head & log->mask];
+		if (c4_atomic_load(&slot->sequence) != log->head + 1)
+			break;
+		write_record(log->fp, &slot->record);
+		c4_atomic_store(&slot->sequence, log->head + log->mask + 1);
+		log->head++;
+	}
+
+	if (log->head == start)
+		return false;
+
+	fflush(log->fp);
+	c4_atomic_store(&log->written, log->head);
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function writes a record out as a line of JSON.                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+write_record(FILE *fp, const Record *record)
+{
+	const C4_move_result *result = &record->result;
+	int i;
+
+	fprintf(fp, "{\"game\": %d, \"move\": %d, \"player\": %d, \"column\": %d, "
+		"\"row\": %d, \"score\": %d, \"rules\": [", record->tag, record->move,
+		record->player, result->column, result->row, result->score);
+	for (i = 0; i<result->num_rules_fired; i++)
+		fprintf(fp, "%s%d", (i > 0) ? ", " : "", result->rules_fired[i]);
+	fprintf(fp, "], \"nodes\": %ld, \"seconds\": %.6f}\n", result->stats.nodes,
+		result->stats.seconds);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This is the body of a log's thread.  It writes out records as they    **/
+/**  come, and sleeps while there are none, until the log is freed.  The   **/
+/**  flag is looked at before the buffer is drained, so that the records   **/
+/**  put in before it was set are all written.                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+static
+C4_THREAD_PROC(drain_main, arg)
+{
+	C4_log *log = (C4_log *)arg;
+	bool stopping;
+
+	for (;;) {
+		stopping = c4_atomic_load(&log->stopping) != 0;
+		if (drain(log))
+			continue;
+		if (stopping)
+			break;
+		c4_sleep_ms(IDLE_MS);
+	}
+
+	C4_THREAD_RETURN;
+}
@@ -0,0 +1,565 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "c4.h"
+#include "c4sys.h"
+#include "c4tool.h"
+
+/* c4match plays engines against one another, on any number of threads,  */
+/* to compare them on strength and speed together.  Every pair of the    */
+/* engines given with -e plays each opening twice, once from each side.  */
+/* The openings are random moves drawn from a seed, or are read from a   */
+/* file with -b, one per line, as columns numbered from 1.  For each     */
+/* pair, the wins, draws and losses are reported with the difference in  */
+/* Elo rating they imply and its 95% confidence interval; for each       */
+/* engine, its record against the field and the distribution of the      */
+/* time it took over its moves.                                          */
+
+#define MAX_ENGINES  16
+#define MAX_THREADS  256
+#define MAX_OPENING  40         /* Moves in an opening read from a file.  */
+
+/* A sequence of opening moves. */
+
+typedef struct {
+	int num_moves;
+	int columns[MAX_OPENING];
+} Opening;
+
+/* The times an engine took over its moves. */
+
+typedef struct {
+	double *seconds;
+	long count, allocated;
+	long nodes;
+	long table_probes, table_hits;
+} Timings;
+
+/* The match, shared by the threads. */
+
+typedef struct {
+	int width, height, num;
+	C4_engine engines[MAX_ENGINES];
+	int num_engines;
+	Opening *openings;
+	int num_openings;
+	int pairs[MAX_ENGINES * (MAX_ENGINES - 1) / 2][2];
+	int num_pairs;
+	long games;             /* num_pairs * num_openings * 2.               */
+	c4_atomic next_game;    /* The number of games claimed by threads.     */
+	c4_atomic finished;     /* The number of games played.                 */
+} Match;
+
+/* One thread, and what it has seen. */
+
+typedef struct {
+	Match *match;
+	c4_thread thread;
+	long (*results)[3];     /* Wins, draws and losses of the first engine  */
+							/* of each pair.                               */
+	Timings timings[MAX_ENGINES];
+} Worker;
+
+static bool read_openings(Match *match, const char *path);
+static void random_openings(Match *match, int count, int plies,
+	unsigned long long seed);
+static void play_game(Worker *worker, long number);
+static void add_timing(Timings *timings, const C4_move_result *result);
+static int compare_doubles(const void *a, const void *b);
+static double elo(double score);
+static void report_pair(const Match *match, int pair, const long result[3]);
+static void report_engine(const C4_engine *engine, const long result[3],
+	Timings *timings);
+static void usage(void);
+static C4_THREAD_PROC(worker_main, arg);
+
+
+int
+main(int argc, char *argv[])
+{
+	static Match match;
+	static Worker workers[MAX_THREADS];
+	static long totals[MAX_ENGINES][3];
+	const char *book = NULL, *shared = NULL;
+	long (*results)[3];
+	Timings timings;
+	unsigned long long seed = (unsigned long long)time(NULL);
+	int num_threads = 1, num_openings = 100, plies = 2, i, j, e;
+	double start, seconds;
+
+	match.width = 7;
+	match.height = 6;
+	match.num = 4;
+
+	for (i = 1; i<argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' ||
+			i + 1 >= argc)
+			usage();
+		switch (argv[i++][1]) {
+		case 'g': num_openings = atoi(argv[i]); break;
+		case 't': num_threads = atoi(argv[i]); break;
+		case 'r': plies = atoi(argv[i]); break;
+		case 's': seed = strtoull(argv[i], NULL, 10); break;
+		case 'b': book = argv[i]; break;
+		case 'S': shared = argv[i]; break;
+		case 'W': match.width = atoi(argv[i]); break;
+		case 'H': match.height = atoi(argv[i]); break;
+		case 'N': match.num = atoi(argv[i]); break;
+		case 'e':
+			if (match.num_engines == MAX_ENGINES ||
+				!c4_engine_parse(argv[i], &match.engines[match.num_engines++]))
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (match.num_engines < 2 || match.width < 1 || match.width > 40 ||
+		match.height < 1 || match.height > 40 || match.num < 1 ||
+		num_openings < 1 || plies < 0 || plies > MAX_OPENING ||
+		plies >= match.width * match.height ||
+		num_threads < 1 || num_threads > MAX_THREADS ||
+		(shared != NULL && strlen(shared) > 200))
+		usage();
+
+	if (book != NULL) {
+		if (!read_openings(&match, book)) {
+			fprintf(stderr, "c4match: can't read openings from %s\n", book);
+			return 1;
+		}
+	}
+	else
+		random_openings(&match, num_openings, plies, seed);
+
+	/* With -S, each engine's table is shared with the engines of the   */
+	/* same name in other matches running on the host at the same time. */
+
+	for (e = 0; e<match.num_engines; e++)
+		if (!c4_engine_open(&match.engines[e], match.width, match.height,
+			shared)) {
+			fprintf(stderr, "c4match: can't read the network or make the "
+				"table of %s\n", match.engines[e].name);
+			return 1;
+		}
+
+	for (i = 0; i<match.num_engines; i++)
+		for (j = i + 1; j<match.num_engines; j++) {
+			match.pairs[match.num_pairs][0] = i;
+			match.pairs[match.num_pairs++][1] = j;
+		}
+	match.games = (long)match.num_pairs * match.num_openings * 2;
+	c4_atomic_store(&match.next_game, 0);
+	c4_atomic_store(&match.finished, 0);
+
+	start = c4_wall_time();
+	for (i = 0; i<num_threads; i++) {
+		workers[i].match = &match;
+		workers[i].results =
+			(long (*)[3])calloc(match.num_pairs, sizeof(long[3]));
+		if (workers[i].results == NULL) {
+			fprintf(stderr, "c4match: can't allocate memory\n");
+			return 1;
+		}
+		if (c4_thread_create(&workers[i].thread, worker_main,
+			&workers[i]) != 0) {
+			fprintf(stderr, "c4match: can't start thread %d\n", i);
+			return 1;
+		}
+	}
+
+	/* Show how far the match has got while it runs. */
+
+	while (c4_atomic_load(&match.finished) < match.games) {
+		fprintf(stderr, "\r%ld/%ld games", c4_atomic_load(&match.finished),
+			match.games);
+		c4_sleep_ms(200);
+	}
+	fprintf(stderr, "\r%ld/%ld games\n", match.games, match.games);
+
+	results = workers[0].results;
+	for (i = 0; i<num_threads; i++) {
+		c4_thread_join(workers[i].thread);
+		for (j = 0; i > 0 && j<match.num_pairs; j++) {
+			results[j][0] += workers[i].results[j][0];
+			results[j][1] += workers[i].results[j][1];
+			results[j][2] += workers[i].results[j][2];
+		}
+	}
+	seconds = c4_wall_time() - start;
+
+	printf("%ld games of %dx%d connect-%d from %d openings, in %.1f s on %d "
+		"thread%s\n\n", match.games, match.width, match.height, match.num,
+		match.num_openings, seconds, num_threads, (num_threads > 1) ? "s" : "");
+
+	printf("%-24s %6s %6s %6s %7s %8s %s\n", "pair", "wins", "draws",
+		"losses", "score", "Elo", "95% interval");
+	for (i = 0; i<match.num_pairs; i++) {
+		report_pair(&match, i, results[i]);
+		for (j = 0; j<3; j++) {
+			totals[match.pairs[i][0]][j] += results[i][j];
+			totals[match.pairs[i][1]][2 - j] += results[i][j];
+		}
+	}
+
+	printf("\n%-10s %6s %6s %6s %7s %8s %8s %8s %8s %8s %8s %8s %9s %6s\n",
+		"engine", "wins", "draws", "losses", "score", "Elo", "moves",
+		"mean ms", "p50", "p90", "p99", "max", "nodes/s", "hits");
+	for (e = 0; e<match.num_engines; e++) {
+		memset(&timings, 0, sizeof(timings));
+		for (i = 0; i<num_threads; i++) {
+			Timings *t = &workers[i].timings[e];
+			if (timings.count + t->count > timings.allocated) {
+				timings.allocated = timings.count + t->count;
+				timings.seconds = (double *)realloc(timings.seconds,
+					timings.allocated * sizeof(double));
+				if (timings.seconds == NULL) {
+					fprintf(stderr, "c4match: can't allocate memory\n");
+					return 1;
+				}
+			}
+			if (t->count > 0)
+				memcpy(timings.seconds + timings.count, t->seconds,
+					t->count * sizeof(double));
+			timings.count += t->count;
+			timings.nodes += t->nodes;
+			timings.table_probes += t->table_probes;
+			timings.table_hits += t->table_hits;
+			free(t->seconds);
+		}
+		report_engine(&match.engines[e], totals[e], &timings);
+		free(timings.seconds);
+		c4_engine_close(&match.engines[e]);
+	}
+
+	for (i = 0; i<num_threads; i++)
+		free(workers[i].results);
+	free(match.openings);
+	return 0;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function reads the openings of a match from the file at path:    **/
+/**  one to a line, as columns numbered from 1 and separated by spaces or  **/
+/**  commas.  Blank lines and lines starting with # are skipped.  A value  **/
+/**  of false is returned if the file cannot be read, an opening does not  **/
+/**  fit on the board, or there are none.                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+read_openings(Match *match, const char *path)
+{
+	FILE *fp;
+	char line[512], *p, *end;
+	int heights[40], allocated = 0;
+	Opening *opening;
+	long column;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return false;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		p = line + strspn(line, " \t,\r\n");
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		if (match->num_openings == allocated) {
+			allocated = (allocated > 0) ? 2 * allocated : 64;
+			match->openings = (Opening *)realloc(match->openings,
+				allocated * sizeof(Opening));
+			if (match->openings == NULL) {
+				fprintf(stderr, "c4match: can't allocate memory\n");
+				exit(1);
+			}
+		}
+		opening = &match->openings[match->num_openings++];
+		opening->num_moves = 0;
+		memset(heights, 0, sizeof(heights));
+
+		while (*p != '\0') {
+			column = strtol(p, &end, 10) - 1;
+			if (end == p || column < 0 || column >= match->width ||
+				heights[column] == match->height ||
+				opening->num_moves == MAX_OPENING) {
+				fclose(fp);
+				return false;
+			}
+			heights[column]++;
+			opening->columns[opening->num_moves++] = (int)column;
+			p = end + strspn(end, " \t,\r\n");
+		}
+	}
+
+	fclose(fp);
+	return match->num_openings > 0;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes count random openings of the given number of      **/
+/**  plies, none of which wins the game, from the given seed.              **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+random_openings(Match *match, int count, int plies, unsigned long long seed)
+{
+	C4_game *game;
+	Opening *opening;
+	char **board;
+	int i, column;
+	bool won;
+
+	match->openings = (Opening *)malloc(count * sizeof(Opening));
+	if (match->openings == NULL) {
+		fprintf(stderr, "c4match: can't allocate memory\n");
+		exit(1);
+	}
+	match->num_openings = count;
+
+	for (i = 0; i<count; i++) {
+		opening = &match->openings[i];
+		do {
+			game = c4_game_new(NULL, match->width, match->height, match->num);
+			board = c4_game_board(game);
+			for (opening->num_moves = 0; opening->num_moves < plies;
+				opening->num_moves++) {
+				do
+					column = (int)(c4_tool_random(&seed) % match->width);
+				while (board[column][match->height - 1] != C4_NONE);
+				c4_game_make_move(game, opening->num_moves & 1, column, NULL);
+				opening->columns[opening->num_moves] = column;
+			}
+			won = c4_game_is_winner(game, 0) || c4_game_is_winner(game, 1);
+			c4_game_free(game);
+		} while (won);
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function plays the game numbered number.  Games are numbered so  **/
+/**  that each pair of engines plays each opening twice in a row, the      **/
+/**  first engine of the pair moving first in the first game and second    **/
+/**  in the second.                                                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+play_game(Worker *worker, long number)
+{
+	Match *match = worker->match;
+	int pair = (int)(number / (2 * match->num_openings));
+	const Opening *opening =
+		&match->openings[(number / 2) % match->num_openings];
+	int swapped = (int)(number & 1);
+	int sides[2], player, i;
+	C4_game *game;
+	C4_move_result result;
+	bool moved = true;
+
+	/* sides[p] is the engine playing player p; player 0 moves first. */
+
+	sides[swapped] = match->pairs[pair][0];
+	sides[swapped ^ 1] = match->pairs[pair][1];
+
+	game = c4_game_new(NULL, match->width, match->height, match->num);
+	for (i = 0; i<opening->num_moves; i++)
+		c4_game_make_move(game, i & 1, opening->columns[i], NULL);
+
+	player = opening->num_moves & 1;
+	while (moved && !c4_game_is_winner(game, 0) &&
+		!c4_game_is_winner(game, 1) && !c4_game_is_tie(game)) {
+		moved = c4_engine_move(&match->engines[sides[player]], game, player,
+			&result);
+		if (moved)
+			add_timing(&worker->timings[sides[player]], &result);
+		player ^= 1;
+	}
+
+	/* Score the game for the first engine of the pair. */
+
+	if (c4_game_is_winner(game, swapped))
+		worker->results[pair][0]++;
+	else if (c4_game_is_winner(game, swapped ^ 1))
+		worker->results[pair][2]++;
+	else
+		worker->results[pair][1]++;
+
+	c4_game_free(game);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds the time taken over a move to an engine's times.   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+add_timing(Timings *timings, const C4_move_result *result)
+{
+	if (timings->count == timings->allocated) {
+		timings->allocated = (timings->allocated > 0) ?
+			2 * timings->allocated : 1024;
+		timings->seconds = (double *)realloc(timings->seconds,
+			timings->allocated * sizeof(double));
+		if (timings->seconds == NULL) {
+			fprintf(stderr, "c4match: can't allocate memory\n");
+			exit(1);
+		}
+	}
+	timings->seconds[timings->count++] = result->stats.seconds;
+	timings->nodes += result->stats.nodes;
+	timings->table_probes += result->stats.table_probes;
+	timings->table_hits += result->stats.table_hits;
+}
+
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the difference in Elo rating implied by the     **/
+/**  given expected score (from 0 to 1).                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static double
+elo(double score)
+{
+	if (score <= 0.0)
+		return -HUGE_VAL;
+	if (score >= 1.0)
+		return HUGE_VAL;
+	return -400.0 * log10(1.0 / score - 1.0);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function prints the result of a pair of engines, from the point  **/
+/**  of view of the first.  The interval is that of the score (taking the  **/
+/**  games as independent, with a draw worth half a win), turned into      **/
+/**  Elo.                                                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+report_pair(const Match *match, int pair, const long result[3])
+{
+	char name[2 * sizeof(match->engines[0].name) + 4];
+	long games = result[0] + result[1] + result[2];
+	double score, deviation, margin;
+
+	sprintf(name, "%s vs %s", match->engines[match->pairs[pair][0]].name,
+		match->engines[match->pairs[pair][1]].name);
+	score = (result[0] + 0.5 * result[1]) / games;
+	deviation = sqrt((result[0] * (1.0 - score) * (1.0 - score) +
+		result[1] * (0.5 - score) * (0.5 - score) +
+		result[2] * score * score) / games);
+	margin = 1.96 * deviation / sqrt((double)games);
+
+	printf("%-24s %6ld %6ld %6ld %6.1f%% %+8.0f [%+.0f, %+.0f]\n", name,
+		result[0], result[1], result[2], 100.0 * score, elo(score),
+		elo(score - margin), elo(score + margin));
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function prints an engine's record against the field, the        **/
+/**  distribution of the time it took over its moves, and how many of the  **/
+/**  positions it looked for in its transposition table it found there.    **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+report_engine(const C4_engine *engine, const long result[3],
+	Timings *timings)
+{
+	long games = result[0] + result[1] + result[2], n = timings->count;
+	double score = (result[0] + 0.5 * result[1]) / games, total = 0.0;
+	double *s = timings->seconds;
+	long i;
+
+	printf("%-10s %6ld %6ld %6ld %6.1f%% %+8.0f %8ld", engine->name,
+		result[0], result[1], result[2], 100.0 * score, elo(score), n);
+	if (n == 0) {
+		printf("\n");
+		return;
+	}
+
+	qsort(s, n, sizeof(double), compare_doubles);
+	for (i = 0; i<n; i++)
+		total += s[i];
+	printf(" %8.3f %8.3f %8.3f %8.3f %8.3f %9.0f", 1000.0 * total / n,
+		1000.0 * s[n / 2], 1000.0 * s[n * 9 / 10], 1000.0 * s[n * 99 / 100],
+		1000.0 * s[n - 1], (total > 0.0) ? timings->nodes / total : 0.0);
+	if (timings->table_probes > 0)
+		printf(" %5.1f%%\n",
+			100.0 * timings->table_hits / timings->table_probes);
+	else
+		printf(" %6s\n", "-");
+}
+
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"usage: c4match -e engine -e engine [-e engine]... [-g openings]\n"
+		"               [-r random plies | -b openings file] [-s seed]\n"
+		"               [-t threads] [-W width] [-H height] [-N num]\n"
+		"               [-S shared table name]\n"
+		"\n");
+	c4_engine_help(stderr);
+	fprintf(stderr,
+		"Every pair of engines plays each opening from both sides.\n"
+		"\n"
+		"With -S /name, the tables are put in shared memory, as /name-h8t64\n"
+		"and so on, and shared with other matches on the host using the same\n"
+		"name.  They last until removed (on Linux, from /dev/shm).\n");
+	exit(2);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This is the body of each thread.  It plays games until they have all  **/
+/**  been claimed.                                                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+static
+C4_THREAD_PROC(worker_main, arg)
+{
+	Worker *worker = (Worker *)arg;
+	Match *match = worker->match;
+	long number;
+
+	while ((number = c4_atomic_increment(&match->next_game) - 1) <
+		match->games) {
+		play_game(worker, number);
+		c4_atomic_increment(&match->finished);
+	}
+
+	C4_THREAD_RETURN;
+}
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "c4.h"
+#include "c4simd.h"
+
+#ifdef C4_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+/* This file holds the network evaluation (C4_EVAL_NETWORK): a small      */
+/* multi-layer perceptron, quantized to 8-bit weights, which scores a     */
+/* board for a player.  Its inputs are two planes of the board, one bit   */
+/* per cell: the player's pieces and then the opponent's, cell (x, y)     */
+/* being input x * height + y of each.  There are two hidden layers.      */
+/*                                                                        */
+/* The first layer only has to add up the weights of the occupied cells,  */
+/* which it does in 16-bit accumulators, saturating.  Each hidden layer   */
+/* shifts its sums right, clamps them to 0..127 and passes them on as     */
+/* bytes; the second and third layers multiply them by their weights      */
+/* into 32-bit sums.  The output is the score.  There is a plain C        */
+/* version and an AVX2 version (chosen as in "c4simd.c"), which give      */
+/* exactly the same scores.                                               */
+/*                                                                        */
+/* A network file is little-endian throughout:                            */
+/*                                                                        */
+/*   "C4NN", then version (1), width, height, hidden1, hidden2, shift1    */
+/*   and shift2, as 32-bit integers;                                      */
+/*   bias1[hidden1] as 16-bit integers;                                   */
+/*   weight1[2 * width * height][hidden1] as bytes;                       */
+/*   bias2[hidden2] as 32-bit integers;                                   */
+/*   weight2[hidden2][hidden1] as bytes;                                  */
+/*   bias3 as a 32-bit integer;                                           */
+/*   weight3[hidden2] as bytes.                                           */
+/*                                                                        */
+/* hidden1 must be a multiple of 32.                                      */
+
+#define VERSION      1
+#define MAX_HIDDEN1  256
+#define MAX_HIDDEN2  64
+#define MAX_CELLS    4096
+
+typedef int (*Forward)(const C4_network *net, char **board, int player);
+
+struct C4_network {
+	int width, height;
+	int hidden1, hidden2;
+	int shift1, shift2;
+	int16_t *bias1;         /* The first layer, with its byte weights      */
+	int16_t *weight1;       /* widened to 16 bits, one row of hidden1 per  */
+							/* input.                                      */
+	int32_t *bias2;
+	int8_t *weight2;        /* One row of hidden1 per output.              */
+	int32_t bias3;
+	int8_t weight3[MAX_HIDDEN2];
+	Forward forward;        /* The version of the evaluation to use.       */
+};
+
+static int forward_scalar(const C4_network *net, char **board, int player);
+static bool read_ints(FILE *fp, int size, int count, int32_t *values);
+static int clamp_byte(int value, int shift);
+
+#ifdef C4_X86
+static int forward_avx2(const C4_network *net, char **board, int player);
+#endif
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function loads a network from the file at path.  NULL is         **/
+/**  returned if the file cannot be read or is not a network of a shape    **/
+/**  this file can evaluate.                                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_network *
+c4_network_load(const char *path)
+{
+	FILE *fp;
+	C4_network *net;
+	int32_t header[7], bias1[MAX_HIDDEN1];
+	char magic[4];
+	int8_t *bytes;
+	int inputs, i;
+	bool ok;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, "C4NN", 4) != 0 ||
+		!read_ints(fp, 4, 7, header) || header[0] != VERSION ||
+		header[1] < 1 || header[2] < 1 ||
+		header[1] * header[2] > MAX_CELLS ||
+		header[3] < 32 || header[3] > MAX_HIDDEN1 || header[3] % 32 != 0 ||
+		header[4] < 1 || header[4] > MAX_HIDDEN2 ||
+		header[5] < 0 || header[5] > 15 || header[6] < 0 || header[6] > 30) {
+		fclose(fp);
+		return NULL;
+	}
+
+	net = (C4_network *)malloc(sizeof(C4_network));
+	if (net == NULL) {
+		fprintf(stderr, "c4: c4_network_load() - Can't allocate memory.\n");
+		exit(1);
+	}
+	net->width = header[1];
+	net->height = header[2];
+	net->hidden1 = header[3];
+	net->hidden2 = header[4];
+	net->shift1 = header[5];
+	net->shift2 = header[6];
+	inputs = 2 * net->width * net->height;
+
+	net->bias1 = (int16_t *)malloc(net->hidden1 * sizeof(int16_t));
+	net->weight1 = (int16_t *)malloc(inputs * net->hidden1 * sizeof(int16_t));
+	net->bias2 = (int32_t *)malloc(net->hidden2 * sizeof(int32_t));
+	net->weight2 = (int8_t *)malloc(net->hidden2 * net->hidden1);
+	bytes = (int8_t *)malloc(inputs * net->hidden1);
+	if (net->bias1 == NULL || net->weight1 == NULL || net->bias2 == NULL ||
+		net->weight2 == NULL || bytes == NULL) {
+		fprintf(stderr, "c4: c4_network_load() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	ok = read_ints(fp, 2, net->hidden1, bias1) &&
+		fread(bytes, 1, inputs * net->hidden1, fp) ==
+		(size_t)(inputs * net->hidden1);
+	for (i = 0; i<net->hidden1; i++)
+		net->bias1[i] = (int16_t)bias1[i];
+	for (i = 0; i<inputs * net->hidden1; i++)
+		net->weight1[i] = bytes[i];
+	ok = ok && read_ints(fp, 4, net->hidden2, net->bias2) &&
+		fread(net->weight2, 1, net->hidden2 * net->hidden1, fp) ==
+		(size_t)(net->hidden2 * net->hidden1) &&
+		read_ints(fp, 4, 1, &net->bias3) &&
+		fread(net->weight3, 1, net->hidden2, fp) == (size_t)net->hidden2;
+	free(bytes);
+	fclose(fp);
+
+	if (!ok) {
+		c4_network_free(net);
+		return NULL;
+	}
+
+	net->forward = forward_scalar;
+#ifdef C4_X86
+	{
+		const char *name = getenv("C4_KERNEL");
+		if ((name == NULL || strcmp(name, "avx2") == 0) && c4_cpu_has_avx2())
+			net->forward = forward_avx2;
+	}
+#endif
+
+	return net;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function destroys a network.                                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_network_free(C4_network *net)
+{
+	if (net == NULL)
+		return;
+
+	free(net->bias1);
+	free(net->weight1);
+	free(net->bias2);
+	free(net->weight2);
+	free(net);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns whether a network evaluates boards of the       **/
+/**  given size.                                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_network_fits(const C4_network *net, int width, int height)
+{
+	return net->width == width && net->height == height;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function scores a board (laid out as by c4_board(), and of the   **/
+/**  network's size) for the specified player (0 or 1) with a network.     **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_network_eval(const C4_network *net, char **board, int player)
+{
+	return (*net->forward)(net, board, player);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The plain C version of the evaluation.                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+forward_scalar(const C4_network *net, char **board, int player)
+{
+	int acc1[MAX_HIDDEN1];
+	unsigned char act1[MAX_HIDDEN1], act2[MAX_HIDDEN2];
+	int cells = net->width * net->height;
+	int x, y, h, j, input, sum;
+	const int16_t *row;
+	const int8_t *weights;
+
+	for (h = 0; h<net->hidden1; h++)
+		acc1[h] = net->bias1[h];
+
+	for (x = 0; x<net->width; x++)
+		for (y = 0; y<net->height; y++) {
+			if (board[x][y] == C4_NONE)
+				continue;
+			input = x * net->height + y + ((board[x][y] == player) ? 0 : cells);
+			row = &net->weight1[input * net->hidden1];
+			for (h = 0; h<net->hidden1; h++) {
+				sum = acc1[h] + row[h];
+				acc1[h] = (sum > INT16_MAX) ? INT16_MAX :
+					(sum < INT16_MIN) ? INT16_MIN : sum;
+			}
+		}
+
+	for (h = 0; h<net->hidden1; h++)
+		act1[h] = (unsigned char)clamp_byte(acc1[h], net->shift1);
+
+	for (j = 0; j<net->hidden2; j++) {
+		weights = &net->weight2[j * net->hidden1];
+		sum = net->bias2[j];
+		for (h = 0; h<net->hidden1; h++)
+			sum += act1[h] * weights[h];
+		act2[j] = (unsigned char)clamp_byte(sum, net->shift2);
+	}
+
+	sum = net->bias3;
+	for (j = 0; j<net->hidden2; j++)
+		sum += act2[j] * net->weight3[j];
+	return sum;
+}
+
+
+#ifdef C4_X86
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The AVX2 version of the evaluation.  The first layer is added up 16   **/
+/**  hidden units at a time.  Its outputs are packed down to bytes, which  **/
+/**  interleaves the two halves of each register, so they are put back in  **/
+/**  order with a permute.  The second layer multiplies 32 bytes at a      **/
+/**  time with maddubs, which cannot saturate as the bytes are at most     **/
+/**  127, and widens the products to 32 bits with madd.                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_TARGET("avx2")
+static int
+forward_avx2(const C4_network *net, char **board, int player)
+{
+	__m256i acc1[MAX_HIDDEN1 / 16];
+	unsigned char act1[MAX_HIDDEN1], act2[MAX_HIDDEN2];
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i top = _mm256_set1_epi16(127);
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i top32 = _mm256_set1_epi32(127);
+	const __m128i shift1 = _mm_cvtsi32_si128(net->shift1);
+	const __m128i shift2 = _mm_cvtsi32_si128(net->shift2);
+	int cells = net->width * net->height;
+	int groups = net->hidden1 / 16;
+	int x, y, i, k, j, input, sum, outputs[8];
+	const int16_t *row;
+	const int8_t *weights;
+	__m256i low, high, total, sums[8];
+	__m128i half;
+
+	for (k = 0; k<groups; k++)
+		acc1[k] = _mm256_loadu_si256((const __m256i *)&net->bias1[16 * k]);
+
+	for (x = 0; x<net->width; x++)
+		for (y = 0; y<net->height; y++) {
+			if (board[x][y] == C4_NONE)
+				continue;
+			input = x * net->height + y + ((board[x][y] == player) ? 0 : cells);
+			row = &net->weight1[input * net->hidden1];
+			for (k = 0; k<groups; k++)
+				acc1[k] = _mm256_adds_epi16(acc1[k],
+					_mm256_loadu_si256((const __m256i *)&row[16 * k]));
+		}
+
+	for (k = 0; k<groups; k += 2) {
+		low = _mm256_min_epi16(_mm256_max_epi16(
+			_mm256_sra_epi16(acc1[k], shift1), zero), top);
+		high = _mm256_min_epi16(_mm256_max_epi16(
+			_mm256_sra_epi16(acc1[k + 1], shift1), zero), top);
+		_mm256_storeu_si256((__m256i *)&act1[16 * k], _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(low, high), 0xd8));
+	}
+
+	for (j = 0; j + 8 <= net->hidden2; j += 8) {
+		for (i = 0; i<8; i++) {
+			weights = &net->weight2[(j + i) * net->hidden1];
+			sums[i] = zero;
+			for (k = 0; k<net->hidden1; k += 32)
+				sums[i] = _mm256_add_epi32(sums[i], _mm256_madd_epi16(
+					_mm256_maddubs_epi16(
+						_mm256_loadu_si256((const __m256i *)&act1[k]),
+						_mm256_loadu_si256((const __m256i *)&weights[k])), ones));
+		}
+		low = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[0], sums[1]),
+			_mm256_hadd_epi32(sums[2], sums[3]));
+		high = _mm256_hadd_epi32(_mm256_hadd_epi32(sums[4], sums[5]),
+			_mm256_hadd_epi32(sums[6], sums[7]));
+		total = _mm256_add_epi32(_mm256_permute2x128_si256(low, high, 0x20),
+			_mm256_permute2x128_si256(low, high, 0x31));
+		total = _mm256_add_epi32(total,
+			_mm256_loadu_si256((const __m256i *)&net->bias2[j]));
+		total = _mm256_min_epi32(_mm256_max_epi32(
+			_mm256_sra_epi32(total, shift2), zero), top32);
+		_mm256_storeu_si256((__m256i *)outputs, total);
+		for (i = 0; i<8; i++)
+			act2[j + i] = (unsigned char)outputs[i];
+	}
+
+	for (; j<net->hidden2; j++) {
+		weights = &net->weight2[j * net->hidden1];
+		total = zero;
+		for (k = 0; k<net->hidden1; k += 32)
+			total = _mm256_add_epi32(total, _mm256_madd_epi16(
+				_mm256_maddubs_epi16(
+					_mm256_loadu_si256((const __m256i *)&act1[k]),
+					_mm256_loadu_si256((const __m256i *)&weights[k])), ones));
+		half = _mm_add_epi32(_mm256_castsi256_si128(total),
+			_mm256_extracti128_si256(total, 1));
+		half = _mm_hadd_epi32(half, half);
+		half = _mm_hadd_epi32(half, half);
+		act2[j] = (unsigned char)clamp_byte(net->bias2[j] +
+			_mm_cvtsi128_si32(half), net->shift2);
+	}
+
+	sum = net->bias3;
+	for (j = 0; j<net->hidden2; j++)
+		sum += act2[j] * net->weight3[j];
+	return sum;
+}
+
+#endif /* C4_X86 */
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function reads count little-endian integers of size bytes each   **/
+/**  (2 or 4) from fp into values, sign-extending them.  A value of false  **/
+/**  is returned if the file ends first.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+static bool
+read_ints(FILE *fp, int size, int count, int32_t *values)
+{
+	unsigned char bytes[4];
+	uint32_t value;
+	int i, k;
+
+	for (i = 0; i<count; i++) {
+		if (fread(bytes, 1, size, fp) != (size_t)size)
+			return false;
+		value = 0;
+		for (k = size - 1; k >= 0; k--)
+			value = (value << 8) | bytes[k];
+		if (size == 2)
+			values[i] = (int16_t)(uint16_t)value;
+		else
+			values[i] = (int32_t)value;
+	}
+	return true;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function turns the sum of a hidden unit into its output: the     **/
+/**  sum shifted right, then clamped to 0..127.                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+clamp_byte(int value, int shift)
+{
+	value >>= shift;
+	return (value < 0) ? 0 : (value > 127) ? 127 : value;
+}
@@ -0,0 +1,1502 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "c4.h"
+#include "c4rule.h"
+#include "c4sys.h"
+
+/* This file holds the rules used by apply_rule() to choose a move, and   */
+/* the engine which evaluates them.  Each rule is a set of patterns of    */
+/* cells around an anchor cell, such as "own piece here, opponent's       */
+/* pieces in the next three cells to the right".  Rather than testing     */
+/* the cells around each anchor one at a time, the board is turned into   */
+/* bitboards of own, opponent's and empty cells, and each cell of a       */
+/* pattern is checked at every anchor at once, by shifting the relevant   */
+/* bitboard by the cell's offset and ANDing it into the set of anchors    */
+/* still in the running.  What is left is the set of anchors at which     */
+/* the pattern matches, and its score is added once for each of them.     */
+/*                                                                        */
+/* The rules are written as data which does not depend on the size of     */
+/* the board, and are compiled for each size of board by                  */
+/* c4_rule_table_new().  A bitboard takes as many 64-bit words as the     */
+/* board needs, and there is no limit on the size of the board.           */
+/*                                                                        */
+/* The rules are evaluated for one of the players, whose pieces are the  */
+/* own pieces; the other player's are the opponent's.  Cells off the     */
+/* board match no requirement at all.                                     */
+
+/* What a cell of a pattern must hold.  END marks the end of the cells. */
+
+enum { END, OWN, OPP, EMPTY, NOT_OWN, NOT_OPP, FILLED, NUM_NEEDS };
+
+/* How a row of the rule table relates to the rows before it at the    */
+/* same depth.  The rows read like the if statements they stand for:   */
+/* an IF starts a chain of tests, and the anchors its pattern matches  */
+/* are taken out of the running for the ELSE_IF and ELSE rows which    */
+/* follow it; an OR row adds another pattern to the row just before    */
+/* it.  A row one deeper than the row before it is nested inside that  */
+/* row, and only considers the anchors matched by it.                  */
+
+enum { IF, ELSE_IF, OR, ELSE };
+
+#define MAX_DEPTH 3
+#define MAX_CELLS 7
+
+/* The most words in a bitboard whose evaluation is worked out on the   */
+/* stack (a larger board's bitboards are allocated as it is evaluated), */
+/* and a limit on the number of distinct (offset, need) pairs in the    */
+/* patterns.                                                            */
+
+#define MAX_WORDS 32
+#define MAX_TERMS 128
+
+/* The number of words of bitboards an evaluation works on (see          */
+/* work_space()), for bitboards of n words and a table of t terms.       */
+
+#define WORK_WORDS(n, t) ((NUM_NEEDS + 2 * MAX_DEPTH + (t)) * (n))
+
+/* The most distinct cells the rows of one chain (see below) may use. */
+
+#define MAX_CHAIN_CELLS 16
+
+#define OWN(dx, dy)     { dx, dy, OWN }
+#define OPP(dx, dy)     { dx, dy, OPP }
+#define EMPTY(dx, dy)   { dx, dy, EMPTY }
+#define NOT_OWN(dx, dy) { dx, dy, NOT_OWN }
+#define NOT_OPP(dx, dy) { dx, dy, NOT_OPP }
+#define FILLED(dx, dy)  { dx, dy, FILLED }
+#define NO_CELLS        { { 0, 0, END } }
+
+/* A row of the rule table as written. */
+
+typedef struct {
+	unsigned char rule;     /* The rule (1 to C4_NUM_RULES) it scores for. */
+	unsigned char depth;    /* How deeply the row is nested.               */
+	unsigned char kind;     /* IF, ELSE_IF, OR or ELSE.                    */
+	int score;              /* What each matching anchor adds to the rule. */
+							/* Ignored for OR rows, which add the score    */
+							/* of the row they belong to.                  */
+	signed char x_min;      /* The range of columns and rows the anchor    */
+	signed char x_max;      /* may be in.  A value of 0 or more counts     */
+	signed char y_min;      /* from the left or the bottom of the board,   */
+	signed char y_max;      /* and one below 0 from the right or the top,  */
+							/* -1 being the last column or the top row.    */
+							/* (Anchors which would put a cell of the      */
+							/* pattern off the board are left out anyway,  */
+							/* so most rows leave the whole board open.)   */
+	struct {
+		signed char dx, dy; /* The cell's offset from the anchor.          */
+		unsigned char need; /* What it must hold.                          */
+	} cell[MAX_CELLS];
+} Rule_row;
+
+/* A row of the rule table compiled for a board. */
+
+typedef struct {
+	unsigned char rule;     /* As in Rule_row, with rule counted from 0.   */
+	unsigned char depth;
+	unsigned char kind;
+	unsigned char num_cells;
+	int score;
+	unsigned char term[MAX_CELLS];
+							/* The terms (see below) of the cells.         */
+} Compiled_row;
+
+static const Rule_row rule_rows[] = {
+
+	/* Rule 1: complete a line of four.                                   */
+
+	{ 1, 0, IF,       5000000,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0) } },
+	{ 1, 0, ELSE_IF,  5000000,  0, -1,  0, -1, { OWN(0, 0), OWN(0, 1),
+		OWN(0, 2), OWN(0, 3) } },
+	{ 1, 0, ELSE_IF,  5000000,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3) } },
+	{ 1, 0, ELSE_IF,  5000000,  0, -1,  0, -1, { OWN(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3) } },
+
+	/* Rule 2: block a line of four of the opponent's.                    */
+
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OWN(0, 0), OPP(1, 0),
+		OPP(2, 0), OPP(3, 0) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(4, 0) } },
+	{ 2, 0, IF,        250000,  0, -5,  0, -1, { OPP(0, 0), OPP(1, 0),
+		OPP(2, 0), OWN(3, 0) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(-1, 0) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(1, 0),
+		OWN(2, 0), OPP(3, 0) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 0),
+		OPP(2, 0), OPP(3, 0) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(0, 1),
+		OPP(0, 2), OWN(0, 3) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(0, -1) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OWN(0, 0), OPP(1, 1),
+		OPP(2, 2), OPP(3, 3) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(4, 4) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(1, 1),
+		OPP(2, 2), OWN(3, 3) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(-1, -1) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(1, 1),
+		OWN(2, 2), OPP(3, 3) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 1),
+		OPP(2, 2), OPP(3, 3) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OWN(0, 0), OPP(1, -1),
+		OPP(2, -2), OPP(3, -3) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(1, -1),
+		OPP(2, -2), OWN(3, -3) } },
+	{ 2, 1, IF,        300000,  0, -1,  0, -1, { OWN(-1, 1) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OPP(1, -1),
+		OWN(2, -2), OPP(3, -3) } },
+	{ 2, 0, IF,        250000,  0, -1,  0, -1, { OPP(0, 0), OWN(1, -1),
+		OPP(2, -2), OPP(3, -3) } },
+
+	/* Rule 3: make an open three, with the squares at both ends          */
+	/* playable or nearly so.                                             */
+
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), EMPTY(-1, 0), EMPTY(3, 0) } },
+	{ 3, 1, IF,         10000,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(3, -1) } },
+	{ 3, 1, ELSE_IF,    10000,  0, -1,  0,  0, NO_CELLS },
+	{ 3, 0, IF,             0,  0, -1,  1, -1, { EMPTY(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0), EMPTY(4, 0) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1), FILLED(4, -1) } },
+	{ 3, 1, ELSE_IF,     1000,  0, -1,  0, -1, { FILLED(0, -1), EMPTY(4, 0) } },
+	{ 3, 0, IF,             0,  0, -1,  1, -1, { EMPTY(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0), EMPTY(4, 0) } },
+	{ 3, 1, IF,          2000,  0, -1,  0, -1, { EMPTY(0, -1), EMPTY(4, -1) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0), OPP(4, 0) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 3, 0, IF,             0,  3,  3,  0, -1, { EMPTY(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0), EMPTY(4, 0) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(4, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(4, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 3, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), EMPTY(3, 0) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(3, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(3, -1) } },
+	{ 3, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-1, -1),
+		OWN(1, 1), EMPTY(-2, -2), EMPTY(2, 2) } },
+	{ 3, 1, IF,         10000,  0, -1,  0, -1, { FILLED(-2, -3),
+		FILLED(2, 1) } },
+	{ 3, 1, IF,         10000,  0, -1,  2,  2, { FILLED(2, 1) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3), EMPTY(4, 4) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1), FILLED(4, 3) } },
+	{ 3, 1, ELSE_IF,     1000,  0, -1,  0, -1, { FILLED(0, -1), EMPTY(4, 3) } },
+	{ 3, 1, ELSE_IF,     1000,  0, -1,  0,  0, { EMPTY(4, 3) } },
+	{ 3, 0, IF,             0,  0, -1,  1,  1, { EMPTY(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3), EMPTY(4, 4) } },
+	{ 3, 1, IF,          2000,  0, -1,  0, -1, { EMPTY(0, -1), EMPTY(4, 3) } },
+	{ 3, 0, IF,             0,  0, -1,  1,  1, { EMPTY(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3), OPP(4, 4) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 0, IF,             0,  3,  3,  1, -1, { EMPTY(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3), EMPTY(4, 4) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(4, 3) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(4, 3) } },
+	{ 3, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 1),
+		OWN(2, 2), EMPTY(3, 3) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(3, 2) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(3, 2) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OWN(-1, 1), OWN(0, 0),
+		OWN(1, -1), EMPTY(2, -2), EMPTY(-2, 2) } },
+	{ 3, 1, IF,         10000,  0, -1,  0, -1, { FILLED(2, -3),
+		FILLED(-2, 1) } },
+	{ 3, 1, IF,         10000,  0, -1,  2,  2, { FILLED(-2, 1) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), EMPTY(4, -4) } },
+	{ 3, 1, IF,          1000,  0, -1, -1, -1, { EMPTY(0, -1) } },
+	{ 3, 0, IF,             0,  0, -1, -1, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), EMPTY(4, -4) } },
+	{ 3, 1, IF,          2000,  0, -1,  0, -1, { EMPTY(0, -1), EMPTY(4, -5) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), OPP(4, -4) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 0, IF,             0,  3,  3,  0, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(0, -1) } },
+	{ 3, 0, IF,             0,  0, -1, -1, -1, { OPP(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), EMPTY(4, -4) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(4, -5) } },
+	{ 3, 0, IF,             0,  0,  0,  4, -1, { OWN(0, 0), OWN(1, -1),
+		OWN(2, -2), EMPTY(3, -3) } },
+	{ 3, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(3, -4) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), OPP(4, -4) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 0, IF,             0,  3,  3,  0, -1, { EMPTY(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 3, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), EMPTY(4, -4) } },
+	{ 3, 1, IF,           300,  0, -1, -1, -1, { FILLED(4, -5) } },
+	{ 3, 1, IF,           300,  0, -1, -2, -2, NO_CELLS },
+	{ 3, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, -1),
+		OWN(2, -2), EMPTY(3, -3) } },
+	{ 3, 1, IF,           300,  0, -1,  0, -1, { FILLED(3, -4) } },
+	{ 3, 1, IF,           300,  0, -1, -3, -3, NO_CELLS },
+	{ 3, 0, IF,          -200,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0), OPP(4, 0) } },
+	{ 3, 0, IF,          -200,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), OPP(3, 0) } },
+	{ 3, 0, IF,          -200,  3,  3,  0, -1, { OPP(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(3, 0) } },
+	{ 3, 0, IF,          -200,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3), OPP(4, 4) } },
+	{ 3, 0, IF,          -200,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 1),
+		OWN(2, 2), OPP(3, 3) } },
+	{ 3, 0, IF,          -200,  3,  3,  0, -1, { OPP(0, 0), OWN(1, 1),
+		OWN(2, 2), OWN(3, 3) } },
+	{ 3, 0, IF,          -200,  0, -1,  0, -1, { OPP(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3), OPP(4, -4) } },
+	{ 3, 0, IF,          -200,  0,  0,  0, -1, { OWN(0, 0), OWN(1, -1),
+		OWN(2, -2), OPP(3, -3) } },
+	{ 3, 0, IF,          -200,  3,  3,  0, -1, { OPP(0, 0), OWN(1, -1),
+		OWN(2, -2), OWN(3, -3) } },
+
+	/* Rule 4: stop the opponent from making a three that is open at      */
+	/* both ends.                                                         */
+
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OPP(1, 0),
+		OWN(2, 0), EMPTY(-1, 0), EMPTY(3, 0) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { EMPTY(-1, -1),
+		FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-1, -1),
+		EMPTY(3, -1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  0,  0, NO_CELLS },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(1, 0),
+		OPP(2, 0), EMPTY(-1, 0), EMPTY(3, 0) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { EMPTY(-1, -1),
+		FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-1, -1),
+		EMPTY(3, -1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  0,  0, NO_CELLS },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OWN(1, 0),
+		OPP(2, 0), EMPTY(-1, 0), EMPTY(3, 0) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-1, -1) } },
+	{ 4, 1, OR,             0,  0, -1,  0, -1, { FILLED(3, -1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  0,  0, NO_CELLS },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OPP(-1, -1),
+		OWN(1, 1), EMPTY(-2, -2), EMPTY(2, 2) } },
+	{ 4, 1, IF,             0,  0, -1,  0, -1, { FILLED(-2, -3),
+		FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(2, 1) } },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(0, 0), OWN(-1, -1),
+		OPP(1, 1), EMPTY(-2, -2), EMPTY(2, 2) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(-2, -3),
+		FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(2, 1) } },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(-1, -1),
+		OPP(1, 1), EMPTY(-2, -2), EMPTY(2, 2) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(-2, -3),
+		FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(-2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(2, 1) } },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(-1, 1), OPP(0, 0),
+		OWN(1, -1), EMPTY(2, -2), EMPTY(-2, 2) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(2, -3),
+		FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(-2, 1) } },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OWN(-1, 1), OPP(0, 0),
+		OPP(1, -1), EMPTY(2, -2), EMPTY(-2, 2) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(2, -3),
+		FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(-2, 1) } },
+	{ 4, 0, IF,             0,  0, -1,  0, -1, { OPP(-1, 1), OWN(0, 0),
+		OPP(1, -1), EMPTY(2, -2), EMPTY(-2, 2) } },
+	{ 4, 1, IF,          5000,  0, -1,  0, -1, { FILLED(2, -3),
+		FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  0, -1, { FILLED(2, -3) } },
+	{ 4, 1, OR,             0,  0, -1,  3, -1, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,     5000,  0, -1,  2,  2, { FILLED(-2, 1) } },
+	{ 4, 1, ELSE_IF,      150,  0, -1,  2,  2, { EMPTY(-2, 1) } },
+
+	/* Rule 5: make a "7" shape, two lines of three sharing a piece.      */
+
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-1, 0),
+		OWN(-2, 0), OWN(-1, -1), OWN(-2, -2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(1, 1), OPP(-3, 0) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(1, -1), OWN(2, -2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(-1, 1), OPP(3, 0) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(2, 0), OWN(1, 1), OWN(2, 2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(-1, 0), OPP(3, 3) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-1, 0),
+		OWN(-2, 0), OWN(-1, 1), OWN(-2, 2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(1, 0), OPP(-3, 3) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(-1, 0),
+		OPP(-2, 0), OPP(-1, -1), OPP(-2, -2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(1, 1), OPP(-3, 0) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(1, 0),
+		OPP(2, 0), OPP(1, -1), OPP(2, -2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(-1, 1), OPP(3, 0) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(1, 0),
+		OPP(2, 0), OPP(1, 1), OPP(2, 2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(-1, 0), OPP(3, 3) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+	{ 5, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OPP(-1, 0),
+		OPP(-2, 0), OPP(-1, 1), OPP(-2, 2) } },
+	{ 5, 1, IF,          -100,  0, -1,  0, -1, { OPP(1, 0), OPP(-3, 3) } },
+	{ 5, 1, ELSE,        2000,  0, -1,  0, -1, NO_CELLS },
+
+	/* Rule 6: avoid letting the opponent complete a four on the square   */
+	/* right above an own piece.                                          */
+
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-3, 1), OPP(-2, 1),
+		OPP(-1, 1), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(1, 1), OPP(2, 1),
+		OPP(3, 1), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-1, 1), OWN(0, 0),
+		OPP(1, 1), OPP(2, 1), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-2, 1), OPP(-1, 1),
+		OWN(0, 0), OPP(1, 1), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-3, 4), OPP(-2, 3),
+		OPP(-1, 2), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(1, 0), OPP(2, -1),
+		OPP(3, -2), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-1, 2), OWN(0, 0),
+		OPP(1, 0), OPP(2, -1), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-2, 3), OPP(-1, 2),
+		OWN(0, 0), OPP(1, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(1, 2), OPP(2, 3),
+		OPP(3, 4), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-3, -2), OPP(-2, -1),
+		OPP(-1, 0), OWN(0, 0), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-1, 0), OWN(0, 0),
+		OPP(1, 2), OPP(2, 3), EMPTY(0, 1) } },
+	{ 6, 0, IF,        -10000,  0, -1,  0, -1, { OPP(-2, -1), OPP(-1, 0),
+		OWN(0, 0), OPP(1, 2), EMPTY(0, 1) } },
+
+	/* Rule 7: extend a line of two into a line of three.                 */
+
+	{ 7, 0, IF,             0,  3,  3,  0, -1, { OWN(0, 0), OWN(-2, 0),
+		OWN(2, 0), OWN(-3, 0), OWN(3, 0), EMPTY(-1, 0), EMPTY(1, 0) } },
+	{ 7, 1, IF,         10000,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(1, -1) } },
+	{ 7, 1, ELSE_IF,    10000,  0, -1,  0,  0, NO_CELLS },
+	{ 7, 1, ELSE_IF,     1000,  0, -1,  0, -1, { EMPTY(-1, -1), EMPTY(1, -1) } },
+	{ 7, 1, ELSE_IF,      500,  0, -1,  0, -1, { FILLED(-1, -1) } },
+	{ 7, 1, OR,             0,  0, -1,  0, -1, { FILLED(1, -1) } },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-2, 0),
+		OWN(2, 0), EMPTY(-1, 0), EMPTY(1, 0) } },
+	{ 7, 1, IF,           200,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(1, -1) } },
+	{ 7, 1, IF,           200,  0, -1,  0,  0, NO_CELLS },
+	{ 7, 1, ELSE_IF,      150,  0, -1,  0, -1, { EMPTY(-1, -1), EMPTY(1, -1) } },
+	{ 7, 1, ELSE_IF,      100,  0, -1,  0, -1, { FILLED(-1, -1) } },
+	{ 7, 1, OR,             0,  0, -1,  0, -1, { FILLED(1, -1) } },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-2, -2),
+		OWN(2, 2), EMPTY(-1, -1), EMPTY(1, 1) } },
+	{ 7, 1, IF,           200,  0, -1,  0, -1, { FILLED(-1, -2),
+		FILLED(1, 0) } },
+	{ 7, 1, ELSE_IF,      150,  0, -1,  0, -1, { EMPTY(-1, -2), EMPTY(1, 0) } },
+	{ 7, 1, ELSE_IF,      100,  0, -1,  0, -1, { FILLED(-1, -2) } },
+	{ 7, 1, OR,             0,  0, -1,  0, -1, { FILLED(1, 0) } },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-2, 2),
+		OWN(2, -2), EMPTY(-1, 1), EMPTY(1, -1) } },
+	{ 7, 1, IF,           200,  0, -1,  0, -1, { FILLED(-1, 0),
+		FILLED(1, -2) } },
+	{ 7, 1, ELSE_IF,      150,  0, -1,  0, -1, { EMPTY(-1, 0), EMPTY(1, -2) } },
+	{ 7, 1, ELSE_IF,      100,  0, -1,  0, -1, { FILLED(-1, 0) } },
+	{ 7, 1, OR,             0,  0, -1,  0, -1, { FILLED(1, -2) } },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(2, 0),
+		EMPTY(-1, 0), EMPTY(1, 0), EMPTY(3, 0) } },
+	{ 7, 1, IF,           150,  0, -1,  0, -1, { FILLED(1, -1) } },
+	{ 7, 1, ELSE_IF,      150,  0, -1,  0,  0, NO_CELLS },
+	{ 7, 1, ELSE,         200,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), EMPTY(-2, -2),
+		EMPTY(2, 2), OWN(-1, -1), OWN(1, 1) } },
+	{ 7, 1, IF,           150,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 7, 1, ELSE,         200,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { EMPTY(0, 0), EMPTY(-2, 2),
+		EMPTY(2, -2), OWN(-1, 1), OWN(1, -1) } },
+	{ 7, 1, IF,           150,  0, -1,  0, -1, { FILLED(0, -1) } },
+	{ 7, 1, ELSE,         200,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(-2, 0),
+		OWN(-3, 0), EMPTY(-1, 0) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(-1, -1) } },
+	{ 7, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 1),
+		EMPTY(2, 2), OWN(3, 3) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(2, 1) } },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, -1),
+		EMPTY(2, -2), OWN(3, -3) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(2, -3) } },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  4, -1,  0, -1, { OWN(0, 0), EMPTY(-2, 0),
+		OWN(-3, 0), OWN(-1, 0) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(-2, -1) } },
+	{ 7, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), EMPTY(1, 1),
+		OWN(2, 2), OWN(3, 3) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(1, 0) } },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+	{ 7, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), EMPTY(1, -1),
+		OWN(2, -2), OWN(3, -3) } },
+	{ 7, 1, IF,           300,  0, -1,  0, -1, { FILLED(1, -2) } },
+	{ 7, 1, ELSE,        1000,  0, -1,  0, -1, NO_CELLS },
+
+	/* Rule 8: small bonuses and penalties for twos, and split twos with  */
+	/* a gap between them.                                                */
+
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OWN(3, 0), EMPTY(2, 0) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(2, -1) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(2, -1) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, -1),
+		OWN(3, -3), EMPTY(2, -2) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(2, -3) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(2, -3) } },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 1),
+		OWN(3, 3), EMPTY(2, 2) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(2, 1) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(2, 1) } },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), EMPTY(1, 0),
+		OWN(3, 0), OWN(2, 0) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(1, -1) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(1, -1) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0,  0, NO_CELLS },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), EMPTY(1, -1),
+		OWN(3, -3), OWN(2, -2) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(1, -2) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(1, -2) } },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), EMPTY(1, 1),
+		OWN(3, 3), OWN(2, 2) } },
+	{ 8, 1, IF,          1000,  0, -1,  0, -1, { EMPTY(1, 0) } },
+	{ 8, 1, ELSE_IF,      300,  0, -1,  0, -1, { FILLED(1, 0) } },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		EMPTY(-1, 0), EMPTY(2, 0) } },
+	{ 8, 1, IF,           150,  0, -1,  0, -1, { EMPTY(-1, -1), EMPTY(2, -1) } },
+	{ 8, 1, ELSE_IF,      100,  0, -1,  0, -1, { EMPTY(-1, -1),
+		FILLED(2, -1) } },
+	{ 8, 1, OR,             0,  0, -1,  0, -1, { FILLED(-1, -1), EMPTY(2, 0) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  0, -1, { FILLED(-1, -1),
+		FILLED(2, -1) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  0,  0, NO_CELLS },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, -1),
+		EMPTY(-1, 1), EMPTY(2, -2) } },
+	{ 8, 1, IF,           150,  0, -1,  0, -1, { EMPTY(-1, 0), EMPTY(2, -3) } },
+	{ 8, 1, ELSE_IF,      100,  0, -1,  0, -1, { EMPTY(-1, 0), FILLED(2, -3) } },
+	{ 8, 1, OR,             0,  0, -1,  0, -1, { FILLED(-1, 0), EMPTY(2, -3) } },
+	{ 8, 1, ELSE_IF,      100,  0, -1,  2,  2, { EMPTY(-1, 0) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  0, -1, { FILLED(-1, 0),
+		FILLED(2, -3) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  2,  2, { FILLED(-1, 0) } },
+	{ 8, 0, IF,             0,  0, -1,  0, -1, { OWN(0, 0), OWN(1, 1),
+		EMPTY(-1, -1), EMPTY(2, 2) } },
+	{ 8, 1, IF,           150,  0, -1,  0, -1, { EMPTY(-1, -2), EMPTY(2, 1) } },
+	{ 8, 1, ELSE_IF,      100,  0, -1,  0, -1, { EMPTY(-1, -2), FILLED(2, 1) } },
+	{ 8, 1, OR,             0,  0, -1,  0, -1, { FILLED(-1, -2), EMPTY(2, 1) } },
+	{ 8, 1, ELSE_IF,      100,  0, -1,  1,  1, { EMPTY(2, 1) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  0, -1, { FILLED(-1, -2),
+		FILLED(2, 1) } },
+	{ 8, 1, ELSE_IF,       50,  0, -1,  1,  1, { FILLED(2, 1) } },
+	{ 8, 0, IF,             0,  0, -3,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OPP(-1, 0) } },
+	{ 8, 0, OR,             0,  1, -1,  0, -1, { OWN(0, 0), OWN(1, 0),
+		OPP(2, 0) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, 0), OPP(2, 0) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 0) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(2, 0) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0, -2, -2,  0, -1, { OWN(0, 0), OWN(1, 0) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, 0) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0,  0, -3,  2, -1, { OWN(0, 0), OWN(1, -1),
+		OPP(-1, 1) } },
+	{ 8, 0, OR,             0,  1, -1,  0, -2, { OWN(0, 0), OWN(1, -1),
+		OPP(2, -2) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, 1), OPP(2, -2) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, -1) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(2, -2) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0, -2, -2,  0, -1, { OWN(0, 0), OWN(1, -1) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, 1) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0,  0, -3,  0, -3, { OWN(0, 0), OWN(1, 1),
+		OPP(-1, -1) } },
+	{ 8, 0, OR,             0,  1, -1,  1, -1, { OWN(0, 0), OWN(1, 1),
+		OPP(2, 2) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, -1), OPP(2, 2) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0,  0,  0,  0, -1, { OWN(0, 0), OWN(1, 1) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(2, 2) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,             0, -2, -2,  0, -1, { OWN(0, 0), OWN(1, 1) } },
+	{ 8, 1, IF,             5,  0, -1,  0, -1, { OPP(-1, -1) } },
+	{ 8, 1, ELSE,          10,  0, -1,  0, -1, NO_CELLS },
+	{ 8, 0, IF,            10,  0, -1,  0, -1, { OWN(0, 0), OWN(0, -1),
+		EMPTY(0, 1) } },
+};
+
+#define NUM_ROWS (int)(sizeof(rule_rows) / sizeof(rule_rows[0]))
+
+/* A chain of rows: an IF at depth 0 and all the rows up to the next     */
+/* one.  No row of a chain looks at the anchors matched by another       */
+/* chain, so the score of a chain at an anchor depends only on the       */
+/* anchor and on the cells at the offsets its rows use, which are        */
+/* listed here, each with the last row to use it.                        */
+
+typedef struct {
+	short first_row;
+	short num_rows;
+	int num_cells;
+	signed char dx[MAX_CHAIN_CELLS];
+	signed char dy[MAX_CHAIN_CELLS];
+	short last_row[MAX_CHAIN_CELLS];
+} Chain;
+
+/* The values of a cell (0, 1 or C4_NONE) which meet each need, as     */
+/* bits, when the own pieces are player 0's and when they are player    */
+/* 1's.                                                                  */
+
+static const unsigned char need_values[2][NUM_NEEDS] = {
+	{ 0, 1 << 0, 1 << 1, 1 << C4_NONE, 1 << 1 | 1 << C4_NONE,
+		1 << 0 | 1 << C4_NONE, 1 << 0 | 1 << 1 },
+	{ 0, 1 << 1, 1 << 0, 1 << C4_NONE, 1 << 0 | 1 << C4_NONE,
+		1 << 1 | 1 << C4_NONE, 1 << 0 | 1 << 1 }
+};
+
+/* The rules compiled for a board.  Cell (x, y) of the board is bit      */
+/* x * height + y of a bitboard, counting from bit 0 of word 0.  A term  */
+/* is a cell offset and a need shared by any number of rows; the        */
+/* bitboard of each term is worked out once per evaluation.             */
+
+struct C4_rule_table {
+	int width, height;
+	int num_words;          /* The number of words in a bitboard.          */
+	int num_terms;
+	int term_offset[MAX_TERMS];
+							/* The bit offset of each term from the anchor */
+	unsigned char term_need[MAX_TERMS];
+							/* and what its cell must hold.                */
+	uint64_t *on_board;     /* The cells of the board.                     */
+	uint64_t *anchors;      /* The anchors row r may match at are words    */
+							/* r * num_words onwards.                      */
+	Compiled_row row[NUM_ROWS];
+	int num_chains;
+	Chain chain[NUM_ROWS];
+};
+
+static uint64_t *work_space(const C4_rule_table *table,
+	uint64_t *stack_work);
+static void make_sets(const C4_rule_table *table, char **board, int own,
+	uint64_t *set);
+static int walk_rows(const C4_rule_table *table, uint64_t *work,
+	int rule_score[C4_NUM_RULES], C4_rule_stats *stats);
+static C4_ALWAYS_INLINE int walk_word(const C4_rule_table *table,
+	uint64_t *work, int rule_score[C4_NUM_RULES], C4_rule_stats *stats);
+static C4_ALWAYS_INLINE int walk_words(const C4_rule_table *table,
+	uint64_t *work, int rule_score[C4_NUM_RULES], C4_rule_stats *stats);
+static uint64_t charge(C4_rule_stats *stats, int rule, uint64_t then);
+static int edge_relative(int value, int size);
+static void shift_bitboard(uint64_t *dst, const uint64_t *src, int offset,
+	int num_words);
+static void add_chain_cells(Chain *chain, int row);
+static void add_drop(const C4_rule_table *table, char **board, int own,
+	int x, int y, int piece, int rule_score[C4_NUM_RULES]);
+static void score_anchor(const C4_rule_table *table, const Chain *chain,
+	int last_row, char **board, int own, int x, int y, int piece_x,
+	int piece_y, int piece, int rule_score[C4_NUM_RULES]);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function compiles the rule table for a board of the given size.  **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_rule_table *
+c4_rule_table_new(int width, int height)
+{
+	C4_rule_table *table;
+	const Rule_row *src;
+	Compiled_row *dst;
+	uint64_t *anchors;
+	int i, k, t, x, y, offset, bit;
+	int x_min, x_max, y_min, y_max;
+	bool fits;
+
+	table = (C4_rule_table *)malloc(sizeof(C4_rule_table));
+	if (table != NULL)
+		table->anchors = (uint64_t *)calloc(
+			(NUM_ROWS + 1) * ((width * height + 63) / 64), sizeof(uint64_t));
+	if (table == NULL || table->anchors == NULL) {
+		fprintf(stderr, "c4: c4_rule_table_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	table->width = width;
+	table->height = height;
+	table->num_words = (width * height + 63) / 64;
+	table->num_terms = 0;
+	table->num_chains = 0;
+
+	table->on_board = &table->anchors[NUM_ROWS * table->num_words];
+	for (bit = 0; bit<width * height; bit++)
+		table->on_board[bit / 64] |= (uint64_t)1 << (bit % 64);
+
+	for (i = 0; i<NUM_ROWS; i++) {
+		src = &rule_rows[i];
+		dst = &table->row[i];
+		dst->rule = src->rule - 1;
+		dst->depth = src->depth;
+		dst->kind = src->kind;
+		dst->score = src->score;
+
+		/* Find the term of each cell, adding it if it is new. */
+
+		for (k = 0; k<MAX_CELLS && src->cell[k].need != END; k++) {
+			offset = src->cell[k].dx * height + src->cell[k].dy;
+			for (t = 0; t<table->num_terms; t++)
+				if (table->term_offset[t] == offset &&
+					table->term_need[t] == src->cell[k].need)
+					break;
+			if (t == table->num_terms) {
+				assert(t < MAX_TERMS);
+				table->term_offset[t] = offset;
+				table->term_need[t] = src->cell[k].need;
+				table->num_terms++;
+			}
+			dst->term[k] = t;
+		}
+		dst->num_cells = k;
+
+		/* Start a new chain at an IF at depth 0, and note the cells. */
+
+		if (src->depth == 0 && src->kind == IF) {
+			table->chain[table->num_chains].first_row = i;
+			table->chain[table->num_chains].num_rows = 0;
+			table->chain[table->num_chains].num_cells = 0;
+			table->num_chains++;
+		}
+		assert(table->num_chains > 0);
+		table->chain[table->num_chains - 1].num_rows++;
+		add_chain_cells(&table->chain[table->num_chains - 1], i);
+
+		/* Work out the anchors. */
+
+		x_min = edge_relative(src->x_min, width);
+		x_max = edge_relative(src->x_max, width);
+		y_min = edge_relative(src->y_min, height);
+		y_max = edge_relative(src->y_max, height);
+		anchors = &table->anchors[i * table->num_words];
+
+		for (x = (x_min > 0) ? x_min : 0; x <= x_max && x<width; x++)
+			for (y = (y_min > 0) ? y_min : 0; y <= y_max && y<height; y++) {
+				fits = true;
+				for (k = 0; k<dst->num_cells; k++)
+					if (x + src->cell[k].dx < 0 || x + src->cell[k].dx >= width ||
+						y + src->cell[k].dy < 0 || y + src->cell[k].dy >= height)
+						fits = false;
+				if (fits) {
+					bit = x * height + y;
+					anchors[bit / 64] |= (uint64_t)1 << (bit % 64);
+				}
+			}
+	}
+
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees a table made by c4_rule_table_new().              **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_rule_table_free(C4_rule_table *table)
+{
+	free(table->anchors);
+	free(table);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of bytes the table made by           **/
+/**  c4_rule_table_new() of a width by height board takes up.  It can be   **/
+/**  known before the table is made.                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+size_t
+c4_rule_table_size(int width, int height)
+{
+	return sizeof(C4_rule_table) +
+		(NUM_ROWS + 1) * ((width * height + 63) / 64) * sizeof(uint64_t);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function evaluates the rules on the given board for player own   **/
+/**  (0 or 1).  The score of each rule is stored in rule_score[], and the  **/
+/**  sum of them is returned.                                              **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_rule_eval(const C4_rule_table *table, char **board, int own,
+	int rule_score[C4_NUM_RULES])
+{
+	uint64_t stack_work[WORK_WORDS(MAX_WORDS, MAX_TERMS)];
+	uint64_t *work = work_space(table, stack_work);
+	int total;
+
+	make_sets(table, board, own, work);
+	total = walk_rows(table, work, rule_score, NULL);
+	if (work != stack_work)
+		free(work);
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function is c4_rule_eval(), but adds what it finds and the time  **/
+/**  it takes to stats.                                                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_rule_profile(const C4_rule_table *table, char **board, int own,
+	int rule_score[C4_NUM_RULES], C4_rule_stats *stats)
+{
+	uint64_t stack_work[WORK_WORDS(MAX_WORDS, MAX_TERMS)];
+	uint64_t *work = work_space(table, stack_work);
+	uint64_t start = c4_cycles();
+	int total;
+
+	make_sets(table, board, own, work);
+	stats->setup_cycles += c4_cycles() - start;
+	total = walk_rows(table, work, rule_score, stats);
+	if (work != stack_work)
+		free(work);
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns whether c4_rule_update() does less work on the  **/
+/**  boards of a table than c4_rule_eval() does.                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_rule_incremental(const C4_rule_table *table)
+{
+	return table->num_words > 1;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function brings the scores of the rules for player own up to     **/
+/**  date after a piece has been dropped at column x, row y of the board.  **/
+/**  rule_score[] must hold the scores, as worked out by c4_rule_eval(),   **/
+/**  of the board as it was before (with the cell empty).  The sum of the  **/
+/**  new scores is returned.                                               **/
+/**                                                                        **/
+/**  Only the anchors from which a row can see the cell are looked at: for **/
+/**  each chain, the cell less each of the offsets the chain uses.  The    **/
+/**  work done is therefore a matter of the size of the patterns, not of   **/
+/**  the board.  On a board which fits in one word, though, walk_word()    **/
+/**  tries every anchor at once in less time than that, so the board is    **/
+/**  evaluated afresh instead.                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+int
+c4_rule_update(const C4_rule_table *table, char **board, int own, int x,
+	int y, int rule_score[C4_NUM_RULES])
+{
+	int k, total = 0;
+
+	if (!c4_rule_incremental(table))
+		return c4_rule_eval(table, board, own, rule_score);
+
+	add_drop(table, board, own, x, y, board[x][y], rule_score);
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		total += rule_score[k];
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function scores the rules for player own on each of the boards   **/
+/**  which follow the given one when a piece of player piece is dropped in **/
+/**  one of its columns.  drops[x] is filled in for the drop in column x,  **/
+/**  and has a row of -1 if the column is full.  The board itself is left  **/
+/**  alone.                                                                **/
+/**                                                                        **/
+/**  The boards differ from the given one in a single cell.  On a board    **/
+/**  which fits in one word, the bitboards of the given board are made     **/
+/**  once and each drop only sets or clears its bit in them.  On a larger  **/
+/**  one, each drop is scored as c4_rule_update() would, from the scores   **/
+/**  of the given board: score is those scores, or NULL if they are not    **/
+/**  known, in which case they are worked out.                             **/
+/**                                                                        **/
+/**  If stats is not NULL, each drop is evaluated in full, whatever the    **/
+/**  size of the board, and what is found is added to stats.               **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_rule_eval_drops(const C4_rule_table *table, char **board, int own,
+	int piece, const int score[C4_NUM_RULES], C4_rule_drop drops[],
+	C4_rule_stats *stats)
+{
+	uint64_t stack_work[WORK_WORDS(MAX_WORDS, MAX_TERMS)];
+	uint64_t *set = NULL, saved[NUM_NEEDS], bit;
+	int parent_score[C4_NUM_RULES];
+	int n = table->num_words;
+	int x, y, k, w;
+	bool incremental = stats == NULL && c4_rule_incremental(table);
+	uint64_t start = 0;
+	C4_rule_drop *drop;
+
+	if (incremental) {
+		if (score == NULL) {
+			c4_rule_eval(table, board, own, parent_score);
+			score = parent_score;
+		}
+	}
+	else {
+		if (stats != NULL)
+			start = c4_cycles();
+		set = work_space(table, stack_work);
+		make_sets(table, board, own, set);
+		if (stats != NULL)
+			stats->setup_cycles += c4_cycles() - start;
+	}
+
+	for (x = 0; x<table->width; x++) {
+		drop = &drops[x];
+		for (y = 0; y<table->height && board[x][y] != C4_NONE; y++)
+			;
+		drop->row = (y < table->height) ? y : -1;
+		drop->total = 0;
+		drop->num_fired = 0;
+		if (drop->row < 0)
+			continue;
+
+		if (incremental) {
+			memcpy(drop->rule_score, score, sizeof(drop->rule_score));
+			add_drop(table, board, own, x, y, piece, drop->rule_score);
+		}
+		else {
+			w = (x * table->height + y) / 64;
+			bit = (uint64_t)1 << ((x * table->height + y) % 64);
+			for (k = 0; k<NUM_NEEDS; k++)
+				saved[k] = set[k * n + w];
+			set[((piece == own) ? OWN : OPP) * n + w] |= bit;
+			set[((piece == own) ? NOT_OWN : NOT_OPP) * n + w] &= ~bit;
+			set[FILLED * n + w] |= bit;
+			set[EMPTY * n + w] &= ~bit;
+			walk_rows(table, set, drop->rule_score, stats);
+			for (k = 0; k<NUM_NEEDS; k++)
+				set[k * n + w] = saved[k];
+		}
+
+		for (k = 0; k<C4_NUM_RULES; k++) {
+			drop->total += drop->rule_score[k];
+			if (drop->rule_score[k] != 0)
+				drop->fired[drop->num_fired++] = k + 1;
+		}
+	}
+
+	if (set != NULL && set != stack_work)
+		free(set);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds the move chosen by apply_rule(), the drop given,   **/
+/**  to stats.                                                             **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_rule_stats_add_move(C4_rule_stats *stats, const C4_rule_drop *drop)
+{
+	int k;
+
+	stats->moves++;
+	for (k = 0; k<C4_NUM_RULES; k++) {
+		if (drop->rule_score[k] != 0)
+			stats->chosen_fired[k]++;
+		stats->chosen_score[k] += drop->rule_score[k];
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function clears stats, ready to be profiled into.                **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_rule_stats_clear(C4_rule_stats *stats)
+{
+	memset(stats, 0, sizeof(C4_rule_stats));
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function writes stats to fp as a JSON object.  Each rule (now    **/
+/**  numbered from 1, as apply_rule() reports them) also has its share of  **/
+/**  the time spent on rows, and its cycles per evaluation.                **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_rule_stats_write_json(const C4_rule_stats *stats, FILE *fp)
+{
+	long long row_cycles = 0;
+	long evaluations = (stats->evaluations > 0) ? stats->evaluations : 1;
+	int k;
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		row_cycles += stats->cycles[k];
+	if (row_cycles == 0)
+		row_cycles = 1;
+
+	fprintf(fp, "{\n  \"evaluations\": %ld,\n  \"setup_cycles\": %lld,\n"
+		"  \"moves\": %ld,\n  \"rules\": [\n", stats->evaluations,
+		stats->setup_cycles, stats->moves);
+	for (k = 0; k<C4_NUM_RULES; k++)
+		fprintf(fp, "    { \"rule\": %d, \"fired\": %ld, \"matches\": %lld, "
+			"\"cycles\": %lld, \"cycles_per_evaluation\": %.1f, "
+			"\"cycle_share\": %.4f, \"chosen_fired\": %ld, "
+			"\"chosen_score\": %lld }%s\n", k + 1, stats->fired[k],
+			stats->matches[k], stats->cycles[k],
+			(double)stats->cycles[k] / evaluations,
+			(double)stats->cycles[k] / row_cycles, stats->chosen_fired[k],
+			stats->chosen_score[k], (k < C4_NUM_RULES - 1) ? "," : "");
+	fprintf(fp, "  ]\n}\n");
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns room for the bitboards an evaluation on the     **/
+/**  boards of a table works on.  They are, each num_words words long:     **/
+/**  the sets of cells which meet each need, made by make_sets(); then,    **/
+/**  for walk_words(), the anchors matched and left at each depth, and     **/
+/**  the bitboard of each term.  stack_work is used if the board is small  **/
+/**  enough for it to hold them; otherwise the room is allocated, and must **/
+/**  be freed by the caller.                                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+static uint64_t *
+work_space(const C4_rule_table *table, uint64_t *stack_work)
+{
+	uint64_t *work;
+
+	if (table->num_words <= MAX_WORDS)
+		return stack_work;
+
+	work = (uint64_t *)malloc(WORK_WORDS(table->num_words, table->num_terms) *
+		sizeof(uint64_t));
+	if (work == NULL) {
+		fprintf(stderr, "c4: work_space() - Can't allocate memory.\n");
+		exit(1);
+	}
+	return work;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes the bitboards of the cells of a board which meet  **/
+/**  each need, for player own.  Need k's bitboard is words k * num_words  **/
+/**  onwards of set.                                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+make_sets(const C4_rule_table *table, char **board, int own, uint64_t *set)
+{
+	int n = table->num_words;
+	uint64_t *own_set = &set[OWN * n], *opp_set = &set[OPP * n];
+	int w, x, y;
+	unsigned int bit;
+
+	memset(own_set, 0, n * sizeof(uint64_t));
+	memset(opp_set, 0, n * sizeof(uint64_t));
+	for (x = 0; x<table->width; x++)
+		for (y = 0; y<table->height; y++) {
+			bit = x * table->height + y;
+			if (board[x][y] == own)
+				own_set[bit / 64] |= (uint64_t)1 << (bit % 64);
+			else if (board[x][y] == (own ^ 1))
+				opp_set[bit / 64] |= (uint64_t)1 << (bit % 64);
+		}
+	for (w = 0; w<n; w++) {
+		set[FILLED * n + w] = own_set[w] | opp_set[w];
+		set[EMPTY * n + w] = table->on_board[w] & ~set[FILLED * n + w];
+		set[NOT_OWN * n + w] = table->on_board[w] & ~own_set[w];
+		set[NOT_OPP * n + w] = table->on_board[w] & ~opp_set[w];
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function evaluates the rules given work, the room returned by    **/
+/**  work_space() with the bitboards made by make_sets() at the start of   **/
+/**  it, storing the score of each rule in rule_score[] and returning the  **/
+/**  sum of them.  If stats is not NULL, what is found and the time taken  **/
+/**  are added to it.                                                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+walk_rows(const C4_rule_table *table, uint64_t *work,
+	int rule_score[C4_NUM_RULES], C4_rule_stats *stats)
+{
+	int k, total;
+
+	/* The walks are inlined, so the unprofiled ones have no stats code. */
+
+	if (table->num_words == 1 && stats == NULL)
+		total = walk_word(table, work, rule_score, NULL);
+	else if (table->num_words == 1)
+		total = walk_word(table, work, rule_score, stats);
+	else if (stats == NULL)
+		total = walk_words(table, work, rule_score, NULL);
+	else
+		total = walk_words(table, work, rule_score, stats);
+
+	if (stats != NULL) {
+		stats->evaluations++;
+		for (k = 0; k<C4_NUM_RULES; k++)
+			if (rule_score[k] != 0)
+				stats->fired[k]++;
+	}
+
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function does the work of walk_rows() for a board which fits in  **/
+/**  one word.                                                             **/
+/**                                                                        **/
+/**  The rows are taken in order.  match[d] is the set of anchors matched  **/
+/**  by the open row at depth d so far, and left[d] the set which the rows **/
+/**  of its chain have not yet matched.  A row is closed, and its score    **/
+/**  added, when the next row at the same depth or above comes along.      **/
+/**                                                                        **/
+/**  When profiling, the time since the last change of rule is charged to  **/
+/**  the rule of the rows before, and the time before the first row to     **/
+/**  making the bitboards.                                                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+static C4_ALWAYS_INLINE int
+walk_word(const C4_rule_table *table, uint64_t *work,
+	int rule_score[C4_NUM_RULES], C4_rule_stats *stats)
+{
+	uint64_t term[MAX_TERMS];
+	uint64_t match[MAX_DEPTH], left[MAX_DEPTH], m, then = 0;
+	const Compiled_row *row, *open_row[MAX_DEPTH];
+	const Compiled_row *end = table->row + NUM_ROWS;
+	int open = -1, d, k, count, rule = -1, total = 0;
+
+	if (stats != NULL)
+		then = c4_cycles();
+
+	/* A term a whole word or more away is off the board from every */
+	/* anchor, and no row which uses it has any anchors.              */
+
+	for (k = 0; k<table->num_terms; k++)
+		if (table->term_offset[k] >= 64 || table->term_offset[k] <= -64)
+			term[k] = 0;
+		else if (table->term_offset[k] >= 0)
+			term[k] = work[table->term_need[k]] >> table->term_offset[k];
+		else
+			term[k] = work[table->term_need[k]] << -table->term_offset[k];
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		rule_score[k] = 0;
+
+	for (row = table->row; row <= end; row++) {
+		d = (row < end) ? row->depth : 0;
+
+		/* Close the rows this one follows, unless it is an OR. */
+
+		if (row == end || row->kind != OR) {
+			for (; open >= d; open--)
+				if (match[open]) {
+					count = c4_popcount64(match[open]);
+					rule_score[open_row[open]->rule] +=
+						open_row[open]->score * count;
+					if (stats != NULL)
+						stats->matches[open_row[open]->rule] += count;
+					left[open] &= ~match[open];
+				}
+			if (stats != NULL && (row == end || row->rule != rule)) {
+				then = charge(stats, rule, then);
+				rule = (row < end) ? row->rule : -1;
+			}
+			if (row == end)
+				break;
+			if (row->kind == IF)
+				left[d] = (d == 0) ? table->on_board[0] : match[d - 1];
+			match[d] = 0;
+			open_row[d] = row;
+			open = d;
+		}
+
+		m = table->anchors[row - table->row] & left[d];
+		for (k = 0; k<row->num_cells; k++)
+			m &= term[row->term[k]];
+		match[d] |= m;
+	}
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		total += rule_score[k];
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function does the work of walk_rows() for a board of more than   **/
+/**  one word, in the same way as walk_word().  match[d] and left[d] are   **/
+/**  bitboards, words d * num_words onwards.                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+static C4_ALWAYS_INLINE int
+walk_words(const C4_rule_table *table, uint64_t *work,
+	int rule_score[C4_NUM_RULES], C4_rule_stats *stats)
+{
+	int n = table->num_words;
+	uint64_t *match = &work[NUM_NEEDS * n];
+	uint64_t *left = &match[MAX_DEPTH * n];
+	uint64_t *term = &left[MAX_DEPTH * n];
+	const uint64_t *anchors;
+	uint64_t m, then = 0;
+	const Compiled_row *row, *open_row[MAX_DEPTH];
+	const Compiled_row *end = table->row + NUM_ROWS;
+	int open = -1, d, k, w, count, rule = -1, total = 0;
+
+	if (stats != NULL)
+		then = c4_cycles();
+
+	for (k = 0; k<table->num_terms; k++)
+		shift_bitboard(&term[k * n], &work[table->term_need[k] * n],
+			table->term_offset[k], n);
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		rule_score[k] = 0;
+
+	for (row = table->row; row <= end; row++) {
+		d = (row < end) ? row->depth : 0;
+
+		/* Close the rows this one follows, unless it is an OR. */
+
+		if (row == end || row->kind != OR) {
+			for (; open >= d; open--) {
+				count = 0;
+				for (w = 0; w<n; w++) {
+					count += c4_popcount64(match[open * n + w]);
+					left[open * n + w] &= ~match[open * n + w];
+				}
+				rule_score[open_row[open]->rule] += open_row[open]->score * count;
+				if (stats != NULL)
+					stats->matches[open_row[open]->rule] += count;
+			}
+			if (stats != NULL && (row == end || row->rule != rule)) {
+				then = charge(stats, rule, then);
+				rule = (row < end) ? row->rule : -1;
+			}
+			if (row == end)
+				break;
+			for (w = 0; w<n; w++) {
+				if (row->kind == IF)
+					left[d * n + w] = (d == 0) ?
+						table->on_board[w] : match[(d - 1) * n + w];
+				match[d * n + w] = 0;
+			}
+			open_row[d] = row;
+			open = d;
+		}
+
+		anchors = &table->anchors[(row - table->row) * n];
+		for (w = 0; w<n; w++) {
+			m = anchors[w] & left[d * n + w];
+			for (k = 0; k<row->num_cells; k++)
+				m &= term[row->term[k] * n + w];
+			match[d * n + w] |= m;
+		}
+	}
+
+	for (k = 0; k<C4_NUM_RULES; k++)
+		total += rule_score[k];
+	return total;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function charges the time since then to rule, or to making the   **/
+/**  bitboards if rule is -1, and returns the time now.                    **/
+/**                                                                        **/
+/****************************************************************************/
+
+static uint64_t
+charge(C4_rule_stats *stats, int rule, uint64_t then)
+{
+	uint64_t now = c4_cycles();
+
+	if (rule < 0)
+		stats->setup_cycles += now - then;
+	else
+		stats->cycles[rule] += now - then;
+	return now;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function turns a column or row of the rule table, which counts   **/
+/**  back from the far edge if it is negative, into a plain one.           **/
+/**                                                                        **/
+/****************************************************************************/
+
+static int
+edge_relative(int value, int size)
+{
+	return (value >= 0) ? value : size + value;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function moves a bitboard down by offset bits (up, if offset is  **/
+/**  negative), so that bit b of dst is bit b + offset of src.  Bits from  **/
+/**  beyond either end of src are 0.                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+shift_bitboard(uint64_t *dst, const uint64_t *src, int offset,
+	int num_words)
+{
+	int w, q, r;
+	uint64_t lo, hi;
+
+	q = (offset >= 0) ? offset / 64 : -((63 - offset) / 64);
+	r = offset - 64 * q;
+
+	for (w = 0; w<num_words; w++) {
+		lo = (w + q >= 0 && w + q < num_words) ? src[w + q] : 0;
+		hi = (w + q + 1 >= 0 && w + q + 1 < num_words) ? src[w + q + 1] : 0;
+		dst[w] = (r == 0) ? lo : (lo >> r) | (hi << (64 - r));
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds to rule_score[], the scores for player own of a    **/
+/**  board, the change made to them by a piece of player piece at column   **/
+/**  x, row y, where the board has (or had) an empty cell.                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+add_drop(const C4_rule_table *table, char **board, int own, int x, int y,
+	int piece, int rule_score[C4_NUM_RULES])
+{
+	const Chain *chain;
+	int c, k, ax, ay;
+
+	for (c = 0; c<table->num_chains; c++) {
+		chain = &table->chain[c];
+		for (k = 0; k<chain->num_cells; k++) {
+			ax = x - chain->dx[k];
+			ay = y - chain->dy[k];
+			if (ax >= 0 && ax < table->width && ay >= 0 && ay < table->height)
+				score_anchor(table, chain, chain->last_row[k], board, own,
+					ax, ay, x, y, piece, rule_score);
+		}
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function adds the cells of a row to those of its chain.          **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+add_chain_cells(Chain *chain, int row)
+{
+	const Rule_row *src = &rule_rows[row];
+	int k, j;
+
+	for (k = 0; k<MAX_CELLS && src->cell[k].need != END; k++) {
+		for (j = 0; j<chain->num_cells; j++)
+			if (chain->dx[j] == src->cell[k].dx && chain->dy[j] == src->cell[k].dy)
+				break;
+		if (j == chain->num_cells) {
+			assert(j < MAX_CHAIN_CELLS);
+			chain->dx[j] = src->cell[k].dx;
+			chain->dy[j] = src->cell[k].dy;
+			chain->num_cells++;
+		}
+		chain->last_row[j] = row;
+	}
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function takes the score for player own of a chain at the anchor **/
+/**  in column x, row y off rule_score[] as it was before a piece of       **/
+/**  player piece was dropped at column piece_x, row piece_y, and adds it  **/
+/**  as it is once the piece is there.  (The piece need not be on the      **/
+/**  board itself.)  last_row is the last row of the chain which looks at  **/
+/**  the piece's cell.                                                     **/
+/**                                                                        **/
+/**  The rows are walked as in walk_word(), but for a single anchor, and   **/
+/**  for both boards at once: bit 0 of each mask is the board without the  **/
+/**  piece and bit 1 the board with it.  Once the piece's cell has been    **/
+/**  looked at for the last time, and the two boards have come to the same **/
+/**  thing at every depth, the rest of the chain cannot tell them apart,   **/
+/**  and is skipped.                                                       **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+score_anchor(const C4_rule_table *table, const Chain *chain, int last_row,
+	char **board, int own, int x, int y, int piece_x, int piece_y, int piece,
+	int rule_score[C4_NUM_RULES])
+{
+	const Rule_row *src;
+	const Compiled_row *row, *open_row[MAX_DEPTH];
+	const Compiled_row *end = table->row + chain->first_row + chain->num_rows;
+	const Compiled_row *last = table->row + last_row;
+	int match[MAX_DEPTH] = { 0 }, left[MAX_DEPTH] = { 0 };
+	int open = -1, d, k, m, cx, cy, values;
+	int bit = x * table->height + y;
+	const uint64_t *anchors = &table->anchors[bit / 64];
+	uint64_t mask = (uint64_t)1 << (bit % 64);
+
+	for (row = table->row + chain->first_row; row <= end; row++) {
+		d = (row < end) ? row->depth : 0;
+
+		/* Close the rows this one follows, unless it is an OR. */
+
+		if (row == end || row->kind != OR) {
+			for (; open >= d; open--) {
+				if (match[open] & 1)
+					rule_score[open_row[open]->rule] -= open_row[open]->score;
+				if (match[open] & 2)
+					rule_score[open_row[open]->rule] += open_row[open]->score;
+				left[open] &= ~match[open];
+			}
+			if (row == end)
+				break;
+			if (row > last) {
+				for (k = 0; k <= d; k++)
+					if ((k <= open && (match[k] == 1 || match[k] == 2)) ||
+						left[k] == 1 || left[k] == 2)
+						break;
+				if (k > d)
+					break;
+			}
+			if (row->kind == IF)
+				left[d] = (d == 0) ? 3 : match[d - 1];
+			match[d] = 0;
+			open_row[d] = row;
+			open = d;
+		}
+
+		m = left[d] & ~match[d];
+		if (m == 0 ||
+			!(anchors[(row - table->row) * table->num_words] & mask))
+			continue;
+
+		src = &rule_rows[row - table->row];
+		for (k = 0; k<row->num_cells && m != 0; k++) {
+			cx = x + src->cell[k].dx;
+			cy = y + src->cell[k].dy;
+			values = need_values[own][src->cell[k].need];
+			if (cx == piece_x && cy == piece_y)
+				m &= (values >> C4_NONE & 1) | (values >> piece & 1) << 1;
+			else if (!(values >> board[cx][cy] & 1))
+				m = 0;
+		}
+		match[d] |= m;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef C4RULE_DEFINED
+#define C4RULE_DEFINED
+
+#include "c4.h"
+
+/* The rule patterns compiled into bitmasks for one size of board. */
+
+typedef struct C4_rule_table C4_rule_table;
+
+/* The rules scored after a piece is dropped in one column. */
+
+typedef struct {
+	int row;                /* Where the piece lands, or -1 if the column  */
+							/* is full; the fields below are then          */
+							/* undefined.                                  */
+	int total;              /* The sum of rule_score[].                    */
+	int rule_score[C4_NUM_RULES];
+	int fired[C4_NUM_RULES];
+							/* The rules (numbered from 1) which scored    */
+	int num_fired;          /* anything, in order, and how many there are. */
+} C4_rule_drop;
+
+/* See the file "c4rule.c" for documentation on the following functions. */
+
+extern C4_rule_table *c4_rule_table_new(int width, int height);
+extern void           c4_rule_table_free(C4_rule_table *table);
+extern size_t         c4_rule_table_size(int width, int height);
+extern int            c4_rule_eval(const C4_rule_table *table, char **board,
+                                   int own, int rule_score[C4_NUM_RULES]);
+extern bool           c4_rule_incremental(const C4_rule_table *table);
+extern int            c4_rule_update(const C4_rule_table *table, char **board,
+                                     int own, int x, int y,
+                                     int rule_score[C4_NUM_RULES]);
+extern void           c4_rule_eval_drops(const C4_rule_table *table,
+                                         char **board, int own, int piece,
+                                         const int score[C4_NUM_RULES],
+                                         C4_rule_drop drops[],
+                                         C4_rule_stats *stats);
+extern int            c4_rule_profile(const C4_rule_table *table,
+                                      char **board, int own,
+                                      int rule_score[C4_NUM_RULES],
+                                      C4_rule_stats *stats);
+extern void           c4_rule_stats_add_move(C4_rule_stats *stats,
+                                             const C4_rule_drop *drop);
+
+#endif /* C4RULE_DEFINED */
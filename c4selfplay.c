@@ -0,0 +1,263 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "c4.h"
+#include "c4sys.h"
+#include "c4tool.h"
+
+/* c4selfplay plays the computer against itself, with nobody watching,   */
+/* on any number of threads, and adds the positions of the games to a    */
+/* corpus (see "c4corpus.c") along with the moves chosen, the scores of  */
+/* the searches and the outcomes.  The engine for each side of a game is */
+/* drawn from those given with -e, and a few random moves may be made    */
+/* first (and left out of the corpus) so that the games differ.          */
+
+#define MAX_ENGINES  16
+#define MAX_THREADS  256
+
+/* The run, shared by the threads. */
+
+typedef struct {
+	int width, height, num;
+	long games;
+	int random_plies;
+	unsigned long seed;
+	C4_engine engines[MAX_ENGINES];
+	int num_engines;
+	C4_corpus_writer *writer;
+	c4_atomic next_game;    /* The number of games claimed by threads.     */
+} Run;
+
+/* One thread, and what it has done. */
+
+typedef struct {
+	Run *run;
+	c4_thread thread;
+	long games;
+	long positions;
+	long outcomes[3];       /* Wins for player 0, for player 1, and draws. */
+	long write_errors;
+} Worker;
+
+static void play_game(Worker *worker, long number);
+static void usage(void);
+static C4_THREAD_PROC(worker_main, arg);
+
+
+int
+main(int argc, char *argv[])
+{
+	static Run run;
+	static Worker workers[MAX_THREADS];
+	const char *path = "selfplay.c4p";
+	int num_threads = 1, i, e;
+	long games = 0, positions = 0, outcomes[3] = { 0, 0, 0 }, errors = 0;
+	double start, seconds;
+
+	run.width = 7;
+	run.height = 6;
+	run.num = 4;
+	run.games = 1000;
+	run.random_plies = 2;
+	run.seed = (unsigned long)time(NULL);
+	run.num_engines = 0;
+
+	for (i = 1; i<argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' ||
+			i + 1 >= argc)
+			usage();
+		switch (argv[i++][1]) {
+		case 'o': path = argv[i]; break;
+		case 'g': run.games = atol(argv[i]); break;
+		case 't': num_threads = atoi(argv[i]); break;
+		case 'r': run.random_plies = atoi(argv[i]); break;
+		case 's': run.seed = strtoul(argv[i], NULL, 10); break;
+		case 'W': run.width = atoi(argv[i]); break;
+		case 'H': run.height = atoi(argv[i]); break;
+		case 'N': run.num = atoi(argv[i]); break;
+		case 'e':
+			if (run.num_engines == MAX_ENGINES ||
+				!c4_engine_parse(argv[i], &run.engines[run.num_engines++]))
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (run.num_engines == 0)
+		c4_engine_parse("h5", &run.engines[run.num_engines++]);
+	if (run.width < 1 || run.width > 40 || run.height < 1 ||
+		run.height > 40 || run.num < 1 || run.games < 0 ||
+		run.random_plies < 0 || num_threads < 1 || num_threads > MAX_THREADS)
+		usage();
+
+	for (e = 0; e<run.num_engines; e++)
+		if (!c4_engine_open(&run.engines[e], run.width, run.height, NULL)) {
+			fprintf(stderr, "c4selfplay: can't read the network or make the "
+				"table of %s\n", run.engines[e].name);
+			return 1;
+		}
+
+	run.writer = c4_corpus_writer_new(path, run.width, run.height, run.num);
+	if (run.writer == NULL) {
+		fprintf(stderr, "c4selfplay: can't write a %dx%dx%d corpus to %s\n",
+			run.width, run.height, run.num, path);
+		return 1;
+	}
+	c4_atomic_store(&run.next_game, 0);
+
+	start = c4_wall_time();
+	for (i = 0; i<num_threads; i++) {
+		workers[i].run = &run;
+		if (c4_thread_create(&workers[i].thread, worker_main, &workers[i]) != 0) {
+			fprintf(stderr, "c4selfplay: can't start thread %d\n", i);
+			return 1;
+		}
+	}
+	for (i = 0; i<num_threads; i++) {
+		c4_thread_join(workers[i].thread);
+		games += workers[i].games;
+		positions += workers[i].positions;
+		outcomes[0] += workers[i].outcomes[0];
+		outcomes[1] += workers[i].outcomes[1];
+		outcomes[2] += workers[i].outcomes[2];
+		errors += workers[i].write_errors;
+	}
+	seconds = c4_wall_time() - start;
+	c4_corpus_writer_free(run.writer);
+	for (e = 0; e<run.num_engines; e++)
+		c4_engine_close(&run.engines[e]);
+
+	printf("%ld games (%ld won by player 0, %ld by player 1, %ld drawn)\n",
+		games, outcomes[0], outcomes[1], outcomes[2]);
+	printf("%ld positions in %.2f s: %.0f positions/s, %.0f per thread\n",
+		positions, seconds, positions / seconds,
+		positions / seconds / num_threads);
+	if (errors > 0) {
+		fprintf(stderr, "c4selfplay: %ld games could not be written to %s\n",
+			errors, path);
+		return 1;
+	}
+	return 0;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function plays the game numbered number and adds it to the       **/
+/**  corpus.  The engines and the random opening moves are drawn from a    **/
+/**  sequence of random numbers seeded by the number of the game, so a run **/
+/**  with the same seed opens its games the same way.                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+static void
+play_game(Worker *worker, long number)
+{
+	Run *run = worker->run;
+	C4_game *game;
+	C4_corpus_game record;
+	C4_move_result result;
+	const C4_engine *engines[2];
+	unsigned long long random = run->seed * 2654435761ULL + number;
+	int cells = run->width * run->height;
+	int *columns, *scores;
+	int player = 0, moves = 0, column;
+	char **board;
+
+	columns = (int *)malloc(2 * cells * sizeof(int));
+	if (columns == NULL) {
+		fprintf(stderr, "c4selfplay: can't allocate memory\n");
+		exit(1);
+	}
+	scores = columns + cells;
+
+	engines[0] = &run->engines[c4_tool_random(&random) % run->num_engines];
+	engines[1] = &run->engines[c4_tool_random(&random) % run->num_engines];
+
+	game = c4_game_new(NULL, run->width, run->height, run->num);
+	board = c4_game_board(game);
+
+	/* Open with random moves, as long as no one wins by them. */
+
+	while (moves < run->random_plies && moves < cells) {
+		do
+			column = (int)(c4_tool_random(&random) % run->width);
+		while (board[column][run->height - 1] != C4_NONE);
+		c4_game_make_move(game, player, column, NULL);
+		columns[moves] = column;
+		scores[moves++] = 0;
+		player ^= 1;
+		if (c4_game_is_winner(game, 0) || c4_game_is_winner(game, 1))
+			break;
+	}
+
+	while (!c4_game_is_winner(game, 0) && !c4_game_is_winner(game, 1) &&
+		!c4_game_is_tie(game)) {
+		if (!c4_engine_move(engines[player], game, player, &result))
+			break;
+		columns[moves] = result.column;
+		scores[moves++] = result.score;
+		player ^= 1;
+	}
+
+	record.first_player = 0;
+	record.num_moves = moves;
+	record.columns = columns;
+	record.scores = scores;
+	record.first_recorded = (moves < run->random_plies) ?
+		moves : run->random_plies;
+	record.winner = c4_game_is_winner(game, 0) ? 0 :
+		c4_game_is_winner(game, 1) ? 1 : C4_NONE;
+
+	if (!c4_corpus_write_game(run->writer, &record))
+		worker->write_errors++;
+	worker->games++;
+	worker->positions += record.num_moves - record.first_recorded;
+	worker->outcomes[(record.winner == C4_NONE) ? 2 : record.winner]++;
+
+	c4_game_free(game);
+	free(columns);
+}
+
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"usage: c4selfplay [-o file] [-g games] [-t threads] [-e engine]...\n"
+		"                  [-r random plies] [-s seed] [-W width] [-H height]\n"
+		"                  [-N num]\n"
+		"\n");
+	c4_engine_help(stderr);
+	fprintf(stderr,
+		"Each side of each game gets one of the engines given, at random; the\n"
+		"default is h5.\n");
+	exit(2);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This is the body of each thread.  It plays games until they have all  **/
+/**  been claimed.                                                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+static
+C4_THREAD_PROC(worker_main, arg)
+{
+	Worker *worker = (Worker *)arg;
+	long number;
+
+	while ((number = c4_atomic_increment(&worker->run->next_game) - 1) <
+		worker->run->games)
+		play_game(worker, number);
+
+	C4_THREAD_RETURN;
+}
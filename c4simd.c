@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <string.h>
+#include "c4simd.h"
+
+/* This file holds the versions of the kernel which applies a move to    */
+/* the win-place counts (see update_score() in "c4.c").  There is a      */
+/* plain C version, which is always available, and SSE4.1 and AVX2       */
+/* versions for x86 processors.  The version to use is chosen at run     */
+/* time from what the processor supports.  All of them produce exactly   */
+/* the same counts, differences and result.                              */
+
+#ifdef C4_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+static bool update_counts_sse41(unsigned char *score_array,
+	const int *win_indices, int num_indices, int player,
+	int magic_win_number, int differences[2]);
+static bool update_counts_avx2(unsigned char *score_array,
+	const int *win_indices, int num_indices, int player,
+	int magic_win_number, int differences[2]);
+static bool cpu_has_sse41(void);
+#endif
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the fastest version of the kernel that the      **/
+/**  processor supports.  The SSE4.1 version is slightly slower than the   **/
+/**  plain C one in practice (the loads and stores it cannot vectorise     **/
+/**  dominate), so it is only used when asked for.  If the environment     **/
+/**  variable C4_KERNEL is set to "avx2", "sse4.1" or "scalar", that       **/
+/**  version is used (or the plain C one, if the processor lacks it),      **/
+/**  which is useful for comparing them.                                   **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_count_kernel
+c4_best_count_kernel(void)
+{
+	const char *name = getenv("C4_KERNEL");
+
+#ifdef C4_X86
+	if ((name == NULL || strcmp(name, "avx2") == 0) && c4_cpu_has_avx2())
+		return update_counts_avx2;
+	if (name != NULL && strcmp(name, "sse4.1") == 0 && cpu_has_sse41())
+		return update_counts_sse41;
+#else
+	(void)name;
+#endif
+
+	return c4_update_counts_scalar;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the name of a version of the kernel, as         **/
+/**  accepted in C4_KERNEL.                                                **/
+/**                                                                        **/
+/****************************************************************************/
+
+const char *
+c4_count_kernel_name(C4_count_kernel kernel)
+{
+#ifdef C4_X86
+	if (kernel == update_counts_avx2)
+		return "avx2";
+	if (kernel == update_counts_sse41)
+		return "sse4.1";
+#endif
+	return (kernel == c4_update_counts_scalar) ? "scalar" : "unknown";
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The plain C version of the kernel, one win place at a time.           **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_update_counts_scalar(unsigned char *score_array, const int *win_indices,
+	int num_indices, int player, int magic_win_number, int differences[2])
+{
+	register int i;
+	int this_count, other_player = player ^ 1;
+	int this_difference = 0, other_difference = 0;
+	unsigned char *counts;
+	bool won = false;
+
+	for (i = 0; i<num_indices; i++) {
+		counts = &score_array[2 * win_indices[i]];
+		this_count = counts[player];
+		this_difference += (1 << this_count) >> 1;
+		other_difference += (1 << counts[other_player]) >> 1;
+
+		if (this_count != 0)
+			counts[player] = ++this_count;
+		counts[other_player] = 0;
+
+		if (this_count == magic_win_number)
+			won = true;
+	}
+
+	differences[0] = this_difference;
+	differences[1] = other_difference;
+	return won;
+}
+
+
+#ifdef C4_X86
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The SSE4.1 version of the kernel, four win places at a time.  SSE has **/
+/**  no gathers, so the pairs of counts are loaded one at a time and then  **/
+/**  split into the player's and the opponent's counts with a byte         **/
+/**  shuffle.  Nor has it per-lane shifts, so 2 to the power of a count is **/
+/**  made by building a float with that exponent and converting it back    **/
+/**  to an integer.  The new pairs are packed back down to 16 bits before  **/
+/**  being stored one at a time.                                           **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_TARGET("sse4.1")
+static bool
+update_counts_sse41(unsigned char *score_array, const int *win_indices,
+	int num_indices, int player, int magic_win_number, int differences[2])
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i bias = _mm_set1_epi32(127);
+	const __m128i magic = _mm_set1_epi32(magic_win_number);
+	const __m128i this_shift = _mm_cvtsi32_si128(8 * player);
+	const char t = (char)player, o = (char)(player ^ 1);
+	const __m128i this_select = _mm_setr_epi8(t, -1, -1, -1, t + 2, -1, -1,
+		-1, t + 4, -1, -1, -1, t + 6, -1, -1, -1);
+	const __m128i other_select = _mm_setr_epi8(o, -1, -1, -1, o + 2, -1, -1,
+		-1, o + 4, -1, -1, -1, o + 6, -1, -1, -1);
+	__m128i this_sum = zero, other_sum = zero, won = zero;
+	__m128i pairs, this_count, other_count, power;
+	unsigned short pair[4];
+	int i, k, n;
+
+	for (i = 0; i<num_indices; i += 4) {
+		n = (num_indices - i < 4) ? num_indices - i : 4;
+		for (k = 0; k<4; k++)
+			if (k < n)
+				memcpy(&pair[k], &score_array[2 * win_indices[i + k]], 2);
+			else
+				pair[k] = 0;
+		pairs = _mm_loadl_epi64((const __m128i *)pair);
+
+		this_count = _mm_shuffle_epi8(pairs, this_select);
+		other_count = _mm_shuffle_epi8(pairs, other_select);
+
+		power = _mm_cvttps_epi32(_mm_castsi128_ps(
+			_mm_slli_epi32(_mm_add_epi32(this_count, bias), 23)));
+		this_sum = _mm_add_epi32(this_sum, _mm_srli_epi32(power, 1));
+		power = _mm_cvttps_epi32(_mm_castsi128_ps(
+			_mm_slli_epi32(_mm_add_epi32(other_count, bias), 23)));
+		other_sum = _mm_add_epi32(other_sum, _mm_srli_epi32(power, 1));
+
+		this_count = _mm_add_epi32(this_count,
+			_mm_andnot_si128(_mm_cmpeq_epi32(this_count, zero), one));
+		won = _mm_or_si128(won, _mm_cmpeq_epi32(this_count, magic));
+
+		_mm_storel_epi64((__m128i *)pair, _mm_packus_epi32(
+			_mm_sll_epi32(this_count, this_shift), zero));
+		for (k = 0; k<n; k++)
+			memcpy(&score_array[2 * win_indices[i + k]], &pair[k], 2);
+	}
+
+	this_sum = _mm_add_epi32(this_sum, _mm_srli_si128(this_sum, 8));
+	this_sum = _mm_add_epi32(this_sum, _mm_srli_si128(this_sum, 4));
+	other_sum = _mm_add_epi32(other_sum, _mm_srli_si128(other_sum, 8));
+	other_sum = _mm_add_epi32(other_sum, _mm_srli_si128(other_sum, 4));
+
+	differences[0] = _mm_cvtsi128_si32(this_sum);
+	differences[1] = _mm_cvtsi128_si32(other_sum);
+	return _mm_movemask_epi8(won) != 0;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  The AVX2 version of the kernel, eight win places at a time.  Each     **/
+/**  32-bit lane of a gather picks up both players' counts for one win     **/
+/**  place (and two bytes beyond them, which are ignored; hence            **/
+/**  C4_COUNT_PADDING).  The last, partial group is handled with masked    **/
+/**  loads, so the win indices are never read past their end.              **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_TARGET("avx2")
+static bool
+update_counts_avx2(unsigned char *score_array, const int *win_indices,
+	int num_indices, int player, int magic_win_number, int differences[2])
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i byte = _mm256_set1_epi32(0xff);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i magic = _mm256_set1_epi32(magic_win_number);
+	const __m256i this_shift = _mm256_set1_epi32(8 * player);
+	const __m256i other_shift = _mm256_set1_epi32(8 * (player ^ 1));
+	__m256i this_sum = zero, other_sum = zero, won = zero;
+	__m256i mask, indices, pairs, this_count, other_count;
+	__m128i sum;
+	int words[8];
+	unsigned short word;
+	int i, k, n;
+
+	for (i = 0; i<num_indices; i += 8) {
+		n = (num_indices - i < 8) ? num_indices - i : 8;
+		mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(n), lanes);
+		indices = _mm256_maskload_epi32(&win_indices[i], mask);
+		pairs = _mm256_mask_i32gather_epi32(zero, (const int *)score_array,
+			indices, mask, 2);
+
+		this_count = _mm256_and_si256(_mm256_srlv_epi32(pairs, this_shift),
+			byte);
+		other_count = _mm256_and_si256(_mm256_srlv_epi32(pairs, other_shift),
+			byte);
+
+		this_sum = _mm256_add_epi32(this_sum,
+			_mm256_srli_epi32(_mm256_sllv_epi32(one, this_count), 1));
+		other_sum = _mm256_add_epi32(other_sum,
+			_mm256_srli_epi32(_mm256_sllv_epi32(one, other_count), 1));
+
+		this_count = _mm256_add_epi32(this_count,
+			_mm256_andnot_si256(_mm256_cmpeq_epi32(this_count, zero), one));
+		won = _mm256_or_si256(won, _mm256_cmpeq_epi32(this_count, magic));
+
+		_mm256_storeu_si256((__m256i *)words,
+			_mm256_sllv_epi32(this_count, this_shift));
+		for (k = 0; k<n; k++) {
+			word = (unsigned short)words[k];
+			memcpy(&score_array[2 * win_indices[i + k]], &word, 2);
+		}
+	}
+
+	sum = _mm_add_epi32(_mm256_castsi256_si128(this_sum),
+		_mm256_extracti128_si256(this_sum, 1));
+	sum = _mm_hadd_epi32(sum, sum);
+	differences[0] = _mm_cvtsi128_si32(_mm_hadd_epi32(sum, sum));
+	sum = _mm_add_epi32(_mm256_castsi256_si128(other_sum),
+		_mm256_extracti128_si256(other_sum, 1));
+	sum = _mm_hadd_epi32(sum, sum);
+	differences[1] = _mm_cvtsi128_si32(_mm_hadd_epi32(sum, sum));
+
+	return _mm256_movemask_epi8(won) != 0;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  These functions report whether the processor (and, for AVX2, the      **/
+/**  operating system) supports each instruction set.  c4_cpu_has_avx2()   **/
+/**  is shared with the other files which have AVX2 versions of their      **/
+/**  kernels.                                                              **/
+/**                                                                        **/
+/****************************************************************************/
+
+#ifdef _MSC_VER
+
+static bool
+cpu_has_sse41(void)
+{
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+}
+
+bool
+c4_cpu_has_avx2(void)
+{
+	int info[4];
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;               /* No OSXSAVE or no AVX. */
+	if ((_xgetbv(0) & 6) != 6)
+		return false;               /* The OS does not save YMM state. */
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+#else
+
+static bool
+cpu_has_sse41(void)
+{
+	return __builtin_cpu_supports("sse4.1");
+}
+
+bool
+c4_cpu_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif /* _MSC_VER */
+
+#endif /* C4_X86 */
@@ -0,0 +1,51 @@
+#ifndef C4SIMD_DEFINED
+#define C4SIMD_DEFINED
+
+#include <stdbool.h>
+
+/* C4_X86 is defined where there are x86 kernels to choose from, and    */
+/* C4_TARGET(isa) marks a function as using the instructions of isa,    */
+/* though the rest of its file is compiled without them.                */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define C4_X86
+#define C4_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define C4_X86
+#define C4_TARGET(isa)
+#endif
+
+/* The kernel which applies a move to the win-place counts of a board.  */
+/* score_array holds the two players' counts interleaved, as described  */
+/* in "c4.c"; win_indices lists the num_indices win places through the  */
+/* cell just played by player.  For each of them the player's count is  */
+/* advanced (unless it is 0) and the opponent's is cleared.  The old    */
+/* values of the player's and the opponent's counts are summed into     */
+/* differences[0] and differences[1].  true is returned if one of the   */
+/* player's counts reached magic_win_number.                            */
+
+typedef bool (*C4_count_kernel)(unsigned char *score_array,
+                                const int *win_indices, int num_indices,
+                                int player, int magic_win_number,
+                                int differences[2]);
+
+/* The number of bytes past the end of a score_array that a kernel may */
+/* read (but never write).  Allocations must be padded by this much.   */
+
+#define C4_COUNT_PADDING 2
+
+/* See the file "c4simd.c" for documentation on the following functions. */
+
+extern C4_count_kernel c4_best_count_kernel(void);
+extern const char *    c4_count_kernel_name(C4_count_kernel kernel);
+
+extern bool c4_update_counts_scalar(unsigned char *score_array,
+                                    const int *win_indices, int num_indices,
+                                    int player, int magic_win_number,
+                                    int differences[2]);
+
+#ifdef C4_X86
+extern bool c4_cpu_has_avx2(void);
+#endif
+
+#endif /* C4SIMD_DEFINED */
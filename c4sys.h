@@ -0,0 +1,531 @@
+#ifndef C4SYS_DEFINED
+#define C4SYS_DEFINED
+
+/* A thin portability layer over the threading, timing and memory       */
+/* primitives of the host system, so that the engine itself needs no    */
+/* #ifdefs for them.  Everything here is static and inline; there is    */
+/* nothing to link.                                                     */
+
+/* A strict -std hides the POSIX interfaces used below (clock_gettime(), */
+/* nanosleep() and the like) unless they are asked for before the first  */
+/* system header is included.  So that they are, every file including    */
+/* this one defines _DEFAULT_SOURCE on its first line as well.           */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+typedef CRITICAL_SECTION   c4_mutex;
+typedef CONDITION_VARIABLE c4_cond;
+typedef HANDLE             c4_thread;
+
+#define C4_THREAD_PROC(name, arg)  unsigned __stdcall name(void *arg)
+#define C4_THREAD_RETURN           return 0
+#define C4_ALWAYS_INLINE           __forceinline
+
+static __inline void c4_mutex_init(c4_mutex *m)    { InitializeCriticalSection(m); }
+static __inline void c4_mutex_destroy(c4_mutex *m) { DeleteCriticalSection(m); }
+static __inline void c4_mutex_lock(c4_mutex *m)    { EnterCriticalSection(m); }
+static __inline void c4_mutex_unlock(c4_mutex *m)  { LeaveCriticalSection(m); }
+
+static __inline void c4_cond_init(c4_cond *c)      { InitializeConditionVariable(c); }
+static __inline void c4_cond_destroy(c4_cond *c)   { (void)c; }
+static __inline void c4_cond_wait(c4_cond *c, c4_mutex *m)
+{
+	SleepConditionVariableCS(c, m, INFINITE);
+}
+static __inline void c4_cond_signal(c4_cond *c)    { WakeConditionVariable(c); }
+static __inline void c4_cond_broadcast(c4_cond *c) { WakeAllConditionVariable(c); }
+
+static __inline int
+c4_thread_create(c4_thread *t, unsigned (__stdcall *func)(void *), void *arg)
+{
+	*t = (HANDLE)_beginthreadex(NULL, 0, func, arg, 0, NULL);
+	return (*t != 0) ? 0 : -1;
+}
+
+static __inline void
+c4_thread_join(c4_thread t)
+{
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+}
+
+/* Wall-clock time in seconds from an arbitrary, monotonic origin. */
+
+static __inline double
+c4_wall_time(void)
+{
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+
+/* Sleep for the given number of milliseconds. */
+
+static __inline void
+c4_sleep_ms(int ms)
+{
+	Sleep(ms);
+}
+
+/* A word which threads may share without a lock.  The operations are    */
+/* full barriers, and c4_atomic_cas() stores desired only if the word     */
+/* holds expected, returning whether it did.                              */
+
+typedef volatile LONG c4_atomic;
+
+static __inline long c4_atomic_load(c4_atomic *a)         { return InterlockedCompareExchange(a, 0, 0); }
+static __inline void c4_atomic_store(c4_atomic *a, long v) { InterlockedExchange(a, v); }
+static __inline long c4_atomic_increment(c4_atomic *a)    { return InterlockedIncrement(a); }
+
+static __inline int
+c4_atomic_cas(c4_atomic *a, long expected, long desired)
+{
+	return InterlockedCompareExchange(a, desired, expected) == expected;
+}
+
+/* A 64-bit word which threads may share without a lock.  It is read and  */
+/* written whole, but in no particular order with other memory.           */
+
+typedef volatile LONG64 c4_word;
+
+#ifdef _WIN64
+static __inline uint64_t c4_word_load(c4_word *w)             { return (uint64_t)*w; }
+static __inline void     c4_word_store(c4_word *w, uint64_t v) { *w = (LONG64)v; }
+#else
+static __inline uint64_t c4_word_load(c4_word *w)             { return (uint64_t)InterlockedCompareExchange64(w, 0, 0); }
+static __inline void     c4_word_store(c4_word *w, uint64_t v) { InterlockedExchange64(w, (LONG64)v); }
+#endif
+
+/* Start fetching the cache line holding p, ahead of its use. */
+
+static __inline void
+c4_prefetch(const volatile void *p)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	_mm_prefetch((const char *)p, _MM_HINT_T0);
+#else
+	(void)p;
+#endif
+}
+
+/* A count of processor cycles from an arbitrary origin, for profiling. */
+
+static __inline uint64_t
+c4_cycles(void)
+{
+	return __rdtsc();
+}
+
+/* The number of bits set in a 64-bit word. */
+
+static __inline int
+c4_popcount64(uint64_t w)
+{
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int)((w * 0x0101010101010101ULL) >> 56);
+}
+
+/* A read-only view of the whole of a file, mapped into memory.  On      */
+/* success c4_file_map() sets *data and *size and returns 0.  A file of  */
+/* size 0 cannot be mapped.                                              */
+
+typedef struct {
+	HANDLE file, mapping;
+} c4_file_view;
+
+static __inline int
+c4_file_map(c4_file_view *v, const char *path, const void **data,
+	uint64_t *size)
+{
+	LARGE_INTEGER length;
+
+	v->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (v->file == INVALID_HANDLE_VALUE)
+		return -1;
+	if (!GetFileSizeEx(v->file, &length) || length.QuadPart == 0) {
+		CloseHandle(v->file);
+		return -1;
+	}
+	v->mapping = CreateFileMappingA(v->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	*data = (v->mapping != NULL) ?
+		MapViewOfFile(v->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (*data == NULL) {
+		if (v->mapping != NULL)
+			CloseHandle(v->mapping);
+		CloseHandle(v->file);
+		return -1;
+	}
+	*size = (uint64_t)length.QuadPart;
+	return 0;
+}
+
+static __inline void
+c4_file_unmap(c4_file_view *v, const void *data, uint64_t size)
+{
+	(void)size;
+	UnmapViewOfFile(data);
+	CloseHandle(v->mapping);
+	CloseHandle(v->file);
+}
+
+/* Zeroed memory for a large table, of size bytes, taken straight from    */
+/* the system.  If *huge is set, the table is backed by huge pages if     */
+/* the system will give them, and *huge is left set only if it did.       */
+/* NULL is returned if the memory cannot be had.                          */
+
+static __inline void *
+c4_pages_alloc(size_t size, int *huge)
+{
+	SIZE_T large = GetLargePageMinimum();
+	void *p = NULL;
+
+	if (*huge && large != 0)
+		p = VirtualAlloc(NULL, (size + large - 1) / large * large,
+			MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	*huge = (p != NULL);
+	if (p == NULL)
+		p = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	return p;
+}
+
+static __inline void
+c4_pages_free(void *p, size_t size)
+{
+	(void)size;
+	VirtualFree(p, 0, MEM_RELEASE);
+}
+
+/* Zeroed memory of size bytes shared between the processes which map it  */
+/* under name.  If no region of that name exists, one is made and         */
+/* *created is set; otherwise the one there is mapped, *created is        */
+/* cleared and *size is set to its size.  NULL is returned if the region  */
+/* cannot be mapped.  c4_shared_remove() takes the name away, so that the */
+/* next c4_shared_map() of it makes a new region; a region lasts until    */
+/* the last process using it unmaps it.                                   */
+
+static __inline void *
+c4_shared_map(const char *name, size_t *size, int *created)
+{
+	MEMORY_BASIC_INFORMATION info;
+	HANDLE mapping;
+	void *p;
+
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)((uint64_t)*size >> 32), (DWORD)*size, name);
+	if (mapping == NULL)
+		return NULL;
+	*created = (GetLastError() != ERROR_ALREADY_EXISTS);
+	p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	CloseHandle(mapping);   /* The view keeps the region alive. */
+	if (p != NULL && !*created && VirtualQuery(p, &info, sizeof(info)) != 0)
+		*size = info.RegionSize;
+	return p;
+}
+
+static __inline void
+c4_shared_unmap(void *p, size_t size)
+{
+	(void)size;
+	UnmapViewOfFile(p);
+}
+
+static __inline void
+c4_shared_remove(const char *name)
+{
+	(void)name;     /* The region goes with the last view of it. */
+}
+
+#else /* POSIX */
+
+typedef pthread_mutex_t c4_mutex;
+typedef pthread_cond_t  c4_cond;
+typedef pthread_t       c4_thread;
+
+#define C4_THREAD_PROC(name, arg)  void *name(void *arg)
+#define C4_THREAD_RETURN           return NULL
+#define C4_ALWAYS_INLINE           inline __attribute__((always_inline))
+
+static inline void c4_mutex_init(c4_mutex *m)    { pthread_mutex_init(m, NULL); }
+static inline void c4_mutex_destroy(c4_mutex *m) { pthread_mutex_destroy(m); }
+static inline void c4_mutex_lock(c4_mutex *m)    { pthread_mutex_lock(m); }
+static inline void c4_mutex_unlock(c4_mutex *m)  { pthread_mutex_unlock(m); }
+
+static inline void c4_cond_init(c4_cond *c)      { pthread_cond_init(c, NULL); }
+static inline void c4_cond_destroy(c4_cond *c)   { pthread_cond_destroy(c); }
+static inline void c4_cond_wait(c4_cond *c, c4_mutex *m)
+{
+	pthread_cond_wait(c, m);
+}
+static inline void c4_cond_signal(c4_cond *c)    { pthread_cond_signal(c); }
+static inline void c4_cond_broadcast(c4_cond *c) { pthread_cond_broadcast(c); }
+
+static inline int
+c4_thread_create(c4_thread *t, void *(*func)(void *), void *arg)
+{
+	return pthread_create(t, NULL, func, arg);
+}
+
+static inline void
+c4_thread_join(c4_thread t)
+{
+	pthread_join(t, NULL);
+}
+
+/* Wall-clock time in seconds from an arbitrary, monotonic origin. */
+
+static inline double
+c4_wall_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Sleep for the given number of milliseconds. */
+
+static inline void
+c4_sleep_ms(int ms)
+{
+	struct timespec t;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (long)(ms % 1000) * 1000000;
+	nanosleep(&t, NULL);
+}
+
+/* A word which threads may share without a lock.  Loads acquire, stores */
+/* release, and c4_atomic_cas() stores desired only if the word holds    */
+/* expected, returning whether it did.                                   */
+
+typedef volatile long c4_atomic;
+
+static inline long c4_atomic_load(c4_atomic *a)         { return __atomic_load_n(a, __ATOMIC_ACQUIRE); }
+static inline void c4_atomic_store(c4_atomic *a, long v) { __atomic_store_n(a, v, __ATOMIC_RELEASE); }
+static inline long c4_atomic_increment(c4_atomic *a)    { return __atomic_add_fetch(a, 1, __ATOMIC_ACQ_REL); }
+
+static inline int
+c4_atomic_cas(c4_atomic *a, long expected, long desired)
+{
+	return __atomic_compare_exchange_n(a, &expected, desired, 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/* A 64-bit word which threads may share without a lock.  It is read and  */
+/* written whole, but in no particular order with other memory.           */
+
+typedef volatile uint64_t c4_word;
+
+static inline uint64_t c4_word_load(c4_word *w)             { return __atomic_load_n(w, __ATOMIC_RELAXED); }
+static inline void     c4_word_store(c4_word *w, uint64_t v) { __atomic_store_n(w, v, __ATOMIC_RELAXED); }
+
+/* Start fetching the cache line holding p, ahead of its use. */
+
+static inline void
+c4_prefetch(const volatile void *p)
+{
+	__builtin_prefetch((const void *)p);
+}
+
+/* A count of processor cycles from an arbitrary origin, for profiling, */
+/* or of nanoseconds where there is no cycle counter.                   */
+
+static inline uint64_t
+c4_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/* The number of bits set in a 64-bit word. */
+
+static inline int
+c4_popcount64(uint64_t w)
+{
+	return __builtin_popcountll(w);
+}
+
+/* A read-only view of the whole of a file, mapped into memory.  On      */
+/* success c4_file_map() sets *data and *size and returns 0.  A file of  */
+/* size 0 cannot be mapped.                                              */
+
+typedef struct {
+	int fd;
+} c4_file_view;
+
+static inline int
+c4_file_map(c4_file_view *v, const char *path, const void **data,
+	uint64_t *size)
+{
+	struct stat st;
+	void *p;
+
+	v->fd = open(path, O_RDONLY);
+	if (v->fd < 0)
+		return -1;
+	if (fstat(v->fd, &st) != 0 || st.st_size == 0) {
+		close(v->fd);
+		return -1;
+	}
+	p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, v->fd, 0);
+	if (p == MAP_FAILED) {
+		close(v->fd);
+		return -1;
+	}
+	posix_madvise(p, (size_t)st.st_size, POSIX_MADV_WILLNEED);
+	*data = p;
+	*size = (uint64_t)st.st_size;
+	return 0;
+}
+
+static inline void
+c4_file_unmap(c4_file_view *v, const void *data, uint64_t size)
+{
+	munmap((void *)data, (size_t)size);
+	close(v->fd);
+}
+
+/* Zeroed memory for a large table, of size bytes, taken straight from    */
+/* the system.  If *huge is set, the table is aligned to a huge page and  */
+/* the system is asked to back it with them (transparent huge pages, on   */
+/* Linux), and *huge is left set only if it agreed.  NULL is returned if  */
+/* the memory cannot be had.                                              */
+
+#define C4_HUGE_PAGE ((size_t)2 << 20)
+
+/* These come with _DEFAULT_SOURCE (see the top of this file).  Linux     */
+/* has had MADV_HUGEPAGE since 2.6.38, so if it is missing there the      */
+/* feature macro has been lost, and huge pages would quietly be off.      */
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if defined(__linux__) && !defined(MADV_HUGEPAGE)
+#error "MADV_HUGEPAGE is not declared: define _DEFAULT_SOURCE first"
+#endif
+
+static inline void *
+c4_pages_alloc(size_t size, int *huge)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE), extra, head;
+	char *p, *aligned;
+
+	size = (size + page - 1) / page * page;
+	extra = *huge ? C4_HUGE_PAGE : 0;
+	p = (char *)mmap(NULL, size + extra, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	if (!*huge)
+		return p;
+
+	aligned = (char *)(((uintptr_t)p + C4_HUGE_PAGE - 1) &
+		~(uintptr_t)(C4_HUGE_PAGE - 1));
+	head = (size_t)(aligned - p);
+	if (head > 0)
+		munmap(p, head);
+	if (extra > head)
+		munmap(aligned + size, extra - head);
+#ifdef MADV_HUGEPAGE
+	*huge = (madvise(aligned, size, MADV_HUGEPAGE) == 0);
+#else
+	*huge = 0;      /* The system has no transparent huge pages. */
+#endif
+	return aligned;
+}
+
+static inline void
+c4_pages_free(void *p, size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	munmap(p, (size + page - 1) / page * page);
+}
+
+/* Zeroed memory of size bytes shared between the processes which map it  */
+/* under name, a POSIX shared memory object (a name of the form "/name"). */
+/* If no region of that name exists, one is made and *created is set;     */
+/* otherwise the one there is mapped, *created is cleared and *size is    */
+/* set to its size.  NULL is returned if the region cannot be mapped.     */
+/* c4_shared_remove() takes the name away, so that the next               */
+/* c4_shared_map() of it makes a new region; a region lasts until the     */
+/* last process using it unmaps it.                                       */
+
+static inline void *
+c4_shared_map(const char *name, size_t *size, int *created)
+{
+	struct stat st;
+	void *p;
+	int fd, tries;
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+	*created = (fd >= 0);
+	if (*created) {
+		if (ftruncate(fd, (off_t)*size) != 0) {
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+	}
+	else {
+		if (errno != EEXIST || (fd = shm_open(name, O_RDWR, 0)) < 0)
+			return NULL;
+
+		/* The process making the region may not have sized it yet. */
+		for (tries = 0; fstat(fd, &st) == 0 && st.st_size == 0 &&
+			tries < 1000; tries++)
+			c4_sleep_ms(1);
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return NULL;
+		}
+		*size = (size_t)st.st_size;
+	}
+
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return (p != MAP_FAILED) ? p : NULL;
+}
+
+static inline void
+c4_shared_unmap(void *p, size_t size)
+{
+	munmap(p, size);
+}
+
+static inline void
+c4_shared_remove(const char *name)
+{
+	shm_unlink(name);
+}
+
+#endif /* _WIN32 */
+
+#endif /* C4SYS_DEFINED */
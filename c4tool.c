@@ -0,0 +1,206 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "c4.h"
+#include "c4tool.h"
+
+/* This file holds what the command-line tools (c4selfplay and c4match)  */
+/* share: the engines named on their command lines, and the sequence of  */
+/* random numbers their games are drawn from.  It is built into the      */
+/* tools, not into the engine itself.                                    */
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes an engine of a specification: "rule" for          **/
+/**  apply_rule(), or a letter and a search level, the letter being h for  **/
+/**  the heuristic, r for the rules, b for a blend of the two and n for a  **/
+/**  network (see the C4_EVAL_ values in "c4.h").  The level may be        **/
+/**  followed by t and a number of megabytes, for the searches to share a  **/
+/**  transposition table of that size, or by T for one on huge pages.  A   **/
+/**  network's specification ends with a colon and the file to read it     **/
+/**  from, as in "n6t16:eval.net".  A value of false is returned if the    **/
+/**  specification is not one of these.  Nothing is read or made until     **/
+/**  c4_engine_open().                                                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_engine_parse(const char *spec, C4_engine *engine)
+{
+	static const char letters[] = "hrbn";
+	static const int evals[] = { C4_EVAL_HEURISTIC, C4_EVAL_RULES,
+		C4_EVAL_BLEND, C4_EVAL_NETWORK };
+	const char *start = spec, *letter;
+	char *end;
+	long level, megabytes;
+
+	if (strlen(spec) >= sizeof(engine->name))
+		return false;
+	strcpy(engine->name, spec);
+	memset(&engine->params, 0, sizeof(engine->params));
+	engine->table_mb = 0;
+	engine->table_flags = 0;
+	engine->network_path = NULL;
+	engine->network = NULL;
+	engine->rules = (strcmp(spec, "rule") == 0);
+	if (engine->rules)
+		return true;
+
+	letter = (spec[0] != '\0') ? strchr(letters, spec[0]) : NULL;
+	if (letter == NULL)
+		return false;
+	level = strtol(spec + 1, &end, 10);
+	if (end == spec + 1 || level < 1 || level > C4_MAX_LEVEL)
+		return false;
+
+	engine->params.eval = evals[letter - letters];
+	engine->params.level = (int)level;
+	engine->table_flags = (*end == 'T') ? C4_TABLE_HUGE_PAGES : 0;
+	if (*end == 't' || *end == 'T') {
+		spec = end + 1;
+		megabytes = strtol(spec, &end, 10);
+		if (end == spec || megabytes < 1 || megabytes > 65536)
+			return false;
+		engine->table_mb = megabytes;
+	}
+
+	/* The path is left in the copy of the specification. */
+
+	if (engine->params.eval == C4_EVAL_NETWORK) {
+		if (*end != ':' || end[1] == '\0')
+			return false;
+		engine->network_path = &engine->name[end + 1 - start];
+		return true;
+	}
+	return *end == '\0';
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function gets an engine made by c4_engine_parse() ready to play  **/
+/**  on a board of the given size: its network is read, and its table      **/
+/**  made.  If shared is not NULL, the table is the one in shared memory   **/
+/**  called shared, a dash and the name of the engine (with anything but   **/
+/**  letters and digits in the name turned into underscores), as made by   **/
+/**  c4_table_open_shared(), so that engines of the same name in other     **/
+/**  processes share it.  A value of false is returned if the network      **/
+/**  cannot be read or is not for the board, or the table cannot be made.  **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_engine_open(C4_engine *engine, int width, int height, const char *shared)
+{
+	char *name, *p;
+
+	if (engine->network_path != NULL) {
+		engine->network = c4_network_load(engine->network_path);
+		if (engine->network == NULL ||
+			!c4_network_fits(engine->network, width, height))
+			return false;
+		engine->params.network = engine->network;
+	}
+
+	if (engine->table_mb == 0)
+		return true;
+
+	if (shared != NULL) {
+		name = (char *)malloc(strlen(shared) + 1 + strlen(engine->name) + 1);
+		if (name == NULL) {
+			fprintf(stderr, "c4: c4_engine_open() - Can't allocate memory.\n");
+			exit(1);
+		}
+		sprintf(name, "%s-%s", shared, engine->name);
+		for (p = name + strlen(shared) + 1; *p != '\0'; p++)
+			if (!isalnum((unsigned char)*p))
+				*p = '_';
+		engine->params.table = c4_table_open_shared(name,
+			(size_t)engine->table_mb << 20);
+		free(name);
+	}
+	else
+		engine->params.table = c4_table_new((size_t)engine->table_mb << 20,
+			engine->table_flags);
+	return engine->params.table != NULL;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees what c4_engine_open() made for an engine.         **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_engine_close(C4_engine *engine)
+{
+	c4_table_free(engine->params.table);
+	c4_network_free(engine->network);
+	engine->params.table = NULL;
+	engine->params.network = engine->network = NULL;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function has an engine make a move for player in game, reported  **/
+/**  in result as by c4_game_auto_move().  A value of false is returned if **/
+/**  no move was made.                                                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_engine_move(const C4_engine *engine, C4_game *game, int player,
+	C4_move_result *result)
+{
+	C4_move_params params;
+
+	if (engine->rules)
+		return c4_game_apply_rule(game, player, result);
+
+	params = engine->params;
+	params.player = player;
+	return c4_game_auto_move(game, &params, result);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function writes the part of a tool's usage which explains the    **/
+/**  specifications of engines to fp.                                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_engine_help(FILE *fp)
+{
+	fprintf(fp,
+		"engines: hN (search to level N, scored by the heuristic), rN (by the\n"
+		"rules), bN (by a blend of both), nN:file (by the network in file) or\n"
+		"rule (apply_rule()).  A search may be followed by tM for a\n"
+		"transposition table of M megabytes, or TM for one on huge pages, as\n"
+		"in h8t64 or n6t16:eval.net.\n");
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the next number of a sequence of pseudo-random  **/
+/**  numbers (SplitMix64), and moves the sequence on.                      **/
+/**                                                                        **/
+/****************************************************************************/
+
+unsigned long
+c4_tool_random(unsigned long long *state)
+{
+	unsigned long long x = (*state += 0x9e3779b97f4a7c15ULL);
+
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return (unsigned long)((x ^ (x >> 31)) >> 33);
+}
@@ -0,0 +1,32 @@
+#ifndef C4TOOL_DEFINED
+#define C4TOOL_DEFINED
+
+#include <stdio.h>
+#include "c4.h"
+
+/* One way of choosing moves, as named on the command line of a tool. */
+
+typedef struct {
+	char name[128];         /* As given on the command line.               */
+	bool rules;             /* true for apply_rule(), false to search.     */
+	C4_move_params params;  /* The search, if there is one.                */
+	long table_mb;          /* The size of its transposition table, which  */
+	int table_flags;        /* all its games share, in megabytes (0 for    */
+							/* none), and the flags to make it with.       */
+	const char *network_path;
+							/* For C4_EVAL_NETWORK, the file the network   */
+	C4_network *network;    /* is read from, and the network once read.    */
+} C4_engine;
+
+/* See the file "c4tool.c" for documentation on the following functions. */
+
+extern bool          c4_engine_parse(const char *spec, C4_engine *engine);
+extern bool          c4_engine_open(C4_engine *engine, int width, int height,
+                                    const char *shared);
+extern void          c4_engine_close(C4_engine *engine);
+extern bool          c4_engine_move(const C4_engine *engine, C4_game *game,
+                                    int player, C4_move_result *result);
+extern void          c4_engine_help(FILE *fp);
+extern unsigned long c4_tool_random(unsigned long long *state);
+
+#endif /* C4TOOL_DEFINED */
@@ -0,0 +1,340 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "c4.h"
+#include "c4tt.h"
+#include "c4sys.h"
+
+/* This file keeps a transposition table: what searches have found out   */
+/* about the positions they came to, so that a search coming to one      */
+/* again, by another order of moves or on a later turn, can use it       */
+/* rather than search the position afresh.  A position is known by a     */
+/* 64-bit key (see "c4.c"); its low bits pick a bucket, and the top 32   */
+/* are kept in the entry to tell the positions sharing a bucket apart.   */
+/* Each entry is packed into one 64-bit word:                            */
+/*                                                                       */
+/*     bits  0-31   the top 32 bits of the key                           */
+/*     bits 32-47   the score                                            */
+/*     bits 48-53   the depth                                            */
+/*     bits 54-55   the bound, 0 for an empty entry                      */
+/*     bits 56-63   the column plus 1, 0 for none                        */
+/*                                                                       */
+/* and a bucket is a cache line of C4_TT_BUCKET entries, so a probe      */
+/* touches one line.  The first DEEP entries of a bucket keep the        */
+/* deepest searches made of its positions, and the rest the latest of    */
+/* the others: a new entry takes the place of the shallowest of the      */
+/* deep ones if it goes at least as deep, and the one it pushes out (or  */
+/* it, otherwise) takes one of the rest, picked by its key.              */
+/*                                                                       */
+/* An entry is read and written as a whole word, so a table may be       */
+/* shared by searches on any number of threads without a lock.  Two      */
+/* writes racing for an entry can lose one of them, but never mix them.  */
+/* The same holds between processes, for a table in shared memory (see   */
+/* c4_tt_open_shared()).                                                 */
+
+#define DEEP 4
+
+/* A table in shared memory starts with a header, a cache line long, so  */
+/* that the processes opening it can tell it is one.  SHARED_MAGIC holds */
+/* "C4TT" and the version of the layout of the entries and of the keys   */
+/* of the positions, which must change with either.                      */
+
+typedef struct {
+	c4_word magic;          /* SHARED_MAGIC, once the table is ready.      */
+	c4_word padding[7];
+} Shared_header;
+
+#define SHARED_MAGIC 0x4334545400000001ULL
+
+/* The fields of a packed entry. */
+
+#define CHECK(word)  ((uint32_t)(word))
+#define SCORE(word)  ((int)(int16_t)((word) >> 32))
+#define DEPTH(word)  ((int)((word) >> 48) & 63)
+#define BOUND(word)  ((int)((word) >> 54) & 3)
+#define COLUMN(word) ((int)((word) >> 56) - 1)
+
+static uint64_t pack(uint64_t key, const C4_tt_entry *entry);
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function makes a table of num_buckets buckets, which must be a   **/
+/**  power of 2, with every entry empty, and returns it.  If huge_pages is **/
+/**  true, the system is asked to back it with huge pages (see             **/
+/**  c4_pages_alloc() in "c4sys.h").  NULL is returned if the memory for   **/
+/**  the entries cannot be had.                                            **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_table *
+c4_tt_new(size_t num_buckets, bool huge_pages)
+{
+	C4_table *table;
+	int huge = huge_pages;
+
+	assert(num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+
+	table = (C4_table *)malloc(sizeof(C4_table));
+	if (table == NULL) {
+		fprintf(stderr, "c4: c4_tt_new() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	table->num_buckets = num_buckets;
+	table->bytes = num_buckets * C4_TT_BUCKET * sizeof(uint64_t);
+	table->entries = (c4_word *)c4_pages_alloc(table->bytes, &huge);
+	if (table->entries == NULL) {
+		free(table);
+		return NULL;
+	}
+	table->huge_pages = (huge != 0);
+	table->shared = false;
+
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function opens the table in the shared memory called name (see   **/
+/**  c4_shared_map() in "c4sys.h"), for searches in any process which      **/
+/**  opens it too to share.  If there is no such table, one of             **/
+/**  num_buckets buckets, which must be a power of 2, is made, with every  **/
+/**  entry empty; otherwise the one there is opened, at the size it was    **/
+/**  made.  NULL is returned if the memory cannot be mapped, or if it does **/
+/**  not hold a table laid out as this file lays them out.                 **/
+/**                                                                        **/
+/****************************************************************************/
+
+C4_table *
+c4_tt_open_shared(const char *name, size_t num_buckets)
+{
+	C4_table *table;
+	Shared_header *header;
+	size_t size = sizeof(Shared_header) +
+		num_buckets * C4_TT_BUCKET * sizeof(uint64_t);
+	int created, tries;
+
+	assert(num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+
+	header = (Shared_header *)c4_shared_map(name, &size, &created);
+	if (header == NULL)
+		return NULL;
+
+	/* The memory of a new table is already zero: every entry is empty. */
+	/* Another process's table may still be being made.                 */
+
+	if (created)
+		c4_word_store(&header->magic, SHARED_MAGIC);
+	for (tries = 0; c4_word_load(&header->magic) == 0 && tries < 1000; tries++)
+		c4_sleep_ms(1);
+
+	num_buckets = (size - sizeof(Shared_header)) /
+		(C4_TT_BUCKET * sizeof(uint64_t));
+	if (c4_word_load(&header->magic) != SHARED_MAGIC || num_buckets == 0 ||
+		(num_buckets & (num_buckets - 1)) != 0) {
+		c4_shared_unmap(header, size);
+		return NULL;
+	}
+
+	table = (C4_table *)malloc(sizeof(C4_table));
+	if (table == NULL) {
+		fprintf(stderr, "c4: c4_tt_open_shared() - Can't allocate memory.\n");
+		exit(1);
+	}
+
+	table->entries = (c4_word *)(header + 1);
+	table->num_buckets = num_buckets;
+	table->bytes = num_buckets * C4_TT_BUCKET * sizeof(uint64_t);
+	table->huge_pages = false;
+	table->shared = true;
+
+	return table;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function removes the name of a table in shared memory, so that   **/
+/**  the next c4_tt_open_shared() of it makes a new one.  The processes    **/
+/**  which have the old one open go on using it until they close it.       **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_tt_remove_shared(const char *name)
+{
+	c4_shared_remove(name);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function frees a table made by c4_tt_new(), or closes one opened **/
+/**  by c4_tt_open_shared().                                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_tt_free(C4_table *table)
+{
+	if (table == NULL)
+		return;
+	if (table->shared)
+		c4_shared_unmap((Shared_header *)table->entries - 1,
+			sizeof(Shared_header) + table->bytes);
+	else
+		c4_pages_free((void *)table->entries, table->bytes);
+	free(table);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of bytes a table of num_buckets      **/
+/**  buckets takes up.                                                     **/
+/**                                                                        **/
+/****************************************************************************/
+
+size_t
+c4_tt_size(size_t num_buckets)
+{
+	return sizeof(C4_table) + num_buckets * C4_TT_BUCKET * sizeof(uint64_t);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function empties every entry of a table.  No search may be using **/
+/**  it, in any process sharing it.                                        **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_tt_clear(C4_table *table)
+{
+	memset((void *)table->entries, 0, table->bytes);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function returns the number of entries of a table that are in    **/
+/**  use.  It looks at every one of them.                                  **/
+/**                                                                        **/
+/****************************************************************************/
+
+size_t
+c4_tt_used(C4_table *table)
+{
+	size_t i, used = 0;
+
+	for (i = 0; i<table->num_buckets * C4_TT_BUCKET; i++)
+		used += (c4_word_load(&table->entries[i]) != 0);
+	return used;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function looks for the position with the given key in a table.   **/
+/**  If it is there, its entry is unpacked into entry and true is          **/
+/**  returned; otherwise false is.                                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+bool
+c4_tt_probe(C4_table *table, uint64_t key, C4_tt_entry *entry)
+{
+	c4_word *bucket = &table->entries[(key & (table->num_buckets - 1)) *
+		C4_TT_BUCKET];
+	uint64_t word;
+	int i;
+
+	for (i = 0; i<C4_TT_BUCKET; i++) {
+		word = c4_word_load(&bucket[i]);
+		if (word != 0 && CHECK(word) == (uint32_t)(key >> 32)) {
+			entry->score = SCORE(word);
+			entry->depth = DEPTH(word);
+			entry->bound = BOUND(word);
+			entry->column = COLUMN(word);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function puts entry in a table for the position with the given   **/
+/**  key, as described at the top of this file.  An entry already there    **/
+/**  for the position is replaced, unless it is one of the deep ones and   **/
+/**  went deeper than the new one.                                         **/
+/**                                                                        **/
+/****************************************************************************/
+
+void
+c4_tt_store(C4_table *table, uint64_t key, const C4_tt_entry *entry)
+{
+	c4_word *bucket = &table->entries[(key & (table->num_buckets - 1)) *
+		C4_TT_BUCKET];
+	uint64_t word = pack(key, entry), old;
+	int i, shallowest = 0, depth, least = 64;
+
+	for (i = 0; i<C4_TT_BUCKET; i++) {
+		old = c4_word_load(&bucket[i]);
+		if (old != 0 && CHECK(old) == CHECK(word)) {
+			if (i >= DEEP || entry->depth >= DEPTH(old))
+				c4_word_store(&bucket[i], word);
+			return;
+		}
+	}
+
+	for (i = 0; i<DEEP; i++) {
+		old = c4_word_load(&bucket[i]);
+		depth = (old != 0) ? DEPTH(old) : -1;
+		if (depth < least) {
+			least = depth;
+			shallowest = i;
+		}
+	}
+
+	if (entry->depth >= least) {
+		old = c4_word_load(&bucket[shallowest]);
+		c4_word_store(&bucket[shallowest], word);
+		if (old == 0)
+			return;
+		word = old;
+	}
+
+	c4_word_store(&bucket[DEEP + CHECK(word) % (C4_TT_BUCKET - DEEP)], word);
+}
+
+
+/****************************************************************************/
+/**                                                                        **/
+/**  This function packs entry, for the position with the given key, into  **/
+/**  a word.                                                               **/
+/**                                                                        **/
+/****************************************************************************/
+
+static uint64_t
+pack(uint64_t key, const C4_tt_entry *entry)
+{
+	assert(entry->score >= -32768 && entry->score <= 32767);
+	assert(entry->depth >= 0 && entry->depth <= 63);
+	assert(entry->bound >= C4_TT_UPPER && entry->bound <= C4_TT_EXACT);
+	assert(entry->column >= -1 && entry->column <= 254);
+
+	return (key >> 32) |
+		(uint64_t)(uint16_t)entry->score << 32 |
+		(uint64_t)entry->depth << 48 |
+		(uint64_t)entry->bound << 54 |
+		(uint64_t)(entry->column + 1) << 56;
+}
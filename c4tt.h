@@ -0,0 +1,64 @@
+#ifndef C4TT_DEFINED
+#define C4TT_DEFINED
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "c4.h"
+#include "c4sys.h"
+
+/* What the score of an entry is: no better than the position's (an    */
+/* upper bound on it), no worse (a lower bound), or the score itself.   */
+
+#define C4_TT_UPPER 1
+#define C4_TT_LOWER 2
+#define C4_TT_EXACT 3
+
+/* The entries in a bucket, which fill a cache line. */
+
+#define C4_TT_BUCKET 8
+
+/* A transposition table (see "c4tt.c"). */
+
+struct C4_table {
+	c4_word *entries;       /* C4_TT_BUCKET entries to a bucket, aligned   */
+							/* to a cache line.                            */
+	size_t num_buckets;     /* A power of 2.                               */
+	size_t bytes;           /* The size of entries.                        */
+	bool huge_pages;        /* Whether entries is backed by huge pages.    */
+	bool shared;            /* Whether entries is in memory shared with    */
+							/* other processes (see c4_tt_open_shared()).  */
+};
+
+/* An entry of a table, unpacked. */
+
+typedef struct {
+	int score;              /* -32768 to 32767.                            */
+	int depth;              /* The levels searched below the position, 0   */
+							/* to 63.                                      */
+	int bound;              /* A C4_TT_ value.                             */
+	int column;             /* The best move found, 0 to 254, or -1.       */
+} C4_tt_entry;
+
+/* Start fetching the bucket of key, ahead of a c4_tt_probe() or a */
+/* c4_tt_store() of it.                                            */
+
+#define c4_tt_prefetch(table, key) \
+c4_prefetch(&(table)->entries[((key) & ((table)->num_buckets - 1)) * \
+	C4_TT_BUCKET])
+
+/* See the file "c4tt.c" for documentation on the following functions. */
+
+extern C4_table *c4_tt_new(size_t num_buckets, bool huge_pages);
+extern C4_table *c4_tt_open_shared(const char *name, size_t num_buckets);
+extern void      c4_tt_remove_shared(const char *name);
+extern void      c4_tt_free(C4_table *table);
+extern size_t    c4_tt_size(size_t num_buckets);
+extern void      c4_tt_clear(C4_table *table);
+extern size_t    c4_tt_used(C4_table *table);
+extern bool      c4_tt_probe(C4_table *table, uint64_t key,
+                             C4_tt_entry *entry);
+extern void      c4_tt_store(C4_table *table, uint64_t key,
+                             const C4_tt_entry *entry);
+
+#endif /* C4TT_DEFINED */
@@ -10,6 +10,7 @@ enum { HUMAN = 0, COMPUTER = 1 };
 static int get_num(char *prompt, int lower, int upper, int default_val);
 static void print_board(int width, int height);
 static void print_dot(void);
+static void print_report(void);
 //static void apply_rule(int player, int *column, int *row);
 
 
@@ -73,6 +74,7 @@ main()
 
 				fflush(stdout);
 				c4_auto_move(turn, level[turn], &move, NULL);
+				print_report();
 
 				printf("\nI dropped my piece into column %d.\n", move + 1);
 				
@@ -81,6 +83,7 @@ main()
 				printf("\n**Rule Based**\n\n");
 				fflush(stdout);
 				apply_rule(turn, &move, NULL);
+				print_report();
 				printf("\n\nI dropped my piece into column %d.\n", move + 1);
 
 			}
@@ -221,4 +224,20 @@ print_dot(void)
 {
 	printf(".");
 	fflush(stdout);
-}
\ No newline at end of file
+}
+
+/****************************************************************************/
+
+static void
+print_report(void)
+{
+	C4_move_result report;
+	int i;
+
+	if (!c4_move_report(&report))
+		return;
+
+	for (i = 0; i < report.num_rules_fired; i++)
+		printf("I chosed the rule %d\n", report.rules_fired[i]);
+	printf("coordinate : (%d, %d)\n", report.row + 1, report.column + 1);
+}